@@ -8,10 +8,8 @@ cbuffer SceneConstantBuffer : register(b0)
     float4x4 projection;    
 
     float4 cameraPos;
-    float2 ringOffset;
     double timeElapsed;
     float ringWorldSize;
-    float ringSampleStep;
     float planetScaleRatio;
     int terrainGridDimensionInVertices;
     float debug_scaler;
@@ -19,6 +17,14 @@ cbuffer SceneConstantBuffer : register(b0)
     // Bindless tile info
     uint tileCount;
     uint visibleTilesWidth;
+
+    // clipmap height pyramid
+    int2 terrainWindowOrigin;
+    uint heightPyramidSRV;
+    uint heightPyramidFirstRing;
+
+    // xy = ring origin, z = sample step, w = ring index
+    float4 clipmapRings[10]; // ClipmapConstants::maxRings
 };
 
 #endif
@@ -38,6 +38,7 @@
 #include <vector>
 #include <string>
 #include <atomic>
+#include <memory>
 
 #pragma warning(pop)
 
@@ -46,80 +47,23 @@
 #include "src/profiling.h"
 #include "src/v3.h"
 #include "src/baked_heightmap_mesh.h"
+#include "src/clipmap.h"
+#include "src/tile_residency.h"
+#include "src/stream_queue.h"
+#include "src/stream_telemetry.h"
+#include "src/stream_policy.h"
+#include "src/tile_streaming.h"
+#include "src/job_system.h"
+#include "src/tile_archive.h"
+#include "src/async_io.h"
+#include "src/virtual_texture.h"
+#include "src/upload_ring.h"
 
 #include "src/render_dx12.h"
 
 #define PI 3.1415926535897932384626433832795f
 #define PI_OVER_2 1.5707963267948966192313216916398f
 
-struct clipmap_mesh_data
-{
-    uint32_t *indexData;
-    size_t indexBufferDataSize;
-    uint32_t indexCount;
-};
-
-clipmap_mesh_data GenerateClipmapMeshData(int N, bool fillHole)
-{
-    clipmap_mesh_data result = {};
-    // const int N = terrainGridDimensionInVertices;
-    int quadsPerRow = N - 1;
-    int quadsTotal = quadsPerRow * quadsPerRow;
-    int indicesPerQuad = 6;
-    uint32_t indexCount = quadsTotal * indicesPerQuad;
-    size_t indexBufferDataSize = indexCount * sizeof(uint32_t);
-
-    size_t maxIndexCount = (N - 1) * (N - 1) * 6;
-    indexBufferDataSize = maxIndexCount * sizeof(uint32_t);
-    uint32_t *indices = (uint32_t *)SDL_malloc(indexBufferDataSize);
-
-    int idx = 0;
-
-    int innerSize = N / 2 - 1; // example: hole is N/4 wide
-    if (fillHole)
-        innerSize = 0;
-    int innerHalf = innerSize / 2;
-
-    int cx = N / 2; // grid center
-    int cy = N / 2;
-
-    for (int y = 0; y < N - 1; ++y)
-    {
-        for (int x = 0; x < N - 1; ++x)
-        {
-            // Compute quad center in grid space
-            int qx = x + 0.5f;
-            int qy = y + 0.5f;
-
-            // Check if quad is inside the hollow center
-            bool insideX = abs(qx - cx) < innerHalf;
-            bool insideY = abs(qy - cy) < innerHalf;
-
-            if (insideX && insideY)
-                continue; // skip this quad entirely
-
-            uint32_t v0 = x + y * N;
-            uint32_t v1 = (x + 1) + y * N;
-            uint32_t v2 = x + (y + 1) * N;
-            uint32_t v3 = (x + 1) + (y + 1) * N;
-
-            // tri 1
-            indices[idx++] = v0;
-            indices[idx++] = v2;
-            indices[idx++] = v1;
-
-            // tri 2
-            indices[idx++] = v1;
-            indices[idx++] = v2;
-            indices[idx++] = v3;
-        }
-    }
-    result.indexData = indices;
-    result.indexBufferDataSize = idx * sizeof(uint32_t);
-    result.indexCount = idx;
-    return result;
-}
-
 inline float randf()
 {
     return (float)rand() / (float)RAND_MAX;
@@ -484,7 +428,8 @@ int main(void)
     // heightmap mesh stuff
     D3D12_INPUT_ELEMENT_DESC inputElementDesc[] =
         {
-            {"POSITION", 0, DXGI_FORMAT_R16G16_UINT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+            {"POSITION", 0, (sizeof(clipmap_piece_grid::coord_type) == 1) ? DXGI_FORMAT_R8G8_UINT : DXGI_FORMAT_R16G16_UINT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+            {"CLIPMAPINSTANCE", 0, DXGI_FORMAT_R16G16B16A16_UINT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
             // {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
             // {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
         };
@@ -517,6 +462,14 @@ int main(void)
 
     const float aspectRatio = (float)width / (float)height;
 
+    // workers shared by streaming and bake loops, the main thread helps while it waits on a group
+    unsigned int hwThreads = std::thread::hardware_concurrency();
+    if (!jobSystem.init((hwThreads > 1) ? (int)(hwThreads - 1) : 1))
+    {
+        err("Failed to start the job system");
+        return 1;
+    }
+
     int bakedResult = 0;
     // bakedResult = baked_heightmap_mesh.baked(); //comment this out to disable the baked mesh
     if (bakedResult != 0)
@@ -525,79 +478,71 @@ int main(void)
         return 1;
     }
 
-    const int terrainGridDimensionInVertices = 256 + 1;
-    float terrainGridDimensionInWorldUnits = terrainGridDimensionInVertices - 1;
+    const int terrainGridDimensionInVertices = ClipmapConstants::gridDimVerts;
     constantBufferData.terrainGridDimensionInVertices = terrainGridDimensionInVertices;
-    d3d12_vertex_buffer terrainGridVB;
-    // float baseGridSize = terrainGridDimensionInVertices; // world units
-    const int terrainGridVertexCount = terrainGridDimensionInVertices * terrainGridDimensionInVertices;
-    const size_t terrainGridVertexDataSize = terrainGridVertexCount * sizeof(vertex_optimised);
-    vertex_optimised *terrainGridVertexData = (vertex_optimised *)SDL_malloc(terrainGridVertexDataSize);
-    for (int y = 0; y < terrainGridDimensionInVertices; ++y)
-    {
-        for (int x = 0; x < terrainGridDimensionInVertices; ++x)
-        {
-            vertex_optimised v = {};
-            v.x = x;
-            v.y = y;
 
-            terrainGridVertexData[x + y * terrainGridDimensionInVertices] = v;
-        }
-    }
-    if (!terrainGridVB.create_and_upload(terrainGridVertexDataSize, terrainGridVertexData, sizeof(vertex_optimised)))
+    // every clipmap piece is drawn from this one small grid, offset per instance
+    d3d12_vertex_buffer terrainGridVB;
+    const size_t terrainGridVertexDataSize = clipmap_piece_grid::vertexCount * sizeof(clipmap_piece_grid::vertex);
+    clipmap_piece_grid::vertex *terrainGridVertexData = (clipmap_piece_grid::vertex *)SDL_malloc(terrainGridVertexDataSize);
+    clipmap_piece_grid::write_vertices(terrainGridVertexData);
+    if (!terrainGridVB.create_and_upload(terrainGridVertexDataSize, terrainGridVertexData, sizeof(clipmap_piece_grid::vertex)))
     {
         err("Failed to create or upload terrain grid mesh");
         return 1;
     }
 
-    d3d12_index_buffer terrainGridCentreIB;
-    clipmap_mesh_data clipmapCentre = GenerateClipmapMeshData(terrainGridDimensionInVertices, true);
-    if (!terrainGridCentreIB.create_and_upload(clipmapCentre.indexBufferDataSize, clipmapCentre.indexData))
+    d3d12_index_buffer terrainGridIB;
+    clipmap_template_mesh clipmapTemplate = {};
+    if (!clipmapTemplate.generate())
     {
-        err("Failed to create or upload terrain grid index buffer (centre piece)");
+        err("Failed to generate clipmap template indices");
+        return 1;
+    }
+    DXGI_FORMAT clipmapIndexFormat = (sizeof(clipmap_piece_grid::index_type) == 2) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    if (!terrainGridIB.create_and_upload(clipmapTemplate.indexBufferDataSize, clipmapTemplate.indexData, clipmapIndexFormat))
+    {
+        err("Failed to create or upload terrain grid index buffer");
         return 1;
     }
 
-    d3d12_index_buffer terrainGridRingIB;
-    clipmap_mesh_data clipmapRing = GenerateClipmapMeshData(terrainGridDimensionInVertices, false);
-    if (!terrainGridRingIB.create_and_upload(clipmapRing.indexBufferDataSize, clipmapRing.indexData))
+    // per-instance piece origins and ring index, one slice per frame in flight
+    const UINT clipmapInstanceStride = sizeof(clipmap_instance);
+    const UINT clipmapInstanceSliceSize = clipmap_draw_list::maxInstances * clipmapInstanceStride;
+    d3d12_vertex_buffer clipmapInstanceVB;
+    if (!clipmapInstanceVB.create_dynamic(clipmapInstanceSliceSize * renderState.frameCount, clipmapInstanceStride))
     {
-        err("Failed to create or upload terrain grid index buffer (ring piece)");
+        err("Failed to create clipmap instance buffer");
         return 1;
     }
+    static clipmap_draw_list clipmapDrawList = {};
 
-    int maxClipmapRings = 8; // for terrain
+    int maxClipmapRings = ClipmapConstants::maxRings; // for terrain
     int activeClipmapRings = 5;
+    int skippedClipmapRings = 0;
+    bool autoClipmapRings = true;          // ring count and finest ring picked from altitude each frame
+    float clipmapTargetErrorPixels = 2.0f; // on-screen vertex spacing the finest drawn ring may reach
+    clipmap_lod clipmapLod = {};
     // TODO: make reusuable constant buffer stuff
 
     // create constant buffer
     // const UINT constantBufferSize = 256U;
 
     d3d12_constant_buffer sceneCB = {};
-    sceneCB.create(sizeof(constantBufferData), maxClipmapRings, 0);
-    sceneCB.upload(&constantBufferData, sizeof(constantBufferData));
+    sceneCB.create(sizeof(constantBufferData), renderState.frameCount, 0); // per frame, see terrainStreamingCB
 
     struct
     {
         DirectX::XMUINT4 heightSRV[16];
         DirectX::XMUINT4 albedoSRV[16];
+        DirectX::XMUINT4 virtualTexture; // page cache SRV, page table SRV, table pages per side, page mips; 0 when off
     } terrainStreamingCBData;
 
-    uint32_t index = 0;
-    for (unsigned int y = 0; y < 4; ++y)
-    {
-        for (unsigned int x = 0; x < 4; ++x)
-        {
-            unsigned int value = x + y * 4;
-            terrainStreamingCBData.heightSRV[index] = DirectX::XMUINT4(value, 0, 0, 0);
-            terrainStreamingCBData.albedoSRV[index] = DirectX::XMUINT4(16 + value, 0, 0, 0);
-            index++;
-        }
-    }
+    terrainStreamingCBData = {}; // filled from the tile residency cache once the first tiles are loaded
 
     d3d12_constant_buffer terrainStreamingCB = {};
-    terrainStreamingCB.create(sizeof(terrainStreamingCBData), 1, 1);
-    terrainStreamingCB.upload(&terrainStreamingCBData, sizeof(terrainStreamingCBData));
+    // a copy of the published indirection table per frame in flight, publishing never touches one the GPU reads
+    terrainStreamingCB.create(sizeof(terrainStreamingCBData), renderState.frameCount, 1);
 
     // CREATE BUNDLE
     hr = renderState.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, renderState.bundleAllocator, terrainPSO.pipelineState, IID_PPV_ARGS(&renderState.bundle));
@@ -616,45 +561,234 @@ int main(void)
     // renderState.bundle->DrawInstanced(terrainMeshSizeInVertices, 1, 0, 0);
     renderState.bundle->Close();
 
-    const uint32_t worldSizeTerrainTilesW = 19;
-    const uint32_t worldSizeTerrainTilesH = 8;
-    const uint32_t worldSizeTerrainTilesNum = worldSizeTerrainTilesW * worldSizeTerrainTilesH;
-
     const uint32_t visibleTileWidth = 4;
     constantBufferData.visibleTileWidth = visibleTileWidth;
     const uint32_t visibleTileNum = visibleTileWidth * visibleTileWidth;
 
-    static wchar_t heightmapFilenames[worldSizeTerrainTilesNum][256];
-    static wchar_t albedoFilenames[worldSizeTerrainTilesNum][256];
+    // every height and albedo tile lives in one mapped archive, built from the loose DDS folders by pack_tiles.py
+    static tile_archive tileArchive;
+    static tile_decode_pool tileDecodeBuffers; // compressed tiles decode here before upload
+    if (!tileArchive.open(L"data\\tiles.pak"))
+    {
+        err("Failed to open data\\tiles.pak, run pack_tiles.py first");
+        return 1;
+    }
+    // the archive's manifest is the world: its extent, which tiles exist and their height bounds
+    const world_manifest &worldManifest = tileArchive.manifest;
+    if (worldManifest.tileCount == 0)
+    {
+        err("data\\tiles.pak has no tiles");
+        return 1;
+    }
+    SDL_Log("World: %u tiles in [%d, %d] x [%d, %d]", worldManifest.tileCount, worldManifest.minTileX, worldManifest.maxTileX,
+            worldManifest.minTileY, worldManifest.maxTileY);
+    const char *tileLayerNames[TILE_LAYER_COUNT] = {"height", "albedo"};
+    for (int layer = 0; layer < TILE_LAYER_COUNT; ++layer)
+    {
+        const tile_archive_dedup_stats &dedup = tileArchive.dedup[layer];
+        SDL_Log("Dedup %s: %u tiles, %u unique, %.1f MB of GPU memory and %.1f MB of reads saved", tileLayerNames[layer],
+                dedup.entries, dedup.uniquePayloads, (double)dedup.duplicateBytes / (1024.0 * 1024.0), (double)dedup.duplicateStored / (1024.0 * 1024.0));
+        SDL_Log("Constant %s: %u tiles stored as a value, %.1f MB never read", tileLayerNames[layer], dedup.constantTiles,
+                (double)dedup.constantBytes / (1024.0 * 1024.0));
+    }
+    // streamed tiles are read by one I/O thread with many reads in flight instead of workers blocking on
+    // the mapping, falls back to the mapping if the reader can't start
+    static async_file_reader tileReader;
+    static std::atomic<bool> asyncTileIo{false}; // toggled from the stats panel while workers read it
+    const bool tileReaderOpen = tileReader.open(L"data\\tiles.pak");
+    asyncTileIo = tileReaderOpen;
+
+    // physical tile slots, the visible window plus spares that keep recently left tiles around
+    // descriptors: height slot i at i, albedo slot i at tileSlotCount + 1 + i
+    const uint32_t tileSlotCount = visibleTileNum + 8;
+    d3d12_bindless_texture heightTiles[tileSlotCount];
+    d3d12_bindless_texture albedoTiles[tileSlotCount];
+    if (!streamUploader.create(tileArchive.largest_mip_bytes()))
+    {
+        err("Failed to create the stream uploader");
+        return 1;
+    }
+    static tile_residency_cache tileCache = {};
+    tileCache.init((int)tileSlotCount);
+
+    struct tile_load_result
+    {
+        int slot;
+        int tileX;
+        int tileY;
+        bool albedo;
+        bool speculative;
+        bool ok;
+        bool cancelled; // superseded before it started, nothing was read
+        bool refine;    // full mip chain for a slot that was loaded tail first
+        Uint32 minMip;  // finest albedo mip uploaded
+        UINT64 uploadFence; // the slot's copies are on the GPU once the stream uploader's fence gets here
+        float priority;     // of the request, and its order and slot token, for the flight's deterministic I/O
+        Uint32 sequence;
+        Uint32 generation;
+        stream_load_timing timing;
+        height_tile_mips mips; // height loads only
+    };
+    // filled by stream workers, drained by the main thread. A slot has at most its layer loads and one refine
+    // in flight, so the queue never fills.
+    static stream_completion_queue<tile_load_result, 256> tileLoadsCompleted;
+    static_assert(TileResidencyConstants::maxSlots * 3 <= 256, "tileLoadsCompleted must hold every load in flight");
+    tileLoadsCompleted.init();
+    std::vector<tile_load_result> tileLoadsLanding; // reported, waiting on their copies
+    Uint32 tileLoadsInFlight = 0;                   // requested and not reported yet
+    Uint32 tileLoadSequence = 0;
+    static stream_telemetry streamTelemetry = {};
+
+    // clipmap height pyramid, one toroidal level per coarse ring, refreshed from CPU copies of the tiles
+    static clipmap_height_pyramid heightPyramid = {};
+    static height_tile_source heightTileSource = {};
+    // the far levels come from the always resident overview when there is one, the streamed window only feeds the near ones
+    static height_overview heightOverview;
+    int heightOverviewFirstLevel = HeightPyramidConstants::levelCount;
+    if (heightOverview.open(L"data\\height_overview.hov", worldManifest))
+    {
+        heightOverviewFirstLevel = heightPyramid.use_overview(&heightOverview);
+        SDL_Log("Height overview: %u texels per tile, %.1f MB, levels %d and up", heightOverview.tileDim,
+                (double)heightOverview.resident_bytes() / (1024.0 * 1024.0), heightOverviewFirstLevel);
+    }
+    else
+    {
+        SDL_Log("No height overview, far rings only see the streamed window (pack_tiles.py --overview)");
+    }
 
-    for (uint32_t y = 0; y < worldSizeTerrainTilesH; ++y)
+    const UINT heightPyramidSRV = 2 * tileSlotCount + 2; // after the albedo tiles
+    const UINT heightLevelRowPitch = HeightPyramidConstants::levelDim * sizeof(Uint16);
+    const UINT64 heightLevelUploadSize = (UINT64)heightLevelRowPitch * HeightPyramidConstants::levelDim;
+    const UINT64 heightPyramidSliceSize = heightLevelUploadSize * HeightPyramidConstants::levelCount;
+    d3d12_texture_array heightPyramidTexture;
+    if (!heightPyramidTexture.create(HeightPyramidConstants::levelDim, HeightPyramidConstants::levelDim, HeightPyramidConstants::levelCount,
+                                     DXGI_FORMAT_R16_UNORM, 1, heightPyramidSRV))
     {
-        for (uint32_t x = 0; x < worldSizeTerrainTilesW; ++x)
+        err("Failed to create clipmap height pyramid");
+        return 1;
+    }
+    d3d12_upload_buffer heightPyramidUpload;
+    if (!heightPyramidUpload.create(heightPyramidSliceSize * renderState.frameCount))
+    {
+        err("Failed to create clipmap height pyramid upload buffer");
+        return 1;
+    }
+    bool heightPyramidNeedsBarrier = true; // first frame moves the whole array to a shader resource
+    float heightPyramidMs = 0.0f;
+    constantBufferData.heightPyramidSRV = heightPyramidSRV;
+    constantBufferData.heightPyramidFirstRing = HeightPyramidConstants::firstLevel;
+
+    // albedo as a page granular virtual texture when data/albedo_pages.vt exists, the tile slots then only
+    // stream heights. The page cache and page table descriptors follow the height pyramid.
+    static vt_page_file albedoPages;
+    static vt_page_cache albedoPageCache;
+    static async_file_reader pageReader;
+    static stream_token albedoPageTokens[VirtualTextureConstants::physicalPages]; // bumped to drop a page's queued load
+    static vt_page_request pageRequests[VirtualTextureConstants::maxRequests];
+    vt_page_table albedoPageTable;
+    d3d12_texture_array albedoPageTexture; // one page per slice
+    d3d12_texture_array albedoPageTableTexture;
+    d3d12_upload_buffer albedoPageUpload;
+    const UINT albedoPagesSRV = heightPyramidSRV + 1;
+    const UINT albedoPageTableSRV = heightPyramidSRV + 2;
+    UINT pageUploadPitch = 0;
+    UINT64 pageUploadSize = 0;
+    UINT64 pageUploadSliceSize = 0;
+    bool virtualAlbedo = albedoPages.open(L"data\\albedo_pages.vt", worldManifest);
+    if (virtualAlbedo)
+    {
+        // per frame: maxUploadsPerFrame pages, then every page table mip, each at a placement aligned offset
+        const UINT64 placement = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+        int tableDim = (int)visibleTileWidth * albedoPages.pagesPerTileSide;
+        pageUploadPitch = (albedoPages.rowBytes + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+        pageUploadSize = ((UINT64)pageUploadPitch * albedoPages.rows + placement - 1) & ~(placement - 1);
+        pageUploadSliceSize = pageUploadSize * VirtualTextureConstants::maxUploadsPerFrame;
+        for (Uint32 mip = 0; mip < albedoPages.header->mipCount; ++mip)
         {
-            uint32_t index = x + y * worldSizeTerrainTilesW;
-            swprintf(heightmapFilenames[index], 256, L"data\\height\\chunk_height_%u_%u.dds", x, y);
-            swprintf(albedoFilenames[index], 256, L"data\\albedo\\chunk_albedo_%u_%u.dds", x, y);
+            UINT side = (UINT)SDL_max(tableDim >> mip, 1);
+            UINT pitch = (side * sizeof(Uint32) + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+            pageUploadSliceSize += ((UINT64)pitch * side + placement - 1) & ~(placement - 1);
         }
+        virtualAlbedo = albedoPageTable.init(tableDim, (int)albedoPages.header->mipCount) &&
+                        albedoPageTexture.create(VirtualTextureConstants::physicalPageDim, VirtualTextureConstants::physicalPageDim,
+                                                 VirtualTextureConstants::physicalPages, (DXGI_FORMAT)albedoPages.header->format, 1, albedoPagesSRV) &&
+                        albedoPageTableTexture.create((UINT)tableDim, (UINT)tableDim, 1, DXGI_FORMAT_R32_UINT, albedoPages.header->mipCount, albedoPageTableSRV) &&
+                        albedoPageUpload.create(pageUploadSliceSize * renderState.frameCount);
+        if (!virtualAlbedo)
+            SDL_Log("Virtual texture setup failed, albedo streams as whole tiles");
     }
-
-    d3d12_bindless_texture heightTiles[visibleTileNum];
-    d3d12_bindless_texture albedoTiles[visibleTileNum];
-
-    uint32_t startingSegmentX = 0;
-    uint32_t startingSegmentY = 0;
-
-    uint32_t endingSegmentX = SDL_clamp(startingSegmentX + visibleTileWidth, 0, worldSizeTerrainTilesW);
-    uint32_t endingSegmentY = SDL_clamp(startingSegmentY + visibleTileWidth, 0, worldSizeTerrainTilesH);
-
-    uint32_t indexVisibleTiles = 0;
-    for (uint32_t y = startingSegmentY; y < endingSegmentY; ++y)
+    const bool pageReaderOpen = virtualAlbedo && pageReader.open(L"data\\albedo_pages.vt");
+    bool albedoPagesNeedBarrier = true; // first frame moves the cache and the table to shader resources
+    int pagesWantedNotResident = 0;
+    albedoPageCache.init();
+    if (virtualAlbedo)
+        terrainStreamingCBData.virtualTexture = DirectX::XMUINT4(albedoPagesSRV, albedoPageTableSRV, (UINT)albedoPageTable.dim, albedoPages.header->mipCount);
+    // layers a tile slot holds: height, and albedo unless it's paged. A layer the archive stores as a constant
+    // isn't loaded, the tile table carries its value, and a tile with nothing left to load takes no slot.
+    const Uint32 tileSlotLayers = virtualAlbedo ? (1u << TILE_LAYER_HEIGHT) : (1u << TILE_LAYER_HEIGHT) | (1u << TILE_LAYER_ALBEDO);
+    auto tile_slot_loads = [&](int x, int y) { return tileSlotLayers & ~tileArchive.constant_layers(x, y); };
+
+    // the per-frame streaming step asks the archive through this, context is the layers a slot holds
+    tile_stream_world streamWorld = {};
+    streamWorld.tile_loads = [](void *context, int x, int y) -> Uint32
+    { return tileArchive.manifest.find(x, y) < 0 ? 0 : *(const Uint32 *)context & ~tileArchive.constant_layers(x, y); };
+    streamWorld.content_key = [](void *context, int x, int y) { return tileArchive.content_key(x, y, *(const Uint32 *)context); };
+    streamWorld.context = (void *)&tileSlotLayers;
+    tile_window worldTiles = {worldManifest.minTileX, worldManifest.minTileY, worldManifest.maxTileX + 1 - worldManifest.minTileX,
+                              worldManifest.maxTileY + 1 - worldManifest.minTileY};
+    static tile_streamer tileStreamer;
+    static_assert(visibleTileNum <= TileStreamingConstants::maxWindowTiles, "the streamer's window tables are too small");
+    tileStreamer.init(&tileCache, streamWorld, worldTiles, (int)visibleTileWidth, terrainTileInWorldUnits, cameraPos);
+    stream_speed_policy &speedPolicy = tileStreamer.policy; // coarser and further ahead as the camera speeds up
+
+    // start with the window around the camera, spare slots get the nearest tiles outside it. Rings walk
+    // only their edge and stop a few tiles out in a sparse world, tiles the world doesn't have never take a slot.
+    tile_window initialWindow = tileStreamer.window;
+    const int worldExtent = SDL_max(worldManifest.maxTileX - worldManifest.minTileX, worldManifest.maxTileY - worldManifest.minTileY) + 1;
+    const int maxInitialRing = SDL_min(worldExtent, (int)tileSlotCount);
+    for (int ring = 0; tileCache.resident_count() < tileCache.slotCount && ring <= maxInitialRing; ++ring)
     {
-        for (uint32_t x = startingSegmentX; x < endingSegmentX; ++x)
+        for (int y = initialWindow.y - ring; y < initialWindow.y + initialWindow.h + ring; ++y)
         {
-            uint32_t fn_i = x + y * worldSizeTerrainTilesW;
-            heightTiles[indexVisibleTiles].loadFromDDS(heightmapFilenames[fn_i], indexVisibleTiles, false);
-            albedoTiles[indexVisibleTiles].loadFromDDS(albedoFilenames[fn_i], visibleTileNum + indexVisibleTiles + 1, true);
-            indexVisibleTiles++;
+            int dy = SDL_max(SDL_max(initialWindow.y - y, y - (initialWindow.y + initialWindow.h - 1)), 0);
+            int step = dy == ring ? 1 : initialWindow.w + 2 * ring - 1; // rows inside the ring only have their two ends
+            for (int x = initialWindow.x - ring; x < initialWindow.x + initialWindow.w + ring; x += step)
+            {
+                Uint32 loads = worldManifest.find(x, y) < 0 ? 0 : tile_slot_loads(x, y);
+                if (loads == 0)
+                    continue;
+                Uint64 contentKey = tileArchive.content_key(x, y, tileSlotLayers);
+                if (tileCache.find_shared(x, y, contentKey) >= 0)
+                    continue; // a duplicate of a tile already in
+                int slot = tileCache.assign(x, y, contentKey, initialWindow, tile_streamer::layer_count(loads));
+                if (slot < 0)
+                    continue;
+                height_tile_mips mips = {};
+                mips.tileX = x;
+                mips.tileY = y;
+                if (loads & (1u << TILE_LAYER_HEIGHT))
+                {
+                    dds_image heightImage;
+                    tile_decode_buffer *heightBuffer = tileDecodeBuffers.acquire();
+                    bool ok = tileArchive.tile(TILE_LAYER_HEIGHT, x, y, heightImage, heightBuffer) &&
+                              heightTiles[slot].load(heightImage, (UINT)slot, false, &mips);
+                    tileDecodeBuffers.release(heightBuffer);
+                    if (ok)
+                        heightTileSource.insert(mips, initialWindow.x, initialWindow.y, initialWindow.w);
+                    else
+                        mips.release();
+                    tileCache.load_finished(slot, !ok); // a failed layer empties the slot, streaming asks again
+                }
+                if (loads & (1u << TILE_LAYER_ALBEDO))
+                {
+                    dds_image albedoImage;
+                    tile_decode_buffer *albedoBuffer = tileDecodeBuffers.acquire();
+                    bool ok = tileArchive.tile(TILE_LAYER_ALBEDO, x, y, albedoImage, albedoBuffer) &&
+                              albedoTiles[slot].load(albedoImage, tileSlotCount + (UINT)slot + 1, true);
+                    tileDecodeBuffers.release(albedoBuffer);
+                    tileCache.load_finished(slot, !ok);
+                }
+            }
         }
     }
 
@@ -663,42 +797,276 @@ int main(void)
 
     // multithread stuff
 
-    // --- streaming threadpool (init) ---
-    std::mutex streamMutex;
-    std::condition_variable streamCv;
-    std::queue<std::function<void()>> streamJobs;
-    std::vector<std::thread> streamWorkers;
-    std::atomic<bool> streamStop(false);
+    // --- streaming requests, run on the job system ---
+    static stream_request_queue streamRequests;
+    static stream_token tileSlotTokens[TileResidencyConstants::maxSlots]; // bumped to drop a slot's queued loads
+    bool progressiveTiles = true; // albedo mip tail first, full chain as a refine once resident
+
+    // reads mips [firstMip, mipLevels) of one layer of a tile, uploads them and reports through finished. With
+    // async I/O the worker only queues the read, decode and upload run as a job once it lands. Otherwise it
+    // reads through the mapping.
+    auto load_tile_layer = [](tile_archive_layer layer, int x, int y, Uint32 firstMip, stream_load_timing timing,
+                              std::function<bool(const dds_image &)> upload,
+                              std::function<void(bool ok, const stream_load_timing &timing)> finished)
+    {
+        const tile_archive_entry *entry = tileArchive.entry(layer, x, y);
+        tile_archive_span span = {};
+        bool found = entry && tileArchive.mip_span(*entry, firstMip, span);
+        timing.bytes = found ? span.storedEnd - span.storedBegin : 0;
+        timing.ioStart = SDL_GetPerformanceCounter();
+        if (!asyncTileIo)
+        {
+            timing.ioEnd = timing.ioStart; // page faults land in decode and upload
+            dds_image image;
+            tile_decode_buffer *buffer = tileDecodeBuffers.acquire();
+            bool ok = found && tileArchive.tile(*entry, span, tileArchive.file.data + entry->offset + span.storedBegin, image, buffer);
+            timing.decodeEnd = SDL_GetPerformanceCounter();
+            ok = ok && upload(image);
+            timing.uploadEnd = SDL_GetPerformanceCounter();
+            tileDecodeBuffers.release(buffer);
+            finished(ok, timing);
+            return;
+        }
+
+        tile_decode_buffer *payload = found ? tileDecodeBuffers.acquire() : nullptr;
+        if (!payload || !payload->reserve((size_t)timing.bytes))
+        {
+            if (payload)
+                tileDecodeBuffers.release(payload);
+            finished(false, timing);
+            return;
+        }
+        tileReader.read(entry->offset + span.storedBegin, (size_t)timing.bytes, payload->data, [entry, span, payload, timing, upload, finished](bool readOk)
+                        {
+                            // on the I/O thread, get off it before decoding
+                            stream_load_timing read = timing;
+                            read.ioEnd = SDL_GetPerformanceCounter();
+                            auto *decodeJob = new std::function<void()>([entry, span, payload, read, upload, finished, readOk]()
+                                                                        {
+                                                                            stream_load_timing t = read;
+                                                                            dds_image image;
+                                                                            tile_decode_buffer *buffer = tileDecodeBuffers.acquire();
+                                                                            bool ok = readOk && tileArchive.tile(*entry, span, payload->data, image, buffer);
+                                                                            t.decodeEnd = SDL_GetPerformanceCounter();
+                                                                            ok = ok && upload(image);
+                                                                            t.uploadEnd = SDL_GetPerformanceCounter();
+                                                                            tileDecodeBuffers.release(buffer);
+                                                                            tileDecodeBuffers.release(payload);
+                                                                            finished(ok, t); });
+                            jobSystem.submit([](void *data)
+                                             {
+                                                 std::function<void()> *job = (std::function<void()> *)data;
+                                                 (*job)();
+                                                 delete job; }, decodeJob); });
+    };
+
+    // queues the loads of layers (see tile_slot_loads) for a slot the residency cache just assigned,
+    // closest tiles first, anything speculative after every demand load
+    auto request_tile_load = [&](int slot, int x, int y, bool speculative, Uint32 layers)
+    {
+        d3d12_bindless_texture *htex = &heightTiles[slot];
+        d3d12_bindless_texture *atex = &albedoTiles[slot];
+
+        float priority = tileStreamer.priority({slot, x, y, layers, speculative}, cameraPos);
+
+        // albedo comes in as its coarse mip tail first, the full chain follows as a refine
+        const tile_archive_entry *albedoEntry = tileArchive.entry(TILE_LAYER_ALBEDO, x, y);
+        Uint32 tailMip = (progressiveTiles || speedPolicy.tail_first()) && albedoEntry ? tile_mip_tail_first(albedoEntry->width, albedoEntry->height, albedoEntry->mipLevels) : 0;
+
+        streamTelemetry.slot_reassigned(slot);
+        for (int load = 0; load < tile_streamer::layer_count(layers); ++load)
+            streamTelemetry.load_requested();
+        tileLoadsInFlight += (Uint32)tile_streamer::layer_count(layers);
+        tile_load_result request = {};
+        request.slot = slot;
+        request.tileX = x;
+        request.tileY = y;
+        request.speculative = speculative;
+        request.priority = priority;
+        request.generation = tileSlotTokens[slot].current();
+        request.timing.enqueued = SDL_GetPerformanceCounter();
+        // workers hand results back here, the main thread picks them up next frame
+        auto finished = [](tile_load_result result, bool ok, const stream_load_timing &timing)
+        {
+            result.ok = ok;
+            result.timing = timing;
+            tileLoadsCompleted.push(result);
+        };
 
-    unsigned int hwThreads = std::thread::hardware_concurrency();
-    unsigned int numWorkers = (hwThreads > 1) ? (hwThreads - 1) : 1;
-    streamWorkers.reserve(numWorkers);
-    for (unsigned int i = 0; i < numWorkers; ++i)
+        {
+            std::lock_guard<std::mutex> lk(streamRequests.mutex);
+            request.sequence = tileLoadSequence++;
+            if (layers & (1u << TILE_LAYER_HEIGHT))
+                streamRequests.push_locked(priority, &tileSlotTokens[slot], [htex, request, finished, load_tile_layer](bool cancelled)
+                                           {
+                                               auto result = std::make_shared<tile_load_result>(request);
+                                               result->cancelled = cancelled;
+                                               result->mips.tileX = request.tileX;
+                                               result->mips.tileY = request.tileY;
+                                               if (cancelled)
+                                                   finished(*result, false, result->timing);
+                                               else
+                                                   load_tile_layer(TILE_LAYER_HEIGHT, request.tileX, request.tileY, 0, request.timing,
+                                                                   [htex, result](const dds_image &image)
+                                                                   { return htex->update_data(image, result->uploadFence, &result->mips); },
+                                                                   [result, finished](bool ok, const stream_load_timing &timing)
+                                                                   { finished(*result, ok, timing); }); });
+            request.sequence = tileLoadSequence++;
+            if (layers & (1u << TILE_LAYER_ALBEDO))
+                streamRequests.push_locked(priority, &tileSlotTokens[slot], [atex, request, tailMip, finished, load_tile_layer](bool cancelled)
+                                           {
+                                               auto result = std::make_shared<tile_load_result>(request);
+                                               result->albedo = true;
+                                               result->cancelled = cancelled;
+                                               result->minMip = tailMip;
+                                               if (cancelled)
+                                                   finished(*result, false, result->timing);
+                                               else
+                                                   load_tile_layer(TILE_LAYER_ALBEDO, request.tileX, request.tileY, tailMip, request.timing,
+                                                                   [atex, tailMip, result](const dds_image &image)
+                                                                   { return atex->update_data(image, result->uploadFence, nullptr, tailMip); },
+                                                                   [result, finished](bool ok, const stream_load_timing &timing)
+                                                                   { finished(*result, ok, timing); }); });
+        }
+        // one job per request, each runs whatever is most urgent when it starts
+        for (int load = 0; load < tile_streamer::layer_count(layers); ++load)
+            jobSystem.submit(&stream_request_queue::run_next, &streamRequests);
+    };
+
+    // uploads the full albedo chain into a slot that went resident on its mip tail. Refines queue behind
+    // every new tile of the same kind, a tile at the right place matters more than a sharp one
+    auto request_tile_refine = [&](int slot, int x, int y, bool speculative)
+    {
+        d3d12_bindless_texture *atex = &albedoTiles[slot];
+
+        float priority = tileStreamer.priority({slot, x, y, 0, speculative}, cameraPos);
+
+        streamTelemetry.load_requested();
+        tileLoadsInFlight++;
+        tile_load_result request = {};
+        request.slot = slot;
+        request.tileX = x;
+        request.tileY = y;
+        request.albedo = true;
+        request.speculative = speculative;
+        request.refine = true;
+        request.priority = priority;
+        request.sequence = tileLoadSequence++;
+        request.generation = tileSlotTokens[slot].current();
+        request.timing.enqueued = SDL_GetPerformanceCounter();
+        auto finished = [](tile_load_result result, bool ok, const stream_load_timing &timing)
+        {
+            result.ok = ok;
+            result.timing = timing;
+            tileLoadsCompleted.push(result);
+        };
+        {
+            std::lock_guard<std::mutex> lk(streamRequests.mutex);
+            streamRequests.push_locked(priority, &tileSlotTokens[slot], [atex, request, finished, load_tile_layer](bool cancelled)
+                                       {
+                                           auto result = std::make_shared<tile_load_result>(request);
+                                           result->cancelled = cancelled;
+                                           if (cancelled)
+                                               finished(*result, false, result->timing);
+                                           else // the slot is published, frames sample it while the copy runs
+                                               load_tile_layer(TILE_LAYER_ALBEDO, request.tileX, request.tileY, 0, request.timing,
+                                                               [atex, result](const dds_image &image)
+                                                               { return atex->update_data(image, result->uploadFence, nullptr, 0, true); },
+                                                               [result, finished](bool ok, const stream_load_timing &timing)
+                                                               { finished(*result, ok, timing); }); });
+        }
+        jobSystem.submit(&stream_request_queue::run_next, &streamRequests);
+    };
+
+    // albedo page loads, finished pages wait here for the main thread to copy them into the cache
+    struct vt_page_load_result
+    {
+        int page;
+        bool ok;
+        tile_decode_buffer *pixels; // pageBytes of the page, null when it failed
+    };
+    static stream_completion_queue<vt_page_load_result, VirtualTextureConstants::physicalPages> pageLoadsCompleted; // filled by stream workers, one load per page at most
+    pageLoadsCompleted.init();
+    std::vector<vt_page_load_result> pageUploadsPending; // drained maxUploadsPerFrame at a time
+
+    // queues the read of one albedo page into a physical page the cache just handed out. A page decodes
+    // in microseconds so it happens right in the read callback, there is no decode job.
+    auto request_page_load = [&](int page, Uint64 key, float priority)
     {
-        streamWorkers.emplace_back([&]()
-                                   {
-            while (true)
+        const vt_page_entry *entry = albedoPages.page(vt_page_key_mip(key), vt_page_key_x(key), vt_page_key_y(key));
+        if (!entry)
+        {
+            albedoPageCache.load_finished(page, false); // outside the world or a tile that was never packed
+            return;
+        }
+        auto finished = [](int page, bool ok, tile_decode_buffer *pixels)
+        {
+            if (!ok && pixels)
             {
-                std::function<void()> job;
-                {
-                    std::unique_lock<std::mutex> lk(streamMutex);
-                    streamCv.wait(lk, [&] { return streamStop.load() || !streamJobs.empty(); });
-                    if (streamStop.load() && streamJobs.empty())
-                        return;
-                    job = std::move(streamJobs.front());
-                    streamJobs.pop();
-                }
-                try
-                {
-                    job();
-                }
-                catch (...)
-                {
-                    // swallow exceptions to keep worker alive; could log if desired
-                }
-            } });
-    }
-    // --- end threadpool init ---
+                tileDecodeBuffers.release(pixels);
+                pixels = nullptr;
+            }
+            pageLoadsCompleted.push({page, ok, pixels});
+        };
+        {
+            std::lock_guard<std::mutex> lk(streamRequests.mutex);
+            streamRequests.push_locked(priority, &albedoPageTokens[page], [page, entry, finished, pageReaderOpen](bool cancelled)
+                                       {
+                                           if (cancelled)
+                                           {
+                                               finished(page, false, nullptr);
+                                               return;
+                                           }
+                                           tile_decode_buffer *pixels = tileDecodeBuffers.acquire();
+                                           if (!pixels->reserve(albedoPages.header->pageBytes))
+                                           {
+                                               finished(page, false, pixels);
+                                               return;
+                                           }
+                                           if (!pageReaderOpen)
+                                           {
+                                               bool ok = albedoPages.read_page(*entry, albedoPages.file.data + entry->offset, pixels->data);
+                                               finished(page, ok, pixels);
+                                               return;
+                                           }
+                                           if (!(entry->flags & VirtualTextureConstants::pageLz4))
+                                           {
+                                               pageReader.read(entry->offset, entry->storedSize, pixels->data, [page, pixels, finished](bool ok)
+                                                               { finished(page, ok, pixels); });
+                                               return;
+                                           }
+                                           tile_decode_buffer *stored = tileDecodeBuffers.acquire();
+                                           if (!stored->reserve(entry->storedSize))
+                                           {
+                                               tileDecodeBuffers.release(stored);
+                                               finished(page, false, pixels);
+                                               return;
+                                           }
+                                           pageReader.read(entry->offset, entry->storedSize, stored->data, [page, entry, pixels, stored, finished](bool readOk)
+                                                           {
+                                                               bool ok = readOk && albedoPages.read_page(*entry, stored->data, pixels->data);
+                                                               tileDecodeBuffers.release(stored);
+                                                               finished(page, ok, pixels); }); });
+        }
+        jobSystem.submit(&stream_request_queue::run_next, &streamRequests);
+    };
+
+    int tilesSharedThisFrame = 0;
+    int tilesConstantThisFrame = 0;   // window tiles with a layer stored as a value
+    Uint32 constantLoadsSkipped = 0;  // layer loads those saved, counted on window moves
+    int refinesDeferredThisFrame = 0; // window tiles on their mip tail while the camera is fast
+
+    // scripted flight across the world on a fixed timestep to compare streaming policies and speeds
+    stream_test_flight testFlight;
+    float testFlightSpeed = 5000.0f;
+    bool deterministicFlightIo = true; // loads land at a fixed disk rate instead of this machine's, see stream_flight_io
+    float flightIoMegabytesPerFrame = StreamFlightConstants::ioMegabytesPerFrame;
+    stream_flight_io flightIo;
+    auto test_flight_counters = [&]()
+    {
+        stream_test_flight::counters now = {tileStreamer.tablesForced, tileStreamer.tablesDeferred, tileCache.loadsIssued, tileCache.refinesIssued};
+        return now;
+    };
 
     renderState.commandList->Close();
     ID3D12CommandList *commandListsSetup[] = {renderState.commandList};
@@ -796,9 +1164,11 @@ int main(void)
 
     QueryPerformanceFrequency(&qpc_freq);
 
+    Uint32 frameNumber = 0;
     programState.isRunning = true;
     while (programState.isRunning)
     {
+        frameNumber++;
         profiling.update_ms = qpc_ms(profiling.t0, profiling.t1);
         profiling.render_ms = qpc_ms(profiling.t1, profiling.t2);
         profiling.present_ms = qpc_ms(profiling.t2, profiling.t3);
@@ -898,6 +1268,7 @@ int main(void)
 
             if (baked_heightmap_mesh.created)
                 baked_heightmap_mesh.imgui_show_options();
+            streamTelemetry.imgui_show();
             ImGui::Text("Application average %.3f ms/frame (%.2f FPS)",
                         1000.0f / ImGui::GetIO().Framerate,
                         ImGui::GetIO().Framerate);
@@ -911,7 +1282,88 @@ int main(void)
             ImGui::SliderInt("Planet Scale 1:X", &planetScaleRatioDenom, 1, 100);
             constantBufferData.planetScaleRatio = 1.0f / (float)planetScaleRatioDenom;
 
-            ImGui::SliderInt("Clipmaps", &activeClipmapRings, 1, maxClipmapRings);
+            ImGui::Checkbox("Auto Clipmaps", &autoClipmapRings);
+            if (autoClipmapRings)
+            {
+                ImGui::SliderFloat("Clipmap Error (px)", &clipmapTargetErrorPixels, 0.5f, 16.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+                ImGui::Text("Clipmap rings: %d..%d, horizon %.0f, coverage %.0f", clipmapLod.firstRing, clipmapLod.ringCount - 1,
+                            clipmapLod.horizonDistance, clipmapLod.coverage);
+            }
+            else
+            {
+                ImGui::SliderInt("Clipmaps", &activeClipmapRings, 1, maxClipmapRings);
+                ImGui::SliderInt("Skipped Clipmaps", &skippedClipmapRings, 0, activeClipmapRings - 1);
+            }
+            ImGui::Text("Clipmap triangles: %u / %u (%u below horizon)", clipmapDrawList.trianglesSubmitted, clipmapDrawList.trianglesTotal,
+                        clipmapDrawList.trianglesBelowHorizon);
+            ImGui::Text("Height pyramid update: %.3f ms, %u texels", heightPyramidMs, heightPyramid.texelsUpdated);
+            if (heightOverviewFirstLevel < HeightPyramidConstants::levelCount)
+                ImGui::Text("Height overview: levels %d+ (step %d+), %.1f MB resident", heightOverviewFirstLevel, 1 << heightOverviewFirstLevel,
+                            (double)heightOverview.resident_bytes() / (1024.0 * 1024.0));
+            ImGui::Text("Tile cache: %d / %d resident, %u loads, %u reused, %u refines", tileCache.resident_count(), tileCache.slotCount,
+                        tileCache.loadsIssued, tileCache.tilesReused, tileCache.refinesIssued);
+            ImGui::Checkbox("Progressive Tiles", &progressiveTiles);
+            ImGui::Checkbox("Prefetch Tiles", &tileStreamer.prefetch);
+            ImGui::SliderFloat("Prefetch Look-ahead (s)", &tileStreamer.prefetchLookAheadSeconds, 0.0f, 10.0f, "%.1f");
+            ImGui::Checkbox("Speed Aware Streaming", &speedPolicy.enabled);
+            ImGui::Text("Speed: %.2f tiles/s, degradation %.2f, %s (%d tiles waiting), %u fast frames", speedPolicy.tilesPerSecond,
+                        speedPolicy.degradation, speedPolicy.defer_refines() ? "refines deferred" : "refining", refinesDeferredThisFrame,
+                        speedPolicy.fastFrames);
+            ImGui::SliderFloat("Test Flight Speed", &testFlightSpeed, 100.0f, 5000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+            ImGui::Checkbox("Deterministic Flight I/O", &deterministicFlightIo);
+            ImGui::SliderFloat("Flight Disk MB per Frame", &flightIoMegabytesPerFrame, 1.0f, 64.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+            if (!testFlight.active && ImGui::Button("Fly Test Route"))
+            {
+                // west edge to east edge through the middle row of the world
+                float midZ = (float)(worldManifest.minTileY + worldManifest.maxTileY + 1) * 0.5f * terrainTileInWorldUnits;
+                v3 from = {(float)worldManifest.minTileX * terrainTileInWorldUnits, 0.0f, midZ};
+                v3 to = {(float)(worldManifest.maxTileX + 1) * terrainTileInWorldUnits, 0.0f, midZ};
+                testFlight.begin(from, to, testFlightSpeed, test_flight_counters());
+            }
+            if (testFlight.active || testFlight.finished)
+                ImGui::Text("Test flight%s: %u frames, %u missing window tiles (longest %u), %u forced, %u deferred, %u loads, %u refines",
+                            testFlight.active ? " (flying)" : "", testFlight.frames, testFlight.stallFrames, testFlight.longestStall,
+                            testFlight.delta.forcedPublishes, testFlight.delta.deferredFrames, testFlight.delta.loadsIssued, testFlight.delta.refinesIssued);
+            ImGui::Text("Prefetches: %u, needed but not resident: %d now, %u total", tileCache.prefetchesIssued,
+                        tileStreamer.notResident, tileCache.tilesNeededNotResident);
+            ImGui::Text("Shared tiles: %d in the window now, %u on window moves", tilesSharedThisFrame, tileCache.tilesShared);
+            ImGui::Text("Constant tiles: %d in the window now, %u loads skipped on window moves", tilesConstantThisFrame, constantLoadsSkipped);
+            for (int layer = 0; layer < TILE_LAYER_COUNT; ++layer)
+            {
+                const tile_archive_dedup_stats &dedup = tileArchive.dedup[layer];
+                ImGui::Text("Dedup %s: %u / %u unique, %.0f MB memory, %.0f MB reads saved", tileLayerNames[layer], dedup.uniquePayloads,
+                            dedup.entries, (double)dedup.duplicateBytes / (1024.0 * 1024.0), (double)dedup.duplicateStored / (1024.0 * 1024.0));
+            }
+            ImGui::Text("Tile tables: %u published (%u forced), %u frames deferred", tileStreamer.tablesPublished, tileStreamer.tablesForced, tileStreamer.tablesDeferred);
+            ImGui::Text("Stream queue: %u deep (peak %u), %u done, %u cancelled, %u failed", streamRequests.depth.load(), streamRequests.peakDepth,
+                        streamRequests.completed.load(), streamRequests.cancelled.load(), streamRequests.failed.load());
+            ImGui::Text("Copy queue: %u batches, %u copies, %.0f MB staged, ring %.1f / %.0f MB", streamUploader.batchesSubmitted,
+                        streamUploader.copiesRecorded.load(), (double)streamUploader.bytesStaged.load() / (1024.0 * 1024.0),
+                        (double)streamUploader.ringUsed.load() / (1024.0 * 1024.0), (double)streamUploader.capacity() / (1024.0 * 1024.0));
+            if (tileArchive.decodedBytes.load() > 0)
+            {
+                double decodedMB = (double)tileArchive.decodedBytes.load() / (1024.0 * 1024.0);
+                double decodeSeconds = (double)tileArchive.decodeTicks.load() / (double)SDL_GetPerformanceFrequency();
+                ImGui::Text("Tile decode: %.0f MB, ratio %.2f, %.0f MB/s", decodedMB,
+                            (double)tileArchive.decodedBytes.load() / (double)tileArchive.decodedStoredBytes.load(),
+                            decodeSeconds > 0.0 ? decodedMB / decodeSeconds : 0.0);
+            }
+            if (tileReaderOpen)
+            {
+                bool useAsyncTileIo = asyncTileIo.load();
+                if (ImGui::Checkbox("Async Tile I/O", &useAsyncTileIo))
+                    asyncTileIo = useAsyncTileIo;
+                Uint64 reads = tileReader.readsCompleted.load() + tileReader.readsFailed.load();
+                double readMB = (double)tileReader.bytesRead.load() / (1024.0 * 1024.0);
+                double busySeconds = (double)tileReader.busyTicks.load() / (double)SDL_GetPerformanceFrequency();
+                ImGui::Text("Tile I/O (%s): depth %.1f avg, %u peak, %.0f MB/s, %llu failed", async_io_backend_name(tileReader.backend),
+                            reads > 0 ? (double)tileReader.depthSum.load() / (double)reads : 0.0, tileReader.peakDepth.load(),
+                            busySeconds > 0.0 ? readMB / busySeconds : 0.0, (unsigned long long)tileReader.readsFailed.load());
+            }
+            if (virtualAlbedo)
+                ImGui::Text("Albedo pages: %d / %d resident, %d wanted not resident, %u loaded, %u evicted, %u failed",
+                            albedoPageCache.resident_count(), VirtualTextureConstants::physicalPages, pagesWantedNotResident,
+                            albedoPageCache.pagesLoaded, albedoPageCache.pagesEvicted, albedoPageCache.pagesFailed);
 
             ImGui::SliderFloat("Debug Speed Boost", &debugBoostSpeed, 1.0f, 5000.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
             ImGui::SliderFloat("Debug Scaler", &constantBufferData.debug_scaler, 0.25f, 4.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
@@ -1085,6 +1537,34 @@ int main(void)
         cameraYaw -= mouseXrel * deltaTime * 0.05f;
         cameraYaw -= rx * deltaTime * 3.5f;
 
+        // the test flight moves the camera on its own timestep
+        bool testFlightWasActive = testFlight.active;
+        bool testFlightStarting = testFlight.active && testFlight.time == 0.0f;
+        v3 testFlightPos = {};
+        bool flying = testFlight.advance(testFlightPos, deltaTime);
+        if (flying)
+        {
+            cameraYaw = atan2f(testFlight.direction.z, testFlight.direction.x);
+            cameraPitch = 0.0f;
+            if (testFlightStarting)
+            {
+                // the jump to the start isn't motion, prediction starts from rest like every other run
+                tileStreamer.lastPos = testFlightPos;
+                tileStreamer.velocity = {};
+                flightIo.credit = 0;
+            }
+        }
+        else if (testFlightWasActive)
+        {
+            SDL_Log("Test flight at %.0f units/s%s, %s: %u frames, %u with window tiles missing (longest run %u), %u forced publishes, "
+                    "%u deferred, %u loads, %u refines",
+                    testFlight.cruiseSpeed, speedPolicy.enabled ? "" : " (speed policy off)",
+                    deterministicFlightIo ? "deterministic I/O" : "wall clock I/O", testFlight.frames, testFlight.stallFrames,
+                    testFlight.longestStall, testFlight.delta.forcedPublishes, testFlight.delta.deferredFrames, testFlight.delta.loadsIssued,
+                    testFlight.delta.refinesIssued);
+            streamTelemetry.dump_csv("flight_loads.csv", "flight_frames.csv");
+        }
+
         v3 worldUp = {0.0f, 1.0f, 0.0f};
 
         v3 cameraForward = {};
@@ -1101,79 +1581,215 @@ int main(void)
         static float strafeSpeed = 0.0f;
         strafeSpeed = inputMotionXAxis * deltaTime * debugBoostSpeed;
 
-        cameraPos = cameraPos + (cameraForward * forwardSpeed);
-        cameraPos = cameraPos + (cameraRight * strafeSpeed);
+        if (flying)
+        {
+            cameraPos = testFlightPos;
+        }
+        else
+        {
+            cameraPos = cameraPos + (cameraForward * forwardSpeed);
+            cameraPos = cameraPos + (cameraRight * strafeSpeed);
+        }
 
         // ...existing code...
-        // streaming architecture
-        int lastTileX = programState.tileX;
-        int lastTileY = programState.tileY;
-
-        programState.tileX = floor(cameraPos.x / terrainTileInWorldUnits);
-        programState.tileY = floor(cameraPos.z / terrainTileInWorldUnits);
-
-        // v3 vcamOffset = {programState.tileX * terrainTileInWorldUnits, 0, programState.tileY * terrainTileInWorldUnits};
-        // programState.virtualCamPos = cameraPos - vcamOffset;
-        // compute base tile for camera, then pick a start tile so camera is centered in the visible window
-        int baseTileX = (int)floor(cameraPos.x / terrainTileInWorldUnits);
-        int baseTileY = (int)floor(cameraPos.z / terrainTileInWorldUnits);
-        int halfW = (int)(visibleTileWidth / 2);
-
-        int startTileX = baseTileX - halfW;
-        int startTileY = baseTileY - halfW;
-        // clamp start so the visible window is always fully inside the world bounds
-        startTileX = SDL_clamp(startTileX, 0, (int)worldSizeTerrainTilesW - (int)visibleTileWidth);
-        startTileY = SDL_clamp(startTileY, 0, (int)worldSizeTerrainTilesH - (int)visibleTileWidth);
-
-        programState.tileX = startTileX;
-        programState.tileY = startTileY;
-
-        v3 vcamOffset = {programState.tileX * terrainTileInWorldUnits, 0, programState.tileY * terrainTileInWorldUnits};
-        programState.virtualCamPos = cameraPos - vcamOffset;
-        
+        // streaming architecture, see tile_streaming.h. The wanted window is centred on the camera, fully inside
+        // the world bounds, the shaders keep drawing the published one (programState.tileX/Y) until it's complete.
+        // deterministic flight I/O: the previous frame retires first, so the same slots are pinned on every run
+        const bool deterministicIo = flying && deterministicFlightIo;
+        const UINT64 lastFrameFenceValue = fenceValues[frameIndex] - 1;
+        if (deterministicIo && renderState.fence->GetCompletedValue() < lastFrameFenceValue)
+            renderState.fence->SetEventOnCompletion(lastFrameFenceValue, nullptr); // no event blocks
+        tileStreamer.begin_frame(cameraPos, deltaTime, renderState.fence->GetCompletedValue(), fenceValues[frameIndex]);
+        int tileRequestsIssued = 0;
+        auto issue_tile_requests = [&]()
+        {
+            for (; tileRequestsIssued < tileStreamer.requestCount; ++tileRequestsIssued)
+            {
+                const tile_stream_request &request = tileStreamer.requests[tileRequestsIssued];
+                if (request.layers)
+                    request_tile_load(request.slot, request.x, request.y, request.speculative, request.layers);
+                else
+                    request_tile_refine(request.slot, request.x, request.y, request.speculative);
+            }
+        };
 
-        bool updateThisFrame = false;
-        if (programState.tileX != lastTileX)
+        // streamed tiles: take over finished loads, then make sure every window tile has a slot
+        heightPyramid.texelsUpdated = 0;
         {
-            lastTileX = programState.tileX;
-            updateThisFrame = true;
+            // a load counts once its copies are on the GPU, until then it waits here
+            tile_load_result landed;
+            while (tileLoadsCompleted.pop(landed))
+            {
+                tileLoadsLanding.push_back(landed);
+                tileLoadsInFlight--;
+            }
+            size_t landing = tileLoadsLanding.size();
+            if (deterministicIo)
+            {
+                // every load issued so far finishes and its copies go out behind the retired frame, then they
+                // land at the flight's disk rate. Ones superseded while waiting are dropped unread.
+                while (tileLoadsInFlight > 0)
+                {
+                    // a load out of ring space waits for the open batch, which only this thread submits
+                    if (streamUploader.submit_wanted() && !streamUploader.flush(renderState.fence, lastFrameFenceValue))
+                        return 1;
+                    std::this_thread::yield();
+                    while (tileLoadsCompleted.pop(landed))
+                    {
+                        tileLoadsLanding.push_back(landed);
+                        tileLoadsInFlight--;
+                    }
+                }
+                if (!streamUploader.flush(renderState.fence, lastFrameFenceValue))
+                    return 1;
+                UINT64 uploadFence = 0;
+                for (tile_load_result &result : tileLoadsLanding)
+                {
+                    uploadFence = SDL_max(uploadFence, result.uploadFence);
+                    if (tileSlotTokens[result.slot].current() != result.generation)
+                    {
+                        result.cancelled = true;
+                        result.timing.bytes = 0;
+                    }
+                }
+                streamUploader.wait(uploadFence);
+                flightIo.bytesPerFrame = (Uint64)(flightIoMegabytesPerFrame * 1024.0f * 1024.0f);
+                landing = flightIo.landing(tileLoadsLanding.data(), tileLoadsLanding.size());
+            }
+            const UINT64 uploadsCompleted = streamUploader.completed();
+            size_t kept = 0;
+            for (size_t i = 0; i < tileLoadsLanding.size(); ++i)
+            {
+                tile_load_result &result = tileLoadsLanding[i];
+                if (i >= landing || (result.ok && result.uploadFence > uploadsCompleted))
+                {
+                    tileLoadsLanding[kept++] = result;
+                    continue;
+                }
+                tileStreamer.landed(result.slot, result.refine, result.cancelled || !result.ok, result.minMip);
+                stream_load_record record = {};
+                record.timing = result.timing;
+                record.tileX = result.tileX;
+                record.tileY = result.tileY;
+                record.albedo = result.albedo;
+                record.speculative = result.speculative;
+                record.refine = result.refine;
+                record.ok = result.ok;
+                record.cancelled = result.cancelled;
+                streamTelemetry.load_finished(result.slot, record);
+                if (!result.albedo && result.ok && !result.cancelled)
+                {
+                    heightTileSource.insert(result.mips, programState.tileX, programState.tileY, (int)visibleTileWidth);
+                    heightPyramid.invalidate_tile(result.mips.tileX, result.mips.tileY, heightTileSource);
+                }
+                else
+                {
+                    result.mips.release(); // built before an upload that failed, or for a load that was dropped
+                }
+            }
+            tileLoadsLanding.resize(kept);
         }
-        if (programState.tileY != lastTileY)
+
+        tileStreamer.stream_window(frameNumber);
+        issue_tile_requests();
+        tilesSharedThisFrame = 0;
+        tilesConstantThisFrame = 0;
+        refinesDeferredThisFrame = 0;
+        Uint64 frameTicks = SDL_GetPerformanceCounter();
+        for (int i = 0; i < tileStreamer.windowTileCount; ++i)
         {
-            lastTileY = programState.tileY;
-            updateThisFrame = true;
+            const tile_stream_window_tile &tile = tileStreamer.windowTiles[i];
+            int x = tile.x;
+            int y = tile.y;
+            if (worldManifest.find(x, y) < 0)
+                continue; // a hole in the world, drawn flat without a slot
+            Uint32 constantLayers = tileArchive.constant_layers(x, y);
+            if (constantLayers)
+            {
+                tilesConstantThisFrame++;
+                constantLoadsSkipped += tileStreamer.windowMoved ? (Uint32)tile_streamer::layer_count(constantLayers & tileSlotLayers) : 0;
+            }
+            // the height pyramid reads CPU copies by tile, a constant height is filled in
+            const tile_archive_entry *heightConstant = tileArchive.constant_entry(TILE_LAYER_HEIGHT, x, y);
+            if (heightConstant && !heightTileSource.find_tile(x, y))
+            {
+                height_tile_mips mips = {};
+                if (mips.fill((Uint16)heightConstant->chunkCount, x, y))
+                {
+                    heightTileSource.insert(mips, programState.tileX, programState.tileY, (int)visibleTileWidth);
+                    heightPyramid.invalidate_tile(x, y, heightTileSource);
+                }
+            }
+            tilesSharedThisFrame += tile.shared ? 1 : 0;
+            if (tile.slot < 0 || tileCache.slots[tile.slot].state != TILE_SLOT_RESIDENT)
+                continue;
+            // duplicates point at the slot of the first tile with their content, and get a copy of its heights
+            const tile_slot &slot = tileCache.slots[tile.slot];
+            if (tile.shared && !heightConstant && !heightTileSource.find_tile(x, y))
+            {
+                const height_tile_mips *owner = heightTileSource.find_tile(slot.tileX, slot.tileY);
+                height_tile_mips mips = {};
+                if (owner && mips.clone(*owner, x, y))
+                {
+                    heightTileSource.insert(mips, programState.tileX, programState.tileY, (int)visibleTileWidth);
+                    heightPyramid.invalidate_tile(x, y, heightTileSource);
+                }
+            }
+            streamTelemetry.tile_used(tile.slot, frameTicks);
+            refinesDeferredThisFrame += tileCache.needs_refine(tile.slot) && speedPolicy.defer_refines() ? 1 : 0;
         }
-        
-        endingSegmentX = SDL_clamp(programState.tileX + visibleTileWidth, 0, worldSizeTerrainTilesW);
-        endingSegmentY = SDL_clamp(programState.tileY + visibleTileWidth, 0, worldSizeTerrainTilesH);
-
-        if (updateThisFrame)
+        streamTelemetry.end_frame(streamRequests.depth.load(), tileStreamer.notResident);
+        if (flying)
+            testFlight.frame_finished(tileStreamer.notResident, test_flight_counters());
+
+        tileStreamer.stream_prediction(cameraPos, deltaTime, frameNumber);
+        issue_tile_requests();
+        tileStreamer.drop_unwanted(frameNumber);
+        for (int i = 0; i < tileStreamer.supersededCount; ++i)
+            tileSlotTokens[tileStreamer.superseded[i]].supersede();
+
+        // window slot -> physical slot, rewritten when a new window goes out or loads landed in a forced one
+        if (tileStreamer.publish(fenceValues[frameIndex]))
         {
-            uint32_t indexVisibleTiles = 0;
-            for (uint32_t y = programState.tileY; y < endingSegmentY; ++y)
+            const tile_window &publishWindow = tileStreamer.published;
+            for (int wy = 0; wy < publishWindow.h; ++wy)
             {
-                for (uint32_t x = programState.tileX; x < endingSegmentX; ++x)
+                for (int wx = 0; wx < publishWindow.w; ++wx)
                 {
-                    uint32_t fn_i = x + y * worldSizeTerrainTilesW;
-                    // copy filenames into wstrings for safe capture
-                    std::wstring hf = heightmapFilenames[fn_i];
-                    std::wstring af = albedoFilenames[fn_i];
-
-                    d3d12_bindless_texture *htex = &heightTiles[indexVisibleTiles];
-                    d3d12_bindless_texture *atex = &albedoTiles[indexVisibleTiles];
-
+                    int index = wx + wy * publishWindow.w;
+                    int x = publishWindow.x + wx;
+                    int y = publishWindow.y + wy;
+                    bool inWorld = worldManifest.find(x, y) >= 0;
+                    Uint32 loads = inWorld ? tile_slot_loads(x, y) : 0;
+                    int slot = tileStreamer.publishedSlots[index];
+                    // .y flags a tile the world doesn't have or that isn't in yet, the shaders draw it flat and skip its slot
+                    if (!inWorld || (loads != 0 && slot < 0))
                     {
-                        std::lock_guard<std::mutex> lk(streamMutex);
-                        streamJobs.emplace([htex, hf]()
-                                           { htex->update_data(hf.c_str()); });
-                        streamJobs.emplace([atex, af]()
-                                           { atex->update_data(af.c_str()); });
+                        terrainStreamingCBData.heightSRV[index].y = 1;
+                        continue;
                     }
-                    indexVisibleTiles++;
+                    // layers stored as a value ride in the table: .y 2 and the height in .z, albedo .z 1 (2 for sRGB)
+                    // and the colour in .w. A tile with nothing loaded has no slot, its indices are never sampled.
+                    const tile_archive_entry *heightConstant = tileArchive.constant_entry(TILE_LAYER_HEIGHT, x, y);
+                    const tile_archive_entry *albedoConstant = virtualAlbedo ? nullptr : tileArchive.constant_entry(TILE_LAYER_ALBEDO, x, y);
+                    UINT albedoConstantFlag = 0;
+                    if (albedoConstant)
+                    {
+                        DXGI_FORMAT format = (DXGI_FORMAT)albedoConstant->format;
+                        bool srgb = format == DXGI_FORMAT_BC1_UNORM_SRGB || format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+                        albedoConstantFlag = srgb ? 2 : 1;
+                    }
+                    UINT slotIndex = slot >= 0 ? (UINT)slot : 0;
+                    terrainStreamingCBData.heightSRV[index] = DirectX::XMUINT4(slotIndex, heightConstant ? 2 : 0, heightConstant ? heightConstant->chunkCount : 0, 0);
+                    terrainStreamingCBData.albedoSRV[index] = DirectX::XMUINT4(tileSlotCount + slotIndex, slot >= 0 ? tileCache.slots[slot].minMip : 0,
+                                                                               albedoConstantFlag, albedoConstant ? albedoConstant->chunkCount : 0);
                 }
             }
-            streamCv.notify_all();
         }
+        programState.tileX = tileStreamer.published.x;
+        programState.tileY = tileStreamer.published.y;
+        v3 vcamOffset = {programState.tileX * terrainTileInWorldUnits, 0, programState.tileY * terrainTileInWorldUnits};
+        programState.virtualCamPos = cameraPos - vcamOffset;
         // ...existing code...
 
         QueryPerformanceCounter(&profiling.t1);
@@ -1201,8 +1817,150 @@ int main(void)
         DirectX::XMStoreFloat4x4(&constantBufferData.view, view);
         DirectX::XMStoreFloat4x4(&constantBufferData.projection, projection);
 
-        sceneCB.upload(&constantBufferData, sizeof(constantBufferData));
-        terrainStreamingCB.upload(&terrainStreamingCBData, sizeof(terrainStreamingCBData));
+        float h = cameraPos.y;
+        float halfFov = fov * 0.5f;
+
+        float bottomRayAngle = cameraPitch - halfFov;
+        if (bottomRayAngle > -0.001f)
+            bottomRayAngle = -0.001f;
+
+        float L = h / tanf(-bottomRayAngle);
+
+        float forwardDistance = (L > 0.0f) ? L : 0.0f;
+
+        v3 cmFwd2D = cameraForward;
+        cmFwd2D.y = 0;                     // for ground level
+        cmFwd2D = v3::normalised(cmFwd2D); // TODO: note debug scaler here
+
+        v3 clipmapCentreLocation = programState.virtualCamPos + cmFwd2D * forwardDistance;
+        // v3 clipmapCentreLocation = cameraPos + cmFwd2D * (terrainGridDimensionInWorldUnits / 2);
+
+        // clipmap pieces, culled on the CPU and grouped so each piece shape is one instanced draw
+        DirectX::XMFLOAT4X4 viewProjection;
+        DirectX::XMStoreFloat4x4(&viewProjection, view * projection);
+        frustum cameraFrustum;
+        cameraFrustum.from_view_projection(&viewProjection._11);
+
+        const float terrainHeightScale = 5000.0f * 0.03f; // artistScale in shaders.hlsl
+        const float planetRadiusUnscaled = 600000.0f;     // planetRadius in shaders.hlsl
+        clipmap_cull_params clipmapCull = {};
+        clipmapCull.cameraPos = programState.virtualCamPos;
+        clipmapCull.minHeight = 0.0f;
+        const float heightRange = terrainHeightScale * constantBufferData.debug_scaler; // a height texel of 1.0
+        clipmapCull.maxHeight = ((float)worldManifest.maxHeight / 65535.0f) * heightRange; // highest tile in the world
+        clipmapCull.planetRadius = planetRadiusUnscaled * constantBufferData.planetScaleRatio;
+        // per tile height bounds for the streamed window, tiles still loading fall back to maxHeight, holes are flat
+        float windowTileMaxHeight[visibleTileNum];
+        for (uint32_t t = 0; t < visibleTileNum; ++t)
+        {
+            int tileX = programState.tileX + (int)(t % visibleTileWidth);
+            int tileY = programState.tileY + (int)(t / visibleTileWidth);
+            const height_tile_mips *tile = heightTileSource.find_tile(tileX, tileY);
+            if (worldManifest.find(tileX, tileY) < 0)
+                windowTileMaxHeight[t] = 0.0f;
+            else
+                windowTileMaxHeight[t] = tile ? ((float)tile->maxHeight / 65535.0f) * heightRange : clipmapCull.maxHeight;
+        }
+        clipmapCull.regionMaxHeight = windowTileMaxHeight;
+        clipmapCull.regionCountX = (int)visibleTileWidth;
+        clipmapCull.regionCountZ = (int)visibleTileWidth;
+        clipmapCull.regionSize = terrainTileInWorldUnits;
+        if (autoClipmapRings)
+        {
+            v3 centreOffset = clipmapCentreLocation - programState.virtualCamPos;
+            clipmap_lod_params lodParams = {};
+            lodParams.cameraHeight = programState.virtualCamPos.y;
+            lodParams.centreOffset = SDL_sqrtf(centreOffset.x * centreOffset.x + centreOffset.z * centreOffset.z);
+            lodParams.fovY = fov;
+            lodParams.screenHeight = (float)height;
+            lodParams.targetErrorPixels = clipmapTargetErrorPixels * speedPolicy.error_scale(); // coarser near rings at speed
+            lodParams.maxTerrainHeight = clipmapCull.maxHeight;
+            lodParams.planetRadius = clipmapCull.planetRadius;
+            lodParams.maxViewDistance = farZ;
+            clipmapLod = clipmap_select_lod(lodParams);
+            skippedClipmapRings = clipmapLod.firstRing;
+            activeClipmapRings = clipmapLod.ringCount;
+        }
+        clipmapDrawList.build(clipmapCentreLocation, skippedClipmapRings, activeClipmapRings, cameraFrustum, clipmapCull);
+
+        for (int i = 0; i < clipmapDrawList.ringCount; ++i)
+        {
+            const clipmap_ring &ring = clipmapDrawList.rings[i];
+            constantBufferData.clipmapRings[i] = DirectX::XMFLOAT4A(ring.originX, ring.originZ, ring.sampleStep, (float)i);
+        }
+
+        // height pyramid: scroll the coarse levels with their rings
+        LARGE_INTEGER heightPyramidT0, heightPyramidT1;
+        QueryPerformanceCounter(&heightPyramidT0);
+        constantBufferData.terrainWindowOriginX = programState.tileX * (int)terrainTileInWorldUnits;
+        constantBufferData.terrainWindowOriginZ = programState.tileY * (int)terrainTileInWorldUnits;
+        for (int i = SDL_max(HeightPyramidConstants::firstLevel, clipmapDrawList.firstRing); i < clipmapDrawList.ringCount; ++i)
+        {
+            const clipmap_ring &ring = clipmapDrawList.rings[i];
+            // absolute level texels, ring origins are relative to the streamed window
+            int levelOriginX = (int)floorf(ring.originX / ring.sampleStep + 0.5f) + (constantBufferData.terrainWindowOriginX >> i);
+            int levelOriginZ = (int)floorf(ring.originZ / ring.sampleStep + 0.5f) + (constantBufferData.terrainWindowOriginZ >> i);
+            heightPyramid.update(i, levelOriginX, levelOriginZ, heightTileSource);
+        }
+        QueryPerformanceCounter(&heightPyramidT1);
+        heightPyramidMs = qpc_ms(heightPyramidT0, heightPyramidT1);
+
+        // albedo pages: touch what the view needs, start loads for what's missing, nearest and coarsest first
+        if (virtualAlbedo)
+        {
+            vt_footprint_params footprint = {};
+            footprint.cameraPos = programState.virtualCamPos;
+            footprint.view = &cameraFrustum;
+            footprint.pixelsPerRadian = (float)height / (2.0f * tanf(fov * 0.5f)) / speedPolicy.error_scale();
+            footprint.tileWorldSize = terrainTileInWorldUnits;
+            footprint.windowX = programState.tileX;
+            footprint.windowY = programState.tileY;
+            footprint.windowW = (int)visibleTileWidth;
+            footprint.windowH = (int)visibleTileWidth;
+            footprint.minHeight = clipmapCull.minHeight;
+            footprint.maxHeight = clipmapCull.maxHeight;
+            footprint.planetRadius = clipmapCull.planetRadius;
+            int requestCount = vt_collect_footprint(albedoPages, footprint, pageRequests, VirtualTextureConstants::maxRequests);
+            SDL_qsort(pageRequests, (size_t)requestCount, sizeof(vt_page_request), vt_page_request_compare);
+
+            // touch first so nothing wanted this frame gets evicted for another wanted page
+            pagesWantedNotResident = 0;
+            for (int i = 0; i < requestCount; ++i)
+            {
+                int page = albedoPageCache.find(pageRequests[i].key);
+                if (page >= 0)
+                    albedoPageCache.pages[page].lastUsedFrame = frameNumber;
+                if (page < 0 || albedoPageCache.pages[page].state != VT_PAGE_RESIDENT)
+                    pagesWantedNotResident++;
+            }
+            int loadsStarted = 0;
+            for (int i = 0; i < requestCount && loadsStarted < VirtualTextureConstants::maxLoadsPerFrame; ++i)
+            {
+                if (albedoPageCache.find(pageRequests[i].key) >= 0)
+                    continue;
+                int page = albedoPageCache.acquire(pageRequests[i].key, frameNumber);
+                if (page < 0)
+                    break; // every page is wanted or loading
+                request_page_load(page, pageRequests[i].key, pageRequests[i].priority);
+                loadsStarted++;
+            }
+            // an evicted page or a load that failed on the spot changes the table
+            albedoPageTable.dirty |= loadsStarted > 0;
+
+            // drop queued reads the view moved away from, like the tile slots
+            for (int i = 0; i < VirtualTextureConstants::physicalPages; ++i)
+            {
+                vt_physical_page &page = albedoPageCache.pages[i];
+                if (page.state == VT_PAGE_LOADING && !page.cancelRequested && page.lastUsedFrame != frameNumber)
+                {
+                    page.cancelRequested = true;
+                    albedoPageTokens[i].supersede();
+                }
+            }
+        }
+
+        sceneCB.upload(&constantBufferData, sizeof(constantBufferData), frameIndex);
+        terrainStreamingCB.upload(&terrainStreamingCBData, sizeof(terrainStreamingCBData), frameIndex);
 
         if (enableImgui)
             ImGui::Render();
@@ -1228,10 +1986,10 @@ int main(void)
 
         renderState.commandList->SetGraphicsRootConstantBufferView(
             0, // root parameter index
-            sceneCB.constantBuffer->GetGPUVirtualAddress());
+            sceneCB.gpu_address(frameIndex));
         renderState.commandList->SetGraphicsRootConstantBufferView(
             1,
-            terrainStreamingCB.constantBuffer->GetGPUVirtualAddress());
+            terrainStreamingCB.gpu_address(frameIndex));
 
         D3D12_GPU_DESCRIPTOR_HANDLE srvStart =
             renderState.srvHeap->GetGPUDescriptorHandleForHeapStart();
@@ -1273,69 +2031,127 @@ int main(void)
         // terrain render
         renderState.commandList->SetPipelineState(terrainPSO.pipelineState);
         if (baked_heightmap_mesh.created)
-            baked_heightmap_mesh.draw(cameraPos);
+            baked_heightmap_mesh.draw(cameraPos, 600000.0f * constantBufferData.planetScaleRatio);
 
         renderState.commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        renderState.commandList->IASetVertexBuffers(0, 1, &terrainGridVB.vertexBufferView);
 
         // renderState.commandList->SetGraphicsRootConstantBufferView(0, renderState.constantBuffer->GetGPUVirtualAddress());
 
         // TODO:
         //  draw max detail mesh here?
 
-        // NOTE: start at 1 for clipmap rings only
-
-        float h = cameraPos.y;
-        float halfFov = fov * 0.5f;
-
-        float bottomRayAngle = cameraPitch - halfFov;
-        if (bottomRayAngle > -0.001f)
-            bottomRayAngle = -0.001f;
-
-        float L = h / tanf(-bottomRayAngle);
-
-        float forwardDistance = (L > 0.0f) ? L : 0.0f;
-
-        v3 cmFwd2D = cameraForward;
-        cmFwd2D.y = 0;                     // for ground level
-        cmFwd2D = v3::normalised(cmFwd2D); // TODO: note debug scaler here
-
-        v3 clipmapCentreLocation = programState.virtualCamPos + cmFwd2D * forwardDistance;
-        // v3 clipmapCentreLocation = cameraPos + cmFwd2D * (terrainGridDimensionInWorldUnits / 2);
-
-        for (int i = 0; i < activeClipmapRings; ++i)
+        // dirty pyramid levels go up whole, the toroidal layout means the texels never need reordering
         {
-            float lodScale = (float)(1 << i);
-            // constantBufferData.ringWorldSize = baseGridSize * lodScale;
-            constantBufferData.ringSampleStep = lodScale;
-
-            // Snap camera position to sample grid to avoid jitter
-            float snappedX = floor(clipmapCentreLocation.x / lodScale) * lodScale;
-            float snappedZ = floor(clipmapCentreLocation.z / lodScale) * lodScale;
-
-            constantBufferData.ringOffset.x = snappedX;
-            constantBufferData.ringOffset.y = snappedZ;
-
-            // update constant buffer
-
-            DirectX::XMStoreFloat4x4(&constantBufferData.world, DirectX::XMMatrixIdentity());
+            byte *uploadSlice = reinterpret_cast<byte *>(heightPyramidUpload.mappedData) + frameIndex * heightPyramidSliceSize;
+            bool copyRecorded = false;
+            for (int i = HeightPyramidConstants::firstLevel; i < HeightPyramidConstants::levelCount; ++i)
+            {
+                clipmap_height_level &level = heightPyramid.levels[i];
+                if (!level.dirty)
+                    continue;
+                if (!copyRecorded)
+                    heightPyramidTexture.transition(renderState.commandList, D3D12_RESOURCE_STATE_COPY_DEST);
+                UINT64 offset = frameIndex * heightPyramidSliceSize + i * heightLevelUploadSize;
+                memcpy(uploadSlice + i * heightLevelUploadSize, level.texels, heightLevelUploadSize);
+                heightPyramidTexture.copy_slice_from_buffer(renderState.commandList, heightPyramidUpload.buffer, offset, (UINT)i, heightLevelRowPitch);
+                level.dirty = false;
+                copyRecorded = true;
+            }
+            if (copyRecorded || heightPyramidNeedsBarrier)
+            {
+                heightPyramidTexture.transition(renderState.commandList, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+                heightPyramidNeedsBarrier = false;
+            }
+        }
 
-            UINT cbOffset = i * sceneCB.constantBufferSize;
-            memcpy(reinterpret_cast<byte *>(sceneCB.CbvDataBegin) + cbOffset, &constantBufferData, sizeof(constantBufferData));
-            renderState.commandList->SetGraphicsRootConstantBufferView(0, sceneCB.constantBuffer->GetGPUVirtualAddress() + cbOffset);
+        // finished albedo pages go into their cache slices, then the page table follows whenever it changed
+        if (virtualAlbedo)
+        {
+            vt_page_load_result pageResult;
+            while (pageLoadsCompleted.pop(pageResult))
+                pageUploadsPending.push_back(pageResult);
+            const UINT64 sliceOffset = frameIndex * pageUploadSliceSize;
+            byte *uploadSlice = reinterpret_cast<byte *>(albedoPageUpload.mappedData) + sliceOffset;
+            bool copyRecorded = false;
+            int uploads = 0;
+            size_t kept = 0;
+            for (size_t i = 0; i < pageUploadsPending.size(); ++i)
+            {
+                vt_page_load_result &result = pageUploadsPending[i];
+                if (!result.ok)
+                {
+                    albedoPageCache.load_finished(result.page, false);
+                    albedoPageTable.dirty = true;
+                    continue;
+                }
+                if (uploads == VirtualTextureConstants::maxUploadsPerFrame)
+                {
+                    pageUploadsPending[kept++] = result;
+                    continue;
+                }
+                if (!copyRecorded)
+                {
+                    albedoPageTexture.transition(renderState.commandList, D3D12_RESOURCE_STATE_COPY_DEST);
+                    albedoPageTableTexture.transition(renderState.commandList, D3D12_RESOURCE_STATE_COPY_DEST);
+                }
+                byte *dst = uploadSlice + uploads * pageUploadSize;
+                for (Uint32 row = 0; row < albedoPages.rows; ++row)
+                    memcpy(dst + row * pageUploadPitch, result.pixels->data + row * albedoPages.rowBytes, albedoPages.rowBytes);
+                albedoPageTexture.copy_slice_from_buffer(renderState.commandList, albedoPageUpload.buffer, sliceOffset + uploads * pageUploadSize,
+                                                         (UINT)result.page, pageUploadPitch);
+                tileDecodeBuffers.release(result.pixels);
+                albedoPageCache.load_finished(result.page, true);
+                albedoPageTable.dirty = true;
+                copyRecorded = true;
+                uploads++;
+            }
+            pageUploadsPending.resize(kept);
 
-            UINT localIndexCount = clipmapRing.indexCount;
-            if (i == 0)
+            if (albedoPageTable.dirty || windowMoved)
             {
-                renderState.commandList->IASetIndexBuffer(&terrainGridCentreIB.indexBufferView);
-                localIndexCount = clipmapCentre.indexCount;
+                albedoPageTable.rebuild(albedoPageCache, programState.tileX * albedoPages.pagesPerTileSide, programState.tileY * albedoPages.pagesPerTileSide);
+                if (!copyRecorded)
+                {
+                    albedoPageTexture.transition(renderState.commandList, D3D12_RESOURCE_STATE_COPY_DEST);
+                    albedoPageTableTexture.transition(renderState.commandList, D3D12_RESOURCE_STATE_COPY_DEST);
+                }
+                UINT64 offset = VirtualTextureConstants::maxUploadsPerFrame * pageUploadSize;
+                for (int mip = 0; mip < albedoPageTable.mipCount; ++mip)
+                {
+                    UINT side = (UINT)SDL_max(albedoPageTable.dim >> mip, 1);
+                    UINT pitch = (side * sizeof(Uint32) + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+                    for (UINT row = 0; row < side; ++row)
+                        memcpy(uploadSlice + offset + row * pitch, albedoPageTable.mips[mip] + row * side, side * sizeof(Uint32));
+                    albedoPageTableTexture.copy_slice_from_buffer(renderState.commandList, albedoPageUpload.buffer, sliceOffset + offset, 0, pitch, (UINT)mip);
+                    offset += ((UINT64)pitch * side + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~(UINT64)(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+                }
+                copyRecorded = true;
             }
-            else
+            if (copyRecorded || albedoPagesNeedBarrier)
             {
-                renderState.commandList->IASetIndexBuffer(&terrainGridRingIB.indexBufferView);
-                localIndexCount = clipmapRing.indexCount;
+                albedoPageTexture.transition(renderState.commandList, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+                albedoPageTableTexture.transition(renderState.commandList, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+                albedoPagesNeedBarrier = false;
             }
-            renderState.commandList->DrawIndexedInstanced(localIndexCount, 1, 0, 0, 0);
+        }
+
+        UINT instanceSliceOffset = frameIndex * clipmapInstanceSliceSize;
+        memcpy(reinterpret_cast<byte *>(clipmapInstanceVB.mappedData) + instanceSliceOffset,
+               clipmapDrawList.instances,
+               clipmapDrawList.instanceCount * clipmapInstanceStride);
+
+        D3D12_VERTEX_BUFFER_VIEW clipmapVBViews[2] = {terrainGridVB.vertexBufferView, clipmapInstanceVB.vertexBufferView};
+        clipmapVBViews[1].BufferLocation += instanceSliceOffset;
+        clipmapVBViews[1].SizeInBytes = clipmapInstanceSliceSize;
+        renderState.commandList->IASetVertexBuffers(0, _countof(clipmapVBViews), clipmapVBViews);
+        renderState.commandList->IASetIndexBuffer(&terrainGridIB.indexBufferView);
+
+        for (int p = 0; p < CLIPMAP_PIECE_COUNT; ++p)
+        {
+            if (clipmapDrawList.pieceInstanceCount[p] == 0)
+                continue;
+            renderState.commandList->DrawIndexedInstanced(clipmapTemplate.pieceIndexCount[p], clipmapDrawList.pieceInstanceCount[p],
+                                                          clipmapTemplate.pieceStartIndex[p], 0, clipmapDrawList.pieceFirstInstance[p]);
         }
 
         // bundle rendering
@@ -1356,6 +2172,7 @@ int main(void)
 
         // execute command list
         ID3D12CommandList *commandListsPerFrame[] = {renderState.commandList};
+        streamUploader.wait_live(renderState.commandQueue);
         renderState.commandQueue->ExecuteCommandLists(_countof(commandListsPerFrame), commandListsPerFrame);
 
         QueryPerformanceCounter(&profiling.t2);
@@ -1377,6 +2194,9 @@ int main(void)
             errhr("Signal failed", hr);
             return 1;
         }
+        // tile copies recorded while this frame was built go out behind it
+        if (!streamUploader.flush(renderState.fence, currentFenceValue))
+            return 1;
         frameIndex = renderState.swapChain->GetCurrentBackBufferIndex();
 
         if (renderState.fence->GetCompletedValue() < fenceValues[frameIndex])
@@ -1463,14 +2283,11 @@ int main(void)
     //     signature->Release();
     // filepath: c:\Work\Projects\terrain\main.cpp
 
-    // shutdown streaming workers
-    streamStop.store(true);
-    streamCv.notify_all();
-    for (auto &t : streamWorkers)
-    {
-        if (t.joinable())
-            t.join();
-    }
-    
+    // reads still in flight queue their decode jobs, then the workers finish every queued job
+    tileReader.close();
+    pageReader.close();
+    jobSystem.shutdown();
+    albedoPageTable.release();
+
     return (0);
 }
\ No newline at end of file
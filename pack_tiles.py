@@ -0,0 +1,644 @@
+import hashlib
+import os
+import re
+import struct
+import sys
+import time
+from array import array
+
+# Packs data/height and data/albedo into data/tiles.pak, the single archive the engine maps at startup.
+# Layout must match src/tile_archive.h: header, directory (the world manifest's tile records sorted by key,
+# then entries tile major, then layer), payloads. The world is whatever chunk_<layer>_<x>_<y>.dds files the
+# folders hold, x and y may be negative and the coverage may have holes. Byte identical tiles (open sea) are
+# stored once, their entries share the payload. With --constant, tiles whose top mip stays within a tolerance
+# of one value (sea level, salt flats) are stored as that value with no payload at all.
+# Run from the engine project, after get_assets.py:
+#   python pack_tiles.py             pack
+#   python pack_tiles.py --compress  pack with LZ4 compressed tiles (pip install lz4)
+#   python pack_tiles.py --height-codec [--height-max-error N]
+#                                    pack R16 heights with the delta codec (pip install numpy), lossless by
+#                                    default, N > 0 allows up to N units of error per sample
+#   python pack_tiles.py --constant [--constant-height-tolerance N] [--constant-albedo-tolerance N]
+#                                    store near constant tiles as a value, N in R16 units for heights and
+#                                    8 bit colour units for albedo, combines with the other pack options
+#   python pack_tiles.py --pages [--compress]
+#                                    cut the albedo tiles into virtual texture pages, data/albedo_pages.vt
+#                                    (pip install numpy), LZ4 compressed pages with --compress
+#   python pack_tiles.py --overview [--overview-dim N]
+#                                    cut an always resident low resolution copy of every height tile for the far
+#                                    clipmap rings, N texels per tile side (256 by default), data/height_overview.hov
+#   python pack_tiles.py --bench     compare loose file open+read against archive reads
+
+ALIGNMENT = 64 * 1024  # a multiple of every page size and the Windows allocation granularity
+CHUNK_SIZE = 256 * 1024  # uncompressed bytes per independently decoded chunk
+
+DATA_ROOT = os.path.join(os.getcwd(), "data")
+ARCHIVE_PATH = os.path.join(DATA_ROOT, "tiles.pak")
+LAYERS = [
+    (os.path.join(DATA_ROOT, "height"), "chunk_height_%d_%d.dds"),
+    (os.path.join(DATA_ROOT, "albedo"), "chunk_albedo_%d_%d.dds"),
+]
+
+MAGIC = 0x4B415054  # "TPAK"
+VERSION = 3
+MAX_MIPS = 16
+HEADER_FORMAT = "<8IQ"
+TILE_FORMAT = "<Q2HI"  # world_tile_info in src/world_manifest.h
+ENTRY_FORMAT = "<3Q6I%dQ" % MAX_MIPS
+COMPRESSION_NONE = 0
+COMPRESSION_LZ4_CHUNKS = 1
+COMPRESSION_HEIGHT_DELTA = 2
+COMPRESSION_CONSTANT = 3  # no payload, chunk_count holds the value
+FORMAT_R16_UNORM = 56
+FORMAT_R32_FLOAT = 41
+FORMAT_BC1 = (71, 72)
+FORMAT_RGBA8 = (28, 29)
+FORMAT_BGRA8 = (87, 91)
+CONSTANT_HEIGHT_TOLERANCE = 2  # R16 units either side of the value
+CONSTANT_ALBEDO_TOLERANCE = 3  # 8 bit units per channel
+HEIGHT_BLOCK_SAMPLES = 128
+HEIGHT_LANES = 8
+CHUNK_STORED_RAW = 0x80000000
+
+# virtual texture pages, must match src/virtual_texture.h
+PAGES_PATH = os.path.join(DATA_ROOT, "albedo_pages.vt")
+PAGE_MAGIC = 0x47505456  # "VTPG"
+PAGE_VERSION = 2
+PAGE_SIZE = 128
+PAGE_BORDER = 4
+PAGE_HEADER_FORMAT = "<10I2Q"
+PAGE_ENTRY_FORMAT = "<Q2I"
+PAGE_LZ4 = 1
+
+# height overview, must match src/height_overview.h
+OVERVIEW_PATH = os.path.join(DATA_ROOT, "height_overview.hov")
+OVERVIEW_MAGIC = 0x564F5648  # "HVOV"
+OVERVIEW_VERSION = 1
+OVERVIEW_HEADER_FORMAT = "<6IQ"
+OVERVIEW_DIM = 256
+
+# DXGI_FORMAT -> bytes per 4x4 block (BCn) or negative bits per pixel, the same table as src/dds_file.h
+FORMAT_LAYOUT = {
+    2: -128, 10: -64, 11: -64, 16: -64, 24: -32, 28: -32, 29: -32, 35: -32, 41: -32,
+    49: -16, 54: -16, 56: -16, 61: -8, 87: -32, 88: -32, 91: -32,
+    71: 8, 72: 8, 80: 8, 81: 8,
+    74: 16, 75: 16, 77: 16, 78: 16, 83: 16, 84: 16, 95: 16, 96: 16, 98: 16, 99: 16,
+}
+
+LEGACY_FOURCC = {
+    b"DXT1": 71, b"DXT2": 74, b"DXT3": 74, b"DXT4": 77, b"DXT5": 77,
+    b"ATI1": 80, b"BC4U": 80, b"BC4S": 81, b"ATI2": 83, b"BC5U": 83, b"BC5S": 84,
+    struct.pack("<I", 36): 11, struct.pack("<I", 111): 54, struct.pack("<I", 113): 10,
+    struct.pack("<I", 114): 41, struct.pack("<I", 115): 16, struct.pack("<I", 116): 2,
+}
+
+
+def legacy_format(pf):
+    """DDS_PIXELFORMAT -> DXGI_FORMAT, 0 when there is no exact match."""
+    _, flags, fourcc, bits, r, g, b, a = struct.unpack("<2I4s5I", pf)
+    if not flags & 0x1:
+        a = 0
+    if flags & 0x4:
+        return LEGACY_FOURCC.get(fourcc, 0)
+    if flags & 0x40 and bits == 32:
+        masks = (r, g, b, a)
+        return {
+            (0xFF, 0xFF00, 0xFF0000, 0xFF000000): 28,
+            (0xFF0000, 0xFF00, 0xFF, 0xFF000000): 87,
+            (0xFF0000, 0xFF00, 0xFF, 0): 88,
+            (0xFFFF, 0xFFFF0000, 0, 0): 35,
+        }.get(masks, 41 if r == 0xFFFFFFFF else 0)
+    if flags & 0x20000:
+        if bits == 16 and r == 0xFFFF:
+            return 56
+        if bits == 8 and r == 0xFF:
+            return 61
+        if bits == 16 and r == 0xFF and a == 0xFF00:
+            return 49
+    return 0
+
+
+def mip_sizes(fmt, width, height, mips):
+    layout = FORMAT_LAYOUT[fmt]
+    sizes = []
+    for _ in range(mips):
+        if layout > 0:
+            sizes.append(max((width + 3) // 4, 1) * layout * max((height + 3) // 4, 1))
+        else:
+            sizes.append((width * -layout + 7) // 8 * height)
+        width = max(width // 2, 1)
+        height = max(height // 2, 1)
+    return sizes
+
+
+def read_dds(path):
+    """Returns (format, width, height, mip sizes, pixel data offset) for a single 2D DDS texture."""
+    with open(path, "rb") as f:
+        head = f.read(4 + 124 + 20)
+    if len(head) < 128 or head[:4] != b"DDS ":
+        raise ValueError("%s is not a DDS file" % path)
+    height, width = struct.unpack_from("<2I", head, 12)
+    mips = max(struct.unpack_from("<I", head, 28)[0], 1)
+    pf = head[76:108]
+    offset = 128
+    if struct.unpack_from("<I", pf, 4)[0] & 0x4 and pf[8:12] == b"DX10":
+        fmt, dimension, misc, array_size = struct.unpack_from("<4I", head, 128)
+        if dimension != 3 or misc & 0x4 or array_size != 1:
+            raise ValueError("%s is not a single 2D texture" % path)
+        offset += 20
+    else:
+        fmt = legacy_format(pf)
+    if fmt not in FORMAT_LAYOUT or mips > MAX_MIPS:
+        raise ValueError("%s has unsupported format %d or %d mips" % (path, fmt, mips))
+    sizes = mip_sizes(fmt, width, height, mips)
+    if offset + sum(sizes) > os.path.getsize(path):
+        raise ValueError("%s is truncated" % path)
+    return fmt, width, height, sizes, offset
+
+
+def tile_key(x, y):
+    """world_tile_key in src/world_manifest.h, y in the high half so sorted keys are row major."""
+    return ((y & 0xFFFFFFFF) << 32) | (x & 0xFFFFFFFF)
+
+
+def scan_tiles():
+    """The world manifest: every (x, y) with at least one layer, sorted by key, and {(x, y): path} per layer."""
+    layer_paths = []
+    for folder, pattern in LAYERS:
+        name_format = re.compile("^" + re.escape(pattern).replace("%d", "(-?[0-9]+)") + "$")
+        paths = {}
+        if os.path.isdir(folder):
+            for name in os.listdir(folder):
+                match = name_format.match(name)
+                if match:
+                    paths[(int(match.group(1)), int(match.group(2)))] = os.path.join(folder, name)
+        layer_paths.append(paths)
+    tiles = sorted(set().union(*layer_paths), key=lambda tile: tile_key(*tile))
+    return tiles, layer_paths
+
+
+def manifest_hash(tiles):
+    """world_manifest::keysHash, FNV-1a over the sorted keys' little endian bytes."""
+    value = 0xCBF29CE484222325
+    for x, y in tiles:
+        for byte in struct.pack("<Q", tile_key(x, y)):
+            value = ((value ^ byte) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return value
+
+
+def height_bounds(fmt, pixels, width, height):
+    """Lowest and highest sample of a height tile's top mip in R16_UNORM units, the full range for formats
+    other than R16 and R32 float."""
+    if fmt == FORMAT_R16_UNORM:
+        samples = array("H")
+        samples.frombytes(pixels[:width * height * 2])
+        return min(samples), max(samples)
+    if fmt == FORMAT_R32_FLOAT:
+        samples = array("f")
+        samples.frombytes(pixels[:width * height * 4])
+        low = min(max(min(samples), 0.0), 1.0)
+        high = min(max(max(samples), 0.0), 1.0)
+        return int(low * 65535.0), min(int(high * 65535.0 + 0.999), 65535)
+    return 0, 65535
+
+
+def constant_height(bounds, tolerance):
+    """R16_UNORM value a height tile can be stored as, None when its samples spread further than the tolerance."""
+    low, high = bounds
+    if high - low > 2 * tolerance:
+        return None
+    return (low + high) // 2
+
+
+def constant_albedo(fmt, pixels, width, height, tolerance):
+    """RGBA8 value (red in the low byte) an albedo tile's top mip can be stored as, None when it isn't uniform.
+    BC1 goes by its block endpoints, which bound every colour a block decodes to."""
+    if fmt in FORMAT_BC1:
+        words = array("I")
+        words.frombytes(pixels[:max((width + 3) // 4, 1) * max((height + 3) // 4, 1) * 8])
+        endpoints = set()
+        for colours, indices in zip(words[0::2], words[1::2]):
+            c0, c1 = colours & 0xFFFF, colours >> 16
+            if c0 <= c1 and indices & (indices >> 1) & 0x55555555:
+                return None  # three colour block that decodes transparent black somewhere
+            endpoints.add(c0)
+            endpoints.add(c1)
+        channels = [[((c >> 11) & 31) * 255 // 31 for c in endpoints], [((c >> 5) & 63) * 255 // 63 for c in endpoints],
+                    [(c & 31) * 255 // 31 for c in endpoints]]
+        alpha = 255
+    elif fmt in FORMAT_RGBA8 or fmt in FORMAT_BGRA8:
+        texels = pixels[:width * height * 4]
+        channels = [texels[0::4], texels[1::4], texels[2::4]]
+        if fmt in FORMAT_BGRA8:
+            channels.reverse()
+        alpha = (min(texels[3::4]) + max(texels[3::4])) // 2 if fmt in FORMAT_RGBA8 else 255
+    else:
+        return None
+    value = alpha << 24
+    for shift, channel in zip((0, 8, 16), channels):
+        low, high = min(channel), max(channel)
+        if high - low > 2 * tolerance:
+            return None
+        value |= ((low + high) // 2) << shift
+    return value
+
+
+def align(value):
+    return (value + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+
+def compress_chunks(pixels):
+    """Chunk size table followed by each chunk's LZ4 block, chunks that don't shrink are stored raw."""
+    import lz4.block
+
+    sizes = []
+    chunks = []
+    for start in range(0, len(pixels), CHUNK_SIZE):
+        raw = pixels[start:start + CHUNK_SIZE]
+        packed = lz4.block.compress(raw, mode="high_compression", compression=9, store_size=False)
+        if len(packed) < len(raw):
+            sizes.append(len(packed))
+            chunks.append(packed)
+        else:
+            sizes.append(len(raw) | CHUNK_STORED_RAW)
+            chunks.append(raw)
+    return struct.pack("<%dI" % len(sizes), *sizes) + b"".join(chunks), len(sizes)
+
+
+def encode_height_band(band, quant_step):
+    """One band of rows in the layout src/height_codec.h decodes: quant step, a bit width per 128 sample
+    block, then each block's residuals packed vertically across 8 lanes of 16-bit words."""
+    import numpy as np
+
+    q = band.astype(np.int64)
+    if quant_step > 1:
+        q = (q + quant_step // 2) // quant_step
+    # gradient predictor a + b - c, neighbours outside the band are 0, residuals wrap at 16 bits
+    padded = np.zeros((q.shape[0] + 1, q.shape[1] + 1), dtype=np.int64)
+    padded[1:, 1:] = q
+    residual = (q - (padded[1:, :-1] + padded[:-1, 1:] - padded[:-1, :-1])) & 0xFFFF
+    signed = np.where(residual >= 0x8000, residual - 0x10000, residual)
+    zigzag = np.where(signed < 0, -2 * signed - 1, 2 * signed).ravel().astype(np.uint32)
+
+    blocks = -(-zigzag.size // HEIGHT_BLOCK_SAMPLES)
+    padded_samples = np.zeros(blocks * HEIGHT_BLOCK_SAMPLES, dtype=np.uint32)
+    padded_samples[:zigzag.size] = zigzag
+    values = padded_samples.reshape(blocks, HEIGHT_BLOCK_SAMPLES // HEIGHT_LANES, HEIGHT_LANES)
+    widths = [int(v.max()).bit_length() for v in values]
+
+    words = []
+    for block, width in zip(values, widths):
+        packed = np.zeros((width, HEIGHT_LANES), dtype=np.uint32)
+        for t in range(HEIGHT_BLOCK_SAMPLES // HEIGHT_LANES):
+            bit = t * width
+            k, shift = bit >> 4, bit & 15
+            packed[k] |= (block[t] << shift) & 0xFFFF
+            if shift + width > 16:
+                packed[k + 1] |= block[t] >> (16 - shift)
+        words.append(packed.astype("<u2").tobytes())
+    return struct.pack("<H", quant_step) + bytes(widths) + b"".join(words)
+
+
+def encode_height_chunks(pixels, width, height, mips, max_error):
+    """Chunk size table followed by each band of rows, one band per CHUNK_SIZE decoded bytes of a mip.
+    Quantising by 2 * max_error + 1 bounds the error by max_error."""
+    import numpy as np
+
+    quant_step = 2 * max_error + 1
+    sizes = []
+    chunks = []
+    offset = 0
+    for _ in range(mips):
+        mip = np.frombuffer(pixels, dtype="<u2", count=width * height, offset=offset).reshape(height, width)
+        band_rows = max(CHUNK_SIZE // (width * 2), 1)
+        for row in range(0, height, band_rows):
+            band = mip[row:row + band_rows]
+            packed = encode_height_band(band, quant_step)
+            if max_error == 0 and len(packed) >= band.nbytes:
+                sizes.append(band.nbytes | CHUNK_STORED_RAW)
+                chunks.append(band.tobytes())
+            else:
+                sizes.append(len(packed))
+                chunks.append(packed)
+        offset += width * height * 2
+        width = max(width // 2, 1)
+        height = max(height // 2, 1)
+    return struct.pack("<%dI" % len(sizes), *sizes) + b"".join(chunks), len(sizes)
+
+
+def pack(compress, height_codec, height_max_error, constant_tolerances=None):
+    tiles, layer_paths = scan_tiles()
+    if not tiles:
+        raise ValueError("no tiles in %s" % DATA_ROOT)
+    entry_count = len(LAYERS) * len(tiles)
+    header_size = struct.calcsize(HEADER_FORMAT)
+    infos = []
+    entries = []
+    raw_total = 0
+    stored_total = 0
+    height_samples = 0
+    height_bits = 0
+    payloads = {}  # content hash -> entry fields of the payload already written
+    saved = [[0, 0, 0] for _ in LAYERS]  # per layer: duplicates, raw bytes, stored bytes
+    constants = [[0, 0] for _ in LAYERS]  # per layer: constant tiles, raw bytes
+    cursor = align(header_size + len(tiles) * struct.calcsize(TILE_FORMAT) + entry_count * struct.calcsize(ENTRY_FORMAT))
+
+    with open(ARCHIVE_PATH + ".tmp", "wb") as out:
+        out.seek(cursor)
+        for x, y in tiles:
+            min_height, max_height, layer_mask = 0, 0, 0
+            for layer, (folder, pattern) in enumerate(LAYERS):
+                path = layer_paths[layer].get((x, y))
+                if path is None:
+                    print(f"Missing {os.path.join(folder, pattern % (x, y))}")
+                    entries.append(struct.pack(ENTRY_FORMAT, 0, 0, 0, 0, 0, 0, 0, 0, 0, *([0] * MAX_MIPS)))
+                    continue
+                fmt, width, height, sizes, offset = read_dds(path)
+                mip_offsets = [sum(sizes[:i]) for i in range(len(sizes))] + [0] * (MAX_MIPS - len(sizes))
+                with open(path, "rb") as src:
+                    src.seek(offset)
+                    pixels = src.read(sum(sizes))
+                layer_mask |= 1 << layer
+                if layer == 0:
+                    min_height, max_height = height_bounds(fmt, pixels, width, height)
+
+                if constant_tolerances:
+                    if layer == 0:
+                        value = constant_height((min_height, max_height), constant_tolerances[0])
+                    else:
+                        value = constant_albedo(fmt, pixels, width, height, constant_tolerances[1])
+                    if value is not None:
+                        entries.append(struct.pack(ENTRY_FORMAT, 0, len(pixels), 0, fmt, width, height, len(sizes),
+                                                   COMPRESSION_CONSTANT, value, *([0] * MAX_MIPS)))
+                        constants[layer][0] += 1
+                        constants[layer][1] += len(pixels)
+                        print(f"Constant {os.path.basename(path)} ({value:#x})")
+                        continue
+
+                content = hashlib.sha256(struct.pack("<4I", fmt, width, height, len(sizes)) + pixels).digest()
+                if content in payloads:
+                    fields = payloads[content]
+                    entries.append(struct.pack(ENTRY_FORMAT, *fields))
+                    saved[layer][0] += 1
+                    saved[layer][1] += fields[1]
+                    saved[layer][2] += fields[2]
+                    print(f"Shared {os.path.basename(path)}")
+                    continue
+
+                compression, chunk_count, payload = COMPRESSION_NONE, 0, pixels
+                if height_codec and fmt == FORMAT_R16_UNORM:
+                    payload, chunk_count = encode_height_chunks(pixels, width, height, len(sizes), height_max_error)
+                    compression = COMPRESSION_HEIGHT_DELTA
+                    height_samples += len(pixels) // 2
+                    height_bits += len(payload) * 8
+                elif compress:
+                    payload, chunk_count = compress_chunks(pixels)
+                    compression = COMPRESSION_LZ4_CHUNKS
+                fields = (cursor, len(pixels), len(payload), fmt, width, height, len(sizes), compression, chunk_count, *mip_offsets)
+                payloads[content] = fields
+                entries.append(struct.pack(ENTRY_FORMAT, *fields))
+                raw_total += len(pixels)
+                stored_total += len(payload)
+
+                out.seek(cursor)
+                out.write(payload)
+                cursor = align(cursor + len(payload))
+                print(f"Packed {os.path.basename(path)} ({len(pixels) / max(len(payload), 1):.2f}:1)")
+            infos.append(struct.pack(TILE_FORMAT, tile_key(x, y), min_height, max_height, layer_mask))
+
+        out.truncate(cursor)
+        out.seek(0)
+        out.write(struct.pack(HEADER_FORMAT, MAGIC, VERSION, len(tiles), len(LAYERS), ALIGNMENT, CHUNK_SIZE, 0, 0, header_size))
+        out.write(b"".join(infos))
+        out.write(b"".join(entries))
+    os.replace(ARCHIVE_PATH + ".tmp", ARCHIVE_PATH)
+    xs = [x for x, _ in tiles]
+    ys = [y for _, y in tiles]
+    print(f"\nWrote {ARCHIVE_PATH} ({cursor / (1024 * 1024):.1f} MiB, {len(tiles)} tiles in "
+          f"[{min(xs)}, {max(xs)}] x [{min(ys)}, {max(ys)}])")
+    if (compress or height_codec) and stored_total:
+        print(f"Compression ratio {raw_total / stored_total:.2f}:1, decode throughput is shown in the engine's stats panel")
+    if height_samples:
+        print(f"Heights: {height_bits / height_samples:.2f} bits per sample, max error {height_max_error}")
+    for layer, (folder, _) in enumerate(LAYERS):
+        duplicates, raw, stored = saved[layer]
+        print(f"Dedup {os.path.basename(folder)}: {duplicates} duplicate tiles, {raw / (1024 * 1024):.1f} MiB of GPU memory "
+              f"and {stored / (1024 * 1024):.1f} MiB of archive saved")
+        if constant_tolerances:
+            count, raw = constants[layer]
+            print(f"Constant {os.path.basename(folder)}: {count} tiles stored as a value, {raw / (1024 * 1024):.1f} MiB not read")
+
+
+def load_elements(path, mip):
+    """One mip of a DDS tile as a (rows, columns, bytes) array of texels, or of 4x4 blocks for BCn."""
+    import numpy as np
+
+    fmt, width, height, sizes, offset = read_dds(path)
+    layout = FORMAT_LAYOUT[fmt]
+    block, element_bytes = (4, layout) if layout > 0 else (1, -layout // 8)
+    columns = max(-(-max(width >> mip, 1) // block), 1)
+    rows = max(-(-max(height >> mip, 1) // block), 1)
+    return np.memmap(path, dtype=np.uint8, mode="r", offset=offset + sum(sizes[:mip]), shape=(rows, columns, element_bytes))
+
+
+def pack_pages(compress):
+    """Cuts every albedo tile mip, down to the one that fits a single page, into PAGE_SIZE pages with
+    PAGE_BORDER texels of their neighbours around them. Borders on tile edges come from the adjacent
+    tiles, or repeat the edge where there is none. Tiles follow the archive's manifest order, so pack the
+    archive from the same folders."""
+    import numpy as np
+
+    tiles, layer_paths = scan_tiles()
+    folder = LAYERS[1][0]
+    paths = layer_paths[1]
+    if not paths:
+        raise ValueError("no albedo tiles in %s" % folder)
+
+    fmt, tile_dim, tile_height, sizes, _ = read_dds(next(iter(paths.values())))
+    mip_count = 1
+    while tile_dim >> (mip_count - 1) > PAGE_SIZE:
+        mip_count += 1
+    if tile_dim != tile_height or tile_dim % PAGE_SIZE or tile_dim >> (mip_count - 1) != PAGE_SIZE:
+        raise ValueError("albedo tiles must be square multiples of %d texels" % PAGE_SIZE)
+    for path in paths.values():
+        other = read_dds(path)
+        if other[:3] != (fmt, tile_dim, tile_height) or len(other[3]) < mip_count:
+            raise ValueError("%s doesn't match the other albedo tiles" % path)
+
+    layout = FORMAT_LAYOUT[fmt]
+    block = 4 if layout > 0 else 1
+    page_elements = PAGE_SIZE // block
+    border = PAGE_BORDER // block
+    pages_per_tile = sum(((tile_dim // PAGE_SIZE) >> mip) ** 2 for mip in range(mip_count))
+    header_size = struct.calcsize(PAGE_HEADER_FORMAT)
+    entry_size = struct.calcsize(PAGE_ENTRY_FORMAT)
+    directory_size = len(tiles) * pages_per_tile * entry_size
+    cursor = header_size + directory_size
+    entries = []
+    raw_total = 0
+    page_bytes = 0
+
+    with open(PAGES_PATH + ".tmp", "wb") as out:
+        out.seek(cursor)
+        for x, y in tiles:
+            if (x, y) not in paths:
+                entries.append(struct.pack(PAGE_ENTRY_FORMAT, 0, 0, 0) * pages_per_tile)
+                continue
+            for mip in range(mip_count):
+                # padded tile in world coordinates. Where a neighbour is missing the edge is clamped into this
+                # tile's rows or columns, through the tile beside it along the other axis when that one exists
+                centre = load_elements(paths[(x, y)], mip)
+                dim = centre.shape[0]
+                span = np.arange(-border, dim + border)
+                rows = y * dim + span
+                cols = x * dim + span
+                padded = np.empty((dim + 2 * border, dim + 2 * border, centre.shape[2]), dtype=np.uint8)
+                for ty in np.unique(rows // dim):
+                    for tx in np.unique(cols // dim):
+                        row_mask = rows // dim == ty
+                        col_mask = cols // dim == tx
+                        sx, sy = tx, ty
+                        local_rows, local_cols = rows[row_mask] % dim, cols[col_mask] % dim
+                        if (sx, sy) not in paths:
+                            if (tx, y) in paths:
+                                sy = y
+                                local_rows = np.clip(rows[row_mask] - y * dim, 0, dim - 1)
+                            elif (x, ty) in paths:
+                                sx = x
+                                local_cols = np.clip(cols[col_mask] - x * dim, 0, dim - 1)
+                            else:
+                                sx, sy = x, y
+                                local_rows = np.clip(rows[row_mask] - y * dim, 0, dim - 1)
+                                local_cols = np.clip(cols[col_mask] - x * dim, 0, dim - 1)
+                        source = centre if (sx, sy) == (x, y) else load_elements(paths[(sx, sy)], mip)
+                        padded[np.ix_(row_mask, col_mask)] = source[np.ix_(local_rows, local_cols)]
+
+                side = dim // page_elements
+                for py in range(side):
+                    for px in range(side):
+                        page = padded[py * page_elements:(py + 1) * page_elements + 2 * border,
+                                      px * page_elements:(px + 1) * page_elements + 2 * border].tobytes()
+                        page_bytes = len(page)
+                        stored, flags = page, 0
+                        if compress:
+                            import lz4.block
+
+                            packed = lz4.block.compress(page, mode="high_compression", compression=9, store_size=False)
+                            if len(packed) < len(page):
+                                stored, flags = packed, PAGE_LZ4
+                        entries.append(struct.pack(PAGE_ENTRY_FORMAT, cursor, len(stored), flags))
+                        out.write(stored)
+                        cursor += len(stored)
+                        raw_total += len(page)
+            print(f"Paged {os.path.basename(paths[(x, y)])}")
+
+        out.truncate(cursor)
+        out.seek(0)
+        out.write(struct.pack(PAGE_HEADER_FORMAT, PAGE_MAGIC, PAGE_VERSION, len(tiles), tile_dim, PAGE_SIZE, PAGE_BORDER,
+                              mip_count, fmt, page_bytes, pages_per_tile, manifest_hash(tiles), header_size))
+        out.write(b"".join(entries))
+    os.replace(PAGES_PATH + ".tmp", PAGES_PATH)
+    print(f"\nWrote {PAGES_PATH} ({cursor / (1024 * 1024):.1f} MiB, {pages_per_tile} pages of {page_bytes} bytes per tile)")
+    if compress and raw_total:
+        print(f"Compression ratio {raw_total / (cursor - header_size - directory_size):.2f}:1")
+
+
+def pack_overview(overview_dim):
+    """Point samples every height tile's top mip down to overview_dim texels per side, then halves that down to
+    1x1 the same way, texel (x, y) of each level taking the source texel at (2x, 2y). That is how the engine's
+    height pyramid decimates tiles, so the far rings see the same heights either way. Tiles follow the archive's
+    manifest order, tiles without a height layer are sea level."""
+    import numpy as np
+
+    tiles, layer_paths = scan_tiles()
+    paths = layer_paths[0]
+    if not paths:
+        raise ValueError("no height tiles in %s" % LAYERS[0][0])
+    if overview_dim <= 0 or overview_dim & (overview_dim - 1):
+        raise ValueError("the overview size must be a power of two")
+    _, source_dim, source_height, _, _ = read_dds(next(iter(paths.values())))
+    if source_dim != source_height or source_dim % overview_dim:
+        raise ValueError("height tiles must be square multiples of %d texels" % overview_dim)
+    mip_count = overview_dim.bit_length()
+    stride = source_dim // overview_dim
+
+    with open(OVERVIEW_PATH + ".tmp", "wb") as out:
+        out.write(struct.pack(OVERVIEW_HEADER_FORMAT, OVERVIEW_MAGIC, OVERVIEW_VERSION, len(tiles), overview_dim, mip_count,
+                              source_dim, manifest_hash(tiles)))
+        for x, y in tiles:
+            if (x, y) not in paths:
+                out.write(bytes(sum((overview_dim >> mip) ** 2 for mip in range(mip_count)) * 2))
+                continue
+            fmt, width, height, _, _ = read_dds(paths[(x, y)])
+            if (width, height) != (source_dim, source_dim) or fmt not in (FORMAT_R16_UNORM, FORMAT_R32_FLOAT):
+                raise ValueError("%s doesn't match the other height tiles" % paths[(x, y)])
+            texels = load_elements(paths[(x, y)], 0)
+            if fmt == FORMAT_R16_UNORM:
+                level = texels.view(np.uint16)[::stride, ::stride, 0]
+            else:
+                level = np.clip(texels.view(np.float32)[::stride, ::stride, 0], 0.0, 1.0)
+                level = (level * 65535.0 + 0.5).astype(np.uint16)
+            for mip in range(mip_count):
+                out.write(np.ascontiguousarray(level[::1 << mip, ::1 << mip]).tobytes())
+            print(f"Overview {os.path.basename(paths[(x, y)])}")
+        size = out.tell()
+    os.replace(OVERVIEW_PATH + ".tmp", OVERVIEW_PATH)
+    print(f"\nWrote {OVERVIEW_PATH} ({size / (1024 * 1024):.1f} MiB, {overview_dim}^2 texels and {mip_count} mips per tile, "
+          f"resident in memory at runtime)")
+
+
+def bench():
+    """Per tile latency of opening and reading each loose file against one positioned read from the open archive.
+    Run it twice, the first pass mostly measures a cold disk cache."""
+    manifest, layer_paths = scan_tiles()
+    tiles = [(layer, x, y) for x, y in manifest for layer in range(len(LAYERS))]
+
+    start = time.perf_counter()
+    loose_bytes = 0
+    for layer, x, y in tiles:
+        path = layer_paths[layer].get((x, y))
+        if path:
+            with open(path, "rb") as f:
+                loose_bytes += len(f.read())
+    loose = time.perf_counter() - start
+
+    start = time.perf_counter()
+    packed_bytes = 0
+    entry_size = struct.calcsize(ENTRY_FORMAT)
+    with open(ARCHIVE_PATH, "rb") as f:
+        header = struct.unpack(HEADER_FORMAT, f.read(struct.calcsize(HEADER_FORMAT)))
+        f.seek(header[8] + header[2] * struct.calcsize(TILE_FORMAT))
+        directory = f.read(len(tiles) * entry_size)
+        for i in range(len(tiles)):
+            offset, _, stored_size = struct.unpack_from("<3Q", directory, i * entry_size)
+            if offset:
+                f.seek(offset)
+                packed_bytes += len(f.read(stored_size))
+    packed = time.perf_counter() - start
+
+    count = len(tiles)
+    print(f"loose:   {loose * 1000 / count:.3f} ms per tile, {loose_bytes / (1024 * 1024) / loose:.0f} MiB/s")
+    print(f"archive: {packed * 1000 / count:.3f} ms per tile, {packed_bytes / (1024 * 1024) / packed:.0f} MiB/s")
+
+
+if __name__ == "__main__":
+    if "--bench" in sys.argv:
+        bench()
+    elif "--pages" in sys.argv:
+        pack_pages("--compress" in sys.argv)
+    elif "--overview" in sys.argv:
+        dim = OVERVIEW_DIM
+        if "--overview-dim" in sys.argv:
+            dim = int(sys.argv[sys.argv.index("--overview-dim") + 1])
+        pack_overview(dim)
+    else:
+        max_error = 0
+        if "--height-max-error" in sys.argv:
+            max_error = int(sys.argv[sys.argv.index("--height-max-error") + 1])
+        constant_tolerances = None
+        if "--constant" in sys.argv:
+            constant_tolerances = [CONSTANT_HEIGHT_TOLERANCE, CONSTANT_ALBEDO_TOLERANCE]
+            for i, option in enumerate(("--constant-height-tolerance", "--constant-albedo-tolerance")):
+                if option in sys.argv:
+                    constant_tolerances[i] = int(sys.argv[sys.argv.index(option) + 1])
+        pack("--compress" in sys.argv, "--height-codec" in sys.argv, max_error, constant_tolerances)
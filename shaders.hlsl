@@ -8,16 +8,26 @@ struct VSOut
     float3 normalWS : TEXCOORD2;
     float2 water : TEXCOORD3;
     uint texIndex : TEXCOORD4;
+    float2 uvWindow : TEXCOORD5; // 0..1 over the streamed window
 };
 
 cbuffer TerrainStreamingCB : register(b1)
 {
-    uint4 heightSRV[16];
-    uint4 albedoSRV[16];
+    uint4 heightSRV[16]; // slot, 1 for a tile the world doesn't have or 2 for a constant one, its R16 height
+    uint4 albedoSRV[16]; // slot, first resident mip, 1 for a constant colour (2 sRGB), its RGBA8
+    uint4 virtualTexture; // page cache SRV, page table SRV, table pages per side, page mips; 0 when off
 };
 
 Texture2D<float> g_heightTex[] : register(t0, space1);
 Texture2D<float4> g_albedoTex[] : register(t1, space1);
+Texture2DArray<float> g_heightLevels[] : register(t2, space1);
+Texture2DArray<float4> g_vtPages[] : register(t3, space1);
+Texture2DArray<uint> g_vtPageTable[] : register(t4, space1);
+
+// VirtualTextureConstants in src/virtual_texture.h
+static const float vtPageSize = 128.0f;
+static const float vtPageBorder = 4.0f;
+static const float vtPhysicalPageDim = vtPageSize + 2.0f * vtPageBorder;
 
 SamplerState g_sampler : register(s0);
 
@@ -28,14 +38,17 @@ float hash21(float2 p)
     return frac(p.x * p.y);
 }
 
-VSOut VSMain(uint2 position: POSITION)
+VSOut VSMain(uint2 position: POSITION, uint4 instance: CLIPMAPINSTANCE)
 {
     int lodLevel = 0;
     VSOut o;
-    float4 wp = float4(position.x, 0.0f, position.y, 1.0f);
+    // instance.xy = piece origin in ring quads, instance.z = ring index
+    float4 ring = clipmapRings[instance.z];
+    float2 ringOffset = ring.xy; // world position of the ring's first vertex
+    float ringSampleStep = ring.z;
 
-    float gridDimSize = terrainGridDimensionInVertices - 1;
-    wp.xz -= (gridDimSize + 2) / 2.0f;
+    // clipmap piece vertex -> ring grid -> world
+    float4 wp = float4(position.x + instance.x, 0.0f, position.y + instance.y, 1.0f);
     wp.xz *= ringSampleStep;
 
     wp = mul(world, wp);
@@ -72,10 +85,56 @@ VSOut VSMain(uint2 position: POSITION)
     // Convert UV to integer texel coordinates
     int2 pixel = int2(uvLocal * tileDim);
 
-    // Center height
-    float heightPointData = g_heightTex[heightIndex].Load(int3(pixel.x, pixel.y, 0)).r;
-
     float artistScale = (5000.0f * 0.03f) * debug_scaler;
+    float heightPointData;
+    float hL, hR, hD, hU;
+    if (instance.z >= heightPyramidFirstRing)
+    {
+        // coarse rings read their own level of the height pyramid, one texel per ring vertex
+        uint level = instance.z;
+        int2 levelOrigin = int2(round((ringOffset + (float2)terrainWindowOrigin) / ringSampleStep));
+        int2 local = int2(instance.xy + position);
+        int2 gridTexel = levelOrigin + local;
+        // neighbours stay on the ring's grid, the level only holds gridDimVerts texels around it
+        int2 localL = int2(max(local.x - 1, 0), local.y);
+        int2 localR = int2(min(local.x + 1, terrainGridDimensionInVertices - 1), local.y);
+        int2 localD = int2(local.x, max(local.y - 1, 0));
+        int2 localU = int2(local.x, min(local.y + 1, terrainGridDimensionInVertices - 1));
+
+        Texture2DArray<float> levels = g_heightLevels[heightPyramidSRV - 2];
+        heightPointData = levels.Load(int4(gridTexel & 255, level, 0)).r;
+        hL = levels.Load(int4((levelOrigin + localL) & 255, level, 0)).r * artistScale;
+        hR = levels.Load(int4((levelOrigin + localR) & 255, level, 0)).r * artistScale;
+        hD = levels.Load(int4((levelOrigin + localD) & 255, level, 0)).r * artistScale;
+        hU = levels.Load(int4((levelOrigin + localU) & 255, level, 0)).r * artistScale;
+    }
+    else if (heightSRV[texIndex].g == 1)
+    {
+        // a hole in the world, flat at sea level
+        heightPointData = 0.0f;
+        hL = hR = hD = hU = 0.0f;
+    }
+    else if (heightSRV[texIndex].g == 2)
+    {
+        // stored as one height, nothing to sample
+        heightPointData = (float)heightSRV[texIndex].b / 65535.0f;
+        hL = hR = hD = hU = heightPointData * artistScale;
+    }
+    else
+    {
+        // Center height
+        heightPointData = g_heightTex[heightIndex].Load(int3(pixel.x, pixel.y, 0)).r;
+
+        int2 leftPixel = pixel + int2(-1, 0);
+        int2 rightPixel = pixel + int2(1, 0);
+        int2 downPixel = pixel + int2(0, -1);
+        int2 upPixel = pixel + int2(0, 1);
+        hL = g_heightTex[heightIndex].Load(int3(leftPixel, 0)).r * artistScale;
+        hR = g_heightTex[heightIndex].Load(int3(rightPixel, 0)).r * artistScale;
+        hD = g_heightTex[heightIndex].Load(int3(downPixel, 0)).r * artistScale;
+        hU = g_heightTex[heightIndex].Load(int3(upPixel, 0)).r * artistScale;
+    }
+
     wp.y = heightPointData * artistScale;
 
     float3 worldPos = wp.xyz;
@@ -84,15 +143,6 @@ VSOut VSMain(uint2 position: POSITION)
 
     float texelWorld = ringSampleStep;
 
-    int2 leftPixel = pixel + int2(-1, 0);
-    int2 rightPixel = pixel + int2(1, 0);
-    int2 downPixel = pixel + int2(0, -1);
-    int2 upPixel = pixel + int2(0, 1);
-    float hL = g_heightTex[heightIndex].Load(int3(leftPixel, 0)).r * artistScale;
-    float hR = g_heightTex[heightIndex].Load(int3(rightPixel, 0)).r * artistScale;
-    float hD = g_heightTex[heightIndex].Load(int3(downPixel, 0)).r * artistScale;
-    float hU = g_heightTex[heightIndex].Load(int3(upPixel, 0)).r * artistScale;
-
     // Reconstruct normal
     float worldDelta = texelWorld * 2.0f; // World‑space delta for normal reconstruction
     float3 dx = float3(worldDelta, hR - hL, 0.0f);
@@ -123,6 +173,7 @@ VSOut VSMain(uint2 position: POSITION)
     o.worldPos = worldPos;
     o.uvLocal = uvLocal;
     o.texIndex = texIndex;
+    o.uvWindow = uvGlobal;
 
     return o;
 }
@@ -155,10 +206,61 @@ float4 PSMain(VSOut IN) : SV_Target
 
     
     
-    uint albedoIndex = albedoSRV[IN.texIndex].r;
+    float4 sampleData;
+    if (virtualTexture.x != 0)
+    {
+        // paged albedo: the page table mip for this pixel's lod points at the finest resident page covering it
+        Texture2DArray<float4> pages = g_vtPages[virtualTexture.x - 3];
+        Texture2DArray<uint> pageTable = g_vtPageTable[virtualTexture.y - 4];
+        float tableDim = (float)virtualTexture.z;
+        float2 texel = IN.uvWindow * tableDim * vtPageSize;
+        float2 texelDx = ddx(texel);
+        float2 texelDy = ddy(texel);
+        float lod = 0.5f * log2(max(max(dot(texelDx, texelDx), dot(texelDy, texelDy)), 1.0e-8f));
+        uint mip = (uint)clamp(floor(lod), 0.0f, (float)virtualTexture.w - 1.0f);
+        int2 page = clamp((int2)floor(IN.uvWindow * tableDim), 0, (int)virtualTexture.z - 1);
+        uint entry = pageTable.Load(int4(page >> mip, 0, mip));
+        if (entry == 0xFFFFFFFF)
+        {
+            sampleData = float4(0.5f, 0.5f, 0.5f, 1.0f);
+        }
+        else
+        {
+            uint pageMip = entry >> 16;
+            float2 inPage = frac(IN.uvWindow * max(tableDim / exp2((float)pageMip), 1.0f));
+            float2 physUv = (vtPageBorder + inPage * vtPageSize) / vtPhysicalPageDim;
+            sampleData = pages.SampleLevel(g_sampler, float3(physUv, (float)(entry & 0xFFFF)), 0.0f);
+        }
+    }
+    else if (heightSRV[IN.texIndex].g == 1)
+    {
+        sampleData = float4(0.5f, 0.5f, 0.5f, 1.0f);
+    }
+    else if (albedoSRV[IN.texIndex].b != 0)
+    {
+        uint colour = albedoSRV[IN.texIndex].a;
+        sampleData = float4(colour & 0xFF, (colour >> 8) & 0xFF, (colour >> 16) & 0xFF, colour >> 24) / 255.0f;
+        if (albedoSRV[IN.texIndex].b == 2)
+            sampleData.rgb = pow(sampleData.rgb, 2.2f); // what an sRGB view would have decoded
+    }
+    else
+    {
+        uint albedoIndex = albedoSRV[IN.texIndex].r;
+        // a tile streamed tail first only has mips from .g down, widen the gradients so sampling stays on them
+        float albedoMinMip = (float)albedoSRV[IN.texIndex].g;
+        float2 uvDx = ddx(IN.uvLocal);
+        float2 uvDy = ddy(IN.uvLocal);
+        if (albedoMinMip > 0.0f)
+        {
+            float lod = g_albedoTex[albedoIndex].CalculateLevelOfDetailUnclamped(g_sampler, IN.uvLocal);
+            float scale = exp2(max(albedoMinMip - lod, 0.0f));
+            uvDx *= scale;
+            uvDy *= scale;
+        }
     
-    // float4 sampleData = g_albedoTex[albedoIndex].Sample(g_sampler, IN.uvLocal);
-    float4 sampleData = g_albedoTex[albedoIndex].Sample(g_sampler, IN.uvLocal);
+        // float4 sampleData = g_albedoTex[albedoIndex].Sample(g_sampler, IN.uvLocal);
+        sampleData = g_albedoTex[albedoIndex].SampleGrad(g_sampler, IN.uvLocal, uvDx, uvDy);
+    }
 
     float wetness = clamp(IN.water.y, 0.0f, 1.0f);
     float blendStrength = 0.6f;
@@ -0,0 +1,513 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define ASYNC_IO_HAS_URING 1
+#endif
+#endif
+#endif
+
+// Asynchronous positioned reads from one file. Reads are queued from any thread and kept in flight
+// by a single I/O thread, so the disk sees a deep queue without a blocked thread per read:
+//  - Windows: overlapped ReadFile completing on an I/O completion port
+//  - Linux: io_uring, through the raw syscalls
+//  - otherwise, or when io_uring is unavailable: a few threads doing blocking pread
+// Completions run on the I/O thread (or a fallback thread) and should hand off to a job and return.
+struct AsyncIoConstants
+{
+    static constexpr int maxInFlight = 32;
+    static constexpr int fallbackThreads = 4;
+};
+
+enum async_io_backend
+{
+    ASYNC_IO_THREADS,
+    ASYNC_IO_URING,
+    ASYNC_IO_OVERLAPPED
+};
+
+static const char *async_io_backend_name(async_io_backend backend)
+{
+    switch (backend)
+    {
+    case ASYNC_IO_URING:
+        return "io_uring";
+    case ASYNC_IO_OVERLAPPED:
+        return "overlapped";
+    default:
+        return "threads";
+    }
+}
+
+struct async_read
+{
+    Uint64 offset;
+    size_t size;
+    Uint8 *dst;
+    std::function<void(bool ok)> done; // called exactly once, ok only when all size bytes arrived
+};
+
+struct async_file_reader
+{
+    async_io_backend backend = ASYNC_IO_THREADS;
+
+    std::mutex mutex;
+    std::condition_variable cv; // fallback threads wait here
+    std::deque<async_read> pending;
+    bool quit = false;
+    std::vector<std::thread> threads;
+
+    // a read being serviced, may take several short reads to finish
+    struct in_flight
+    {
+#ifdef _WIN32
+        OVERLAPPED overlapped; // first, completions hand back its address
+#endif
+        async_read read;
+        size_t transferred;
+        bool used;
+    };
+    in_flight slots[AsyncIoConstants::maxInFlight] = {};
+
+    // stats since startup, depth is sampled each time a read starts
+    std::atomic<Uint64> bytesRead{0};
+    std::atomic<Uint64> readsCompleted{0};
+    std::atomic<Uint64> readsFailed{0};
+    std::atomic<Uint64> busyTicks{0}; // time with at least one read in flight
+    std::atomic<Uint64> depthSum{0};
+    std::atomic<Uint32> peakDepth{0};
+    int depth = 0; // I/O thread, or under mutex for the fallback threads
+    Uint64 busyStart = 0;
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE port = nullptr;
+#else
+    int fd = -1;
+#endif
+#ifdef ASYNC_IO_HAS_URING
+    struct uring
+    {
+        int fd = -1;
+        int wakeFd = -1; // eventfd, a read of it sits in the ring so read() can interrupt the wait
+        bool wakeArmed = false;
+        unsigned unsubmitted = 0; // sqes queued since the last enter
+        Uint64 wakeValue = 0;
+        void *sqRing = nullptr;
+        size_t sqRingSize = 0;
+        void *cqRing = nullptr;
+        size_t cqRingSize = 0;
+        io_uring_sqe *sqes = nullptr;
+        size_t sqesSize = 0;
+        unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+        unsigned *cqHead, *cqTail, *cqMask;
+        io_uring_cqe *cqes;
+    } ring;
+    static constexpr Uint64 wakeUserData = ~0ull;
+#endif
+
+    // forceThreads picks the fallback backend, to compare against it
+    bool open(const wchar_t *filename, bool forceThreads = false)
+    {
+        close();
+        quit = false;
+#ifdef _WIN32
+        (void)forceThreads;
+        file = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+        port = file != INVALID_HANDLE_VALUE ? CreateIoCompletionPort(file, nullptr, 0, 1) : nullptr;
+        if (!port)
+        {
+            SDL_Log("async_file_reader: failed to open %ls", filename);
+            close();
+            return false;
+        }
+        backend = ASYNC_IO_OVERLAPPED;
+        threads.emplace_back([this]() { overlapped_main(); });
+#else
+        char *path = SDL_iconv_wchar_utf8(filename);
+        fd = path ? ::open(path, O_RDONLY) : -1;
+        SDL_free(path);
+        if (fd < 0)
+        {
+            SDL_Log("async_file_reader: failed to open %ls", filename);
+            return false;
+        }
+        backend = ASYNC_IO_THREADS;
+#ifdef ASYNC_IO_HAS_URING
+        if (!forceThreads && uring_init())
+        {
+            backend = ASYNC_IO_URING;
+            threads.emplace_back([this]() { uring_main(); });
+            return true;
+        }
+#endif
+        (void)forceThreads;
+        for (int i = 0; i < AsyncIoConstants::fallbackThreads; ++i)
+            threads.emplace_back([this]() { fallback_main(); });
+#endif
+        return true;
+    }
+
+    // Finishes every queued read, then stops the I/O thread
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            quit = true;
+        }
+        wake();
+        for (auto &t : threads)
+        {
+            if (t.joinable())
+                t.join();
+        }
+        threads.clear();
+#ifdef _WIN32
+        if (port)
+            CloseHandle(port);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        port = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+#ifdef ASYNC_IO_HAS_URING
+        uring_close();
+#endif
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+    }
+
+    // Any thread. dst must stay valid until done runs.
+    void read(Uint64 offset, size_t size, Uint8 *dst, std::function<void(bool ok)> done)
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            async_read request = {offset, size, dst, std::move(done)};
+            pending.push_back(std::move(request));
+        }
+        wake();
+    }
+
+    ~async_file_reader() { close(); }
+
+  private:
+    void wake()
+    {
+#ifdef _WIN32
+        if (port)
+            PostQueuedCompletionStatus(port, 0, 0, nullptr);
+#else
+#ifdef ASYNC_IO_HAS_URING
+        if (backend == ASYNC_IO_URING && ring.wakeFd >= 0)
+        {
+            Uint64 one = 1;
+            ssize_t written = ::write(ring.wakeFd, &one, sizeof(one));
+            (void)written;
+            return;
+        }
+#endif
+        cv.notify_all();
+#endif
+    }
+
+    void read_started()
+    {
+        if (depth++ == 0)
+            busyStart = SDL_GetPerformanceCounter();
+        depthSum.fetch_add((Uint64)depth, std::memory_order_relaxed);
+        if ((Uint32)depth > peakDepth.load(std::memory_order_relaxed))
+            peakDepth.store((Uint32)depth, std::memory_order_relaxed);
+    }
+
+    // frees the slot and returns its completion, for the caller to run once it holds no lock
+    std::function<void(bool)> read_finished(in_flight &slot, bool ok)
+    {
+        if (--depth == 0)
+            busyTicks.fetch_add(SDL_GetPerformanceCounter() - busyStart, std::memory_order_relaxed);
+        bytesRead.fetch_add(slot.transferred, std::memory_order_relaxed);
+        (ok ? readsCompleted : readsFailed).fetch_add(1, std::memory_order_relaxed);
+        slot.used = false;
+        std::function<void(bool)> done = std::move(slot.read.done);
+        slot.read = {};
+        return done;
+    }
+
+    // I/O thread, moves queued reads into free slots, returns the slots it filled
+    int take_pending(int *started, bool &stop)
+    {
+        int count = 0;
+        std::lock_guard<std::mutex> lk(mutex);
+        for (int i = 0; i < AsyncIoConstants::maxInFlight && !pending.empty(); ++i)
+        {
+            if (slots[i].used)
+                continue;
+            slots[i].read = std::move(pending.front());
+            slots[i].transferred = 0;
+            slots[i].used = true;
+            pending.pop_front();
+            started[count++] = i;
+        }
+        stop = quit && pending.empty();
+        return count;
+    }
+
+#ifdef _WIN32
+    // false when the read failed to start, the slot then completes right away
+    bool overlapped_issue(in_flight &slot)
+    {
+        Uint64 offset = slot.read.offset + slot.transferred;
+        DWORD chunk = (DWORD)SDL_min(slot.read.size - slot.transferred, (size_t)0x40000000);
+        SDL_memset(&slot.overlapped, 0, sizeof(slot.overlapped));
+        slot.overlapped.Offset = (DWORD)offset;
+        slot.overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        // completions are posted to the port even when ReadFile finishes synchronously
+        return ReadFile(file, slot.read.dst + slot.transferred, chunk, nullptr, &slot.overlapped) || GetLastError() == ERROR_IO_PENDING;
+    }
+
+    void overlapped_main()
+    {
+        for (;;)
+        {
+            int started[AsyncIoConstants::maxInFlight];
+            bool stop = false;
+            int count = take_pending(started, stop);
+            for (int i = 0; i < count; ++i)
+            {
+                in_flight &slot = slots[started[i]];
+                read_started();
+                if (slot.read.size == 0)
+                    read_finished(slot, true)(true);
+                else if (!overlapped_issue(slot))
+                    read_finished(slot, false)(false);
+            }
+            if (stop && depth == 0)
+                return;
+
+            OVERLAPPED_ENTRY entries[AsyncIoConstants::maxInFlight];
+            ULONG removed = 0;
+            if (!GetQueuedCompletionStatusEx(port, entries, (ULONG)SDL_arraysize(entries), &removed, INFINITE, FALSE))
+                continue;
+            for (ULONG i = 0; i < removed; ++i)
+            {
+                if (!entries[i].lpOverlapped)
+                    continue; // wake from read() or close()
+                in_flight &slot = *(in_flight *)entries[i].lpOverlapped;
+                DWORD bytes = 0;
+                bool ok = GetOverlappedResult(file, &slot.overlapped, &bytes, FALSE) && bytes > 0;
+                slot.transferred += ok ? bytes : 0;
+                if (ok && slot.transferred < slot.read.size && overlapped_issue(slot))
+                    continue; // short read, the rest is in flight
+                bool complete = slot.transferred == slot.read.size;
+                read_finished(slot, complete)(complete);
+            }
+        }
+    }
+#else
+    void fallback_main()
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        for (;;)
+        {
+            cv.wait(lk, [this]() { return quit || !pending.empty(); });
+            if (pending.empty())
+                return; // quitting with nothing left
+            in_flight slot = {};
+            slot.read = std::move(pending.front());
+            pending.pop_front();
+            read_started();
+            lk.unlock();
+
+            while (slot.transferred < slot.read.size)
+            {
+                ssize_t got = pread(fd, slot.read.dst + slot.transferred, slot.read.size - slot.transferred,
+                                    (off_t)(slot.read.offset + slot.transferred));
+                if (got < 0 && errno == EINTR)
+                    continue;
+                if (got <= 0)
+                    break;
+                slot.transferred += (size_t)got;
+            }
+
+            lk.lock();
+            bool complete = slot.transferred == slot.read.size;
+            std::function<void(bool)> done = read_finished(slot, complete);
+            lk.unlock();
+            done(complete);
+            lk.lock();
+        }
+    }
+#endif
+
+#ifdef ASYNC_IO_HAS_URING
+    bool uring_init()
+    {
+        io_uring_params params = {};
+        ring.fd = (int)syscall(__NR_io_uring_setup, AsyncIoConstants::maxInFlight + 1, &params);
+        if (ring.fd < 0)
+            return false;
+
+        ring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            ring.sqRingSize = ring.cqRingSize = SDL_max(ring.sqRingSize, ring.cqRingSize);
+        ring.sqRing = mmap(nullptr, ring.sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+        if (ring.sqRing == MAP_FAILED)
+            ring.sqRing = nullptr;
+        ring.cqRing = ring.sqRing;
+        if (ring.sqRing && !(params.features & IORING_FEAT_SINGLE_MMAP))
+        {
+            ring.cqRing = mmap(nullptr, ring.cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+            if (ring.cqRing == MAP_FAILED)
+                ring.cqRing = nullptr;
+        }
+        ring.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+        ring.sqes = sqes == MAP_FAILED ? nullptr : (io_uring_sqe *)sqes;
+        ring.wakeFd = eventfd(0, EFD_CLOEXEC);
+        if (!ring.sqRing || !ring.cqRing || !ring.sqes || ring.wakeFd < 0)
+        {
+            uring_close();
+            return false;
+        }
+
+        Uint8 *sq = (Uint8 *)ring.sqRing;
+        ring.sqHead = (unsigned *)(sq + params.sq_off.head);
+        ring.sqTail = (unsigned *)(sq + params.sq_off.tail);
+        ring.sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+        ring.sqArray = (unsigned *)(sq + params.sq_off.array);
+        Uint8 *cq = (Uint8 *)ring.cqRing;
+        ring.cqHead = (unsigned *)(cq + params.cq_off.head);
+        ring.cqTail = (unsigned *)(cq + params.cq_off.tail);
+        ring.cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+        ring.cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void uring_close()
+    {
+        if (ring.sqes)
+            munmap(ring.sqes, ring.sqesSize);
+        if (ring.cqRing && ring.cqRing != ring.sqRing)
+            munmap(ring.cqRing, ring.cqRingSize);
+        if (ring.sqRing)
+            munmap(ring.sqRing, ring.sqRingSize);
+        if (ring.wakeFd >= 0)
+            ::close(ring.wakeFd);
+        if (ring.fd >= 0)
+            ::close(ring.fd);
+        ring = uring();
+    }
+
+    // queues one read sqe, only the I/O thread touches the submission ring
+    void uring_push(int fileFd, void *dst, size_t size, Uint64 offset, Uint64 userData)
+    {
+        unsigned tail = *ring.sqTail;
+        unsigned index = tail & *ring.sqMask;
+        io_uring_sqe &sqe = ring.sqes[index];
+        SDL_memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fileFd;
+        sqe.addr = (Uint64)(uintptr_t)dst;
+        sqe.len = (Uint32)SDL_min(size, (size_t)0x40000000);
+        sqe.off = offset;
+        sqe.user_data = userData;
+        ring.sqArray[index] = index;
+        __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++ring.unsubmitted;
+    }
+
+    void uring_push_slot(int index)
+    {
+        in_flight &slot = slots[index];
+        uring_push(fd, slot.read.dst + slot.transferred, slot.read.size - slot.transferred, slot.read.offset + slot.transferred, (Uint64)index);
+    }
+
+    void uring_main()
+    {
+        for (;;)
+        {
+            int started[AsyncIoConstants::maxInFlight];
+            bool stop = false;
+            int count = take_pending(started, stop);
+            for (int i = 0; i < count; ++i)
+            {
+                read_started();
+                if (slots[started[i]].read.size == 0)
+                {
+                    read_finished(slots[started[i]], true)(true);
+                    continue;
+                }
+                uring_push_slot(started[i]);
+            }
+            if (stop && depth == 0)
+                return;
+            if (!ring.wakeArmed)
+            {
+                uring_push(ring.wakeFd, &ring.wakeValue, sizeof(ring.wakeValue), 0, wakeUserData);
+                ring.wakeArmed = true;
+            }
+
+            int entered = (int)syscall(__NR_io_uring_enter, ring.fd, ring.unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (entered >= 0)
+                ring.unsubmitted -= SDL_min((unsigned)entered, ring.unsubmitted);
+            else if (errno != EINTR)
+            {
+                SDL_Log("async_file_reader: io_uring_enter failed (%d)", errno);
+                return;
+            }
+
+            unsigned head = *ring.cqHead;
+            unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head)
+            {
+                const io_uring_cqe &cqe = ring.cqes[head & *ring.cqMask];
+                if (cqe.user_data == wakeUserData)
+                {
+                    ring.wakeArmed = false;
+                    continue;
+                }
+                in_flight &slot = slots[cqe.user_data];
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+                {
+                    uring_push_slot((int)cqe.user_data);
+                    continue;
+                }
+                slot.transferred += cqe.res > 0 ? (size_t)cqe.res : 0;
+                if (cqe.res > 0 && slot.transferred < slot.read.size)
+                {
+                    uring_push_slot((int)cqe.user_data); // short read, submitted on the next enter
+                    continue;
+                }
+                bool complete = slot.transferred == slot.read.size;
+                read_finished(slot, complete)(complete);
+            }
+            __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+        }
+    }
+#endif
+};
@@ -10,7 +10,9 @@
 #pragma warning(pop)
 
 #include "v3.h"
+#include "horizon.h"
 #include "render_dx12.h"
+#include "job_system.h"
 
 struct BakedHeightmeshConstants
 {
@@ -56,6 +58,8 @@ struct
         Uint32 numIndices[BakedHeightmeshConstants::maxLod] = {};
     };
     lod_range_baked_heightmap_mesh *lodRanges;
+    float *chunkMaxHeight; // per chunk, for horizon culling
+    Uint32 chunksBelowHorizon;
 
     int baked()
     {
@@ -74,69 +78,76 @@ struct
         terrainDimInQuads = img_w - 1;
         float *heightmap = (float *)SDL_malloc(img_w * img_h * sizeof(float));
 
-        for (int y = 0; y < img_h; y++)
+        // rows are independent, bake them across the job system
+        jobSystem.parallel_for(img_h, 16, [&](int rowBegin, int rowEnd)
         {
-            for (int x = 0; x < img_w; x++)
+            for (int y = rowBegin; y < rowEnd; y++)
             {
-                // 16-bit grayscale pixel
-                unsigned short actualColour = img_pixels[y * img_w + (img_w - 1 - x)];
+                for (int x = 0; x < img_w; x++)
+                {
+                    // 16-bit grayscale pixel
+                    unsigned short actualColour = img_pixels[y * img_w + (img_w - 1 - x)];
 
-                float normalized = (float)actualColour / 65535.0f;
+                    float normalized = (float)actualColour / 65535.0f;
 
-                // Apply height scale
-                // TODO: calculate actual scale required automatically?
-                const float swissAlps = 0.071f;
-                const float peloponessus = 0.021f;
-                float heightScale = ((float)terrainDimInQuads * peloponessus);
-                float h = normalized * heightScale;
+                    // Apply height scale
+                    // TODO: calculate actual scale required automatically?
+                    const float swissAlps = 0.071f;
+                    const float peloponessus = 0.021f;
+                    float heightScale = ((float)terrainDimInQuads * peloponessus);
+                    float h = normalized * heightScale;
 
-                heightmap[x + y * img_w] = h;
+                    heightmap[x + y * img_w] = h;
+                }
             }
-        }
+        });
         stbi_image_free(img_pixels);
 
         terrainPointsNum = img_w * img_h;
         terrainPointsSize = sizeof(vertex) * terrainPointsNum;
         terrainPoints = (vertex *)SDL_malloc(terrainPointsSize);
-        for (int x = 0; x < img_w; ++x)
+        jobSystem.parallel_for(img_w, 16, [&](int columnBegin, int columnEnd)
         {
-            for (int y = 0; y < img_h; ++y)
+            for (int x = columnBegin; x < columnEnd; ++x)
             {
-                float _x = (float)x;
-                float _y = heightmap[x + y * img_w];
-                float _z = (float)y;
-
-                vertex v = {};
-                v.position.x = _x;
-                v.position.y = _y;
-                v.position.z = _z;
-
-                float tile = (float)img_w;
-                v.texCoords.x = ((float)x / (float)(img_w - 1)) * tile;
-                v.texCoords.y = ((float)y / (float)(img_h - 1)) * tile;
-
-                int xl = (x > 0) ? x - 1 : x;
-                int xr = (x < img_w - 1) ? x + 1 : x;
-                int yd = (y > 0) ? y - 1 : y;
-                int yu = (y < img_h - 1) ? y + 1 : y;
-                float hL = heightmap[xl + y * img_w];
-                float hR = heightmap[xr + y * img_w];
-                float hD = heightmap[x + yd * img_w];
-                float hU = heightmap[x + yu * img_w];
-
-                // Tangent vectors in X and Z directions
-                v3 dx = {2.0f, hR - hL, 0.0f};
-                v3 dz = {0.0f, hU - hD, 2.0f};
-
-                v3 n = v3::normalised(v3::cross(dz, dx));
-
-                v.normals.x = n.x;
-                v.normals.y = n.y;
-                v.normals.z = n.z;
-
-                terrainPoints[x + y * img_w] = v;
+                for (int y = 0; y < img_h; ++y)
+                {
+                    float _x = (float)x;
+                    float _y = heightmap[x + y * img_w];
+                    float _z = (float)y;
+
+                    vertex v = {};
+                    v.position.x = _x;
+                    v.position.y = _y;
+                    v.position.z = _z;
+
+                    float tile = (float)img_w;
+                    v.texCoords.x = ((float)x / (float)(img_w - 1)) * tile;
+                    v.texCoords.y = ((float)y / (float)(img_h - 1)) * tile;
+
+                    int xl = (x > 0) ? x - 1 : x;
+                    int xr = (x < img_w - 1) ? x + 1 : x;
+                    int yd = (y > 0) ? y - 1 : y;
+                    int yu = (y < img_h - 1) ? y + 1 : y;
+                    float hL = heightmap[xl + y * img_w];
+                    float hR = heightmap[xr + y * img_w];
+                    float hD = heightmap[x + yd * img_w];
+                    float hU = heightmap[x + yu * img_w];
+
+                    // Tangent vectors in X and Z directions
+                    v3 dx = {2.0f, hR - hL, 0.0f};
+                    v3 dz = {0.0f, hU - hD, 2.0f};
+
+                    v3 n = v3::normalised(v3::cross(dz, dx));
+
+                    v.normals.x = n.x;
+                    v.normals.y = n.y;
+                    v.normals.z = n.z;
+
+                    terrainPoints[x + y * img_w] = v;
+                }
             }
-        }
+        });
 
         int quadNum = (img_w - 1) * (img_h - 1);
         terrainMeshIndexBufferSize = (size_t)(quadNum * sizeof(quad_indices) * 2); // TODO: calculate and alloc correct amount of space, we are doing double for now just because that is enough
@@ -148,6 +159,23 @@ struct
         Uint32 writeIndex = 0;
 
         lodRanges = (lod_range_baked_heightmap_mesh *)SDL_malloc((size_t)(chunkNumTotal * sizeof(lod_range_baked_heightmap_mesh)));
+        chunkMaxHeight = (float *)SDL_malloc((size_t)(chunkNumTotal * sizeof(float)));
+        jobSystem.parallel_for((int)chunkNumDim, 1, [&](int rowBegin, int rowEnd)
+        {
+            for (Uint32 cy = (Uint32)rowBegin; cy < (Uint32)rowEnd; ++cy)
+            {
+                for (Uint32 cx = 0; cx < chunkNumDim; ++cx)
+                {
+                    float maxHeight = 0.0f;
+                    for (Uint32 y = 0; y <= chunkDimQuads; ++y)
+                    {
+                        for (Uint32 x = 0; x <= chunkDimQuads; ++x)
+                            maxHeight = SDL_max(maxHeight, terrainPoints[(cx * chunkDimQuads + x) + (cy * chunkDimQuads + y) * img_w].position.y);
+                    }
+                    chunkMaxHeight[cx + cy * chunkNumDim] = maxHeight;
+                }
+            }
+        });
         terrainMeshIndexBuffer_ = (quad_indices *)SDL_malloc((size_t)(terrainMeshIndexBufferSize));
         for (Uint32 lod = 0; lod < BakedHeightmeshConstants::maxLod; ++lod)
         {
@@ -199,7 +227,7 @@ struct
         return 0;
     }
 
-    void draw(v3 cameraPos)
+    void draw(v3 cameraPos, float planetRadius)
     {
         renderState.commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
         renderState.commandList->IASetVertexBuffers(0, 1, &terrainMeshVertexBuffer.vertexBufferView);
@@ -223,11 +251,21 @@ struct
             }
         }
 
+        chunksBelowHorizon = 0;
         for (UINT i = 0; i < baked_heightmap_mesh.chunkNumTotal; ++i)
         {
 
             UINT cx = (i % baked_heightmap_mesh.chunkNumDim) * baked_heightmap_mesh.chunkDimQuads;
             UINT cy = (i / baked_heightmap_mesh.chunkNumDim) * baked_heightmap_mesh.chunkDimQuads;
+
+            // mountains that still poke above the horizon keep their chunk
+            float nearX = SDL_clamp(cameraPos.x, (float)cx, (float)(cx + chunkDimQuads)) - cameraPos.x;
+            float nearZ = SDL_clamp(cameraPos.z, (float)cy, (float)(cy + chunkDimQuads)) - cameraPos.z;
+            if (below_horizon(cameraPos.y, chunkMaxHeight[i], nearX * nearX + nearZ * nearZ, planetRadius))
+            {
+                chunksBelowHorizon++;
+                continue;
+            }
             v3 pointEye = cameraPos;
             int distCx = (pointEye.x - (int)cx);
             int distCy = (pointEye.y - 0);
@@ -236,8 +274,6 @@ struct
 
             int desiredLod = (renderBeyondMaxRange) ? BakedHeightmeshConstants::maxLod - 1 : -1; // -1 == cull
 
-            // TODO: somehow figure out how to cull when a chunk is well below the horizon
-            // dont cull mountains sticking up above horizon?????
             for (int j = 0; j < BakedHeightmeshConstants::maxLod; ++j)
             {
                 if (squaredDist < drawDist[j] * drawDist[j])
@@ -261,6 +297,7 @@ struct
 
         ImGui::Text("Vertices:%d", baked_heightmap_mesh.terrainPointsNum);
         ImGui::Text("Indices:%d", baked_heightmap_mesh.terrainMeshIndexBufferNum);
+        ImGui::Text("Chunks below horizon:%u / %u", baked_heightmap_mesh.chunksBelowHorizon, baked_heightmap_mesh.chunkNumTotal);
 
         ImGui::SliderInt("LodDist", &baked_heightmap_mesh.newBaseDist, BakedHeightmeshConstants::chunkDimVerts, 512);
 
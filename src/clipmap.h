@@ -0,0 +1,495 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include <type_traits>
+
+#include "v3.h"
+#include "horizon.h"
+
+// Geometry clipmap rings built from a handful of small pieces (Losasso & Hoppe 2004).
+// Every ring is n x n vertices with n = 2^k - 1, split into m x m blocks (m = (n + 1) / 4):
+//
+//   B B F B B     B = m x m block
+//   B . . . B     F = m x 3 fix-up strip
+//   F . . . F     . = hole, filled by the next finer ring plus an L-shaped trim
+//   B . . . B
+//   B B F B B
+//
+// All pieces index into the same small vertex grid and are instanced with a per-piece origin,
+// so each piece can be frustum culled on its own.
+struct ClipmapConstants
+{
+    static constexpr int gridDimVerts = 255;                     // n
+    static constexpr int gridDimQuads = gridDimVerts - 1;
+    static constexpr int blockDimVerts = (gridDimVerts + 1) / 4; // m
+    static constexpr int blockDimQuads = blockDimVerts - 1;
+    static constexpr int fixupPos = blockDimQuads * 2;           // first quad of the fix-up strip
+    static constexpr int holeStart = blockDimQuads;
+    static constexpr int holeDimQuads = blockDimQuads * 2 + 2;
+    static constexpr int trimDimQuads = holeDimQuads / 2;         // each trim leg is drawn as two pieces
+    static constexpr int templateDimVerts = trimDimQuads + 1;     // vertex grid shared by every piece
+    static constexpr int maxRings = 10;
+    // 16 blocks + 4 + 4 fix-ups + centre for the finest ring, 12 blocks + 4 fix-ups + 4 trim pieces for the rest
+    static constexpr int maxPiecesPerRing = 25;
+};
+
+enum clipmap_piece
+{
+    CLIPMAP_PIECE_BLOCK,
+    CLIPMAP_PIECE_FIXUP_V, // 2 x m-1 quads, runs along z
+    CLIPMAP_PIECE_FIXUP_H, // m-1 x 2 quads, runs along x
+    CLIPMAP_PIECE_TRIM_H,  // trimDimQuads x 1 quads
+    CLIPMAP_PIECE_TRIM_V,  // 1 x trimDimQuads quads
+    CLIPMAP_PIECE_CENTRE,  // 2 x 2 quads where the fix-ups of the finest ring cross
+    CLIPMAP_PIECE_COUNT
+};
+
+static const int clipmapPieceQuads[CLIPMAP_PIECE_COUNT][2] = {
+    {ClipmapConstants::blockDimQuads, ClipmapConstants::blockDimQuads},
+    {2, ClipmapConstants::blockDimQuads},
+    {ClipmapConstants::blockDimQuads, 2},
+    {ClipmapConstants::trimDimQuads, 1},
+    {1, ClipmapConstants::trimDimQuads},
+    {2, 2},
+};
+
+// Smallest vertex and index types for a DimVerts x DimVerts grid, picked at compile time.
+// Full grid with 8-bit coordinates and 16-bit indices vs 16-bit and 32-bit:
+//   65^2 = 56 KB vs 113 KB, 129^2 = 225 KB vs 449 KB, 255^2 = 883 KB vs 1.72 MB
+template <int DimVerts>
+struct clipmap_grid_template
+{
+    static_assert(DimVerts >= 2 && DimVerts <= 65536, "grid coordinates must fit 16 bits");
+
+    static constexpr int dimVerts = DimVerts;
+    static constexpr Uint32 vertexCount = (Uint32)DimVerts * (Uint32)DimVerts;
+    static constexpr Uint32 fullGridIndexCount = (Uint32)(DimVerts - 1) * (Uint32)(DimVerts - 1) * 6;
+
+    typedef typename std::conditional<(DimVerts <= 256), Uint8, Uint16>::type coord_type;
+    typedef typename std::conditional<(vertexCount <= 65536), Uint16, Uint32>::type index_type;
+
+    struct vertex
+    {
+        coord_type x;
+        coord_type z;
+    };
+
+    // corner 0..5 of quad (x, z), triangles v0 v2 v1 and v1 v2 v3 with v0 at (x, z) and v3 at (x + 1, z + 1)
+    static constexpr index_type quad_index(int x, int z, int corner)
+    {
+        return (index_type)((x + ((corner == 2 || corner == 3 || corner == 5) ? 1 : 0)) +
+                            (z + ((corner == 1 || corner == 4 || corner == 5) ? 1 : 0)) * DimVerts);
+    }
+
+    static constexpr size_t full_grid_bytes()
+    {
+        return vertexCount * sizeof(vertex) + fullGridIndexCount * sizeof(index_type);
+    }
+
+    static void write_vertices(vertex *out)
+    {
+        for (int z = 0; z < DimVerts; ++z)
+        {
+            for (int x = 0; x < DimVerts; ++x)
+            {
+                out[x + z * DimVerts].x = (coord_type)x;
+                out[x + z * DimVerts].z = (coord_type)z;
+            }
+        }
+    }
+
+    // quadsX x quadsZ quads from the grid's first vertex, returns the number of indices written
+    static Uint32 write_quads(index_type *out, int quadsX, int quadsZ)
+    {
+        Uint32 idx = 0;
+        for (int z = 0; z < quadsZ; ++z)
+        {
+            for (int x = 0; x < quadsX; ++x)
+            {
+                for (int corner = 0; corner < 6; ++corner)
+                    out[idx++] = quad_index(x, z, corner);
+            }
+        }
+        return idx;
+    }
+};
+
+static_assert(sizeof(clipmap_grid_template<65>::coord_type) == 1 && sizeof(clipmap_grid_template<65>::index_type) == 2, "65^2 grid");
+static_assert(sizeof(clipmap_grid_template<129>::coord_type) == 1 && sizeof(clipmap_grid_template<129>::index_type) == 2, "129^2 grid");
+static_assert(sizeof(clipmap_grid_template<255>::coord_type) == 1 && sizeof(clipmap_grid_template<255>::index_type) == 2, "255^2 grid");
+static_assert(sizeof(clipmap_grid_template<257>::index_type) == 4, "257^2 vertices no longer fit 16-bit indices");
+static_assert(clipmap_grid_template<255>::quad_index(253, 253, 5) == 255 * 255 - 1, "last index of the 255^2 grid");
+
+typedef clipmap_grid_template<ClipmapConstants::templateDimVerts> clipmap_piece_grid;
+
+// Index ranges for every piece, all addressing the same clipmap_piece_grid vertices
+struct clipmap_template_mesh
+{
+    clipmap_piece_grid::index_type *indexData;
+    size_t indexBufferDataSize;
+    Uint32 indexCount;
+    Uint32 pieceStartIndex[CLIPMAP_PIECE_COUNT];
+    Uint32 pieceIndexCount[CLIPMAP_PIECE_COUNT];
+
+    bool generate()
+    {
+        Uint32 total = 0;
+        for (int p = 0; p < CLIPMAP_PIECE_COUNT; ++p)
+            total += (Uint32)(clipmapPieceQuads[p][0] * clipmapPieceQuads[p][1] * 6);
+
+        indexBufferDataSize = total * sizeof(clipmap_piece_grid::index_type);
+        indexData = (clipmap_piece_grid::index_type *)SDL_malloc(indexBufferDataSize);
+        if (!indexData)
+            return false;
+
+        Uint32 idx = 0;
+        for (int p = 0; p < CLIPMAP_PIECE_COUNT; ++p)
+        {
+            pieceStartIndex[p] = idx;
+            pieceIndexCount[p] = clipmap_piece_grid::write_quads(indexData + idx, clipmapPieceQuads[p][0], clipmapPieceQuads[p][1]);
+            idx += pieceIndexCount[p];
+        }
+        indexCount = idx;
+        return true;
+    }
+};
+
+// Frustum side planes (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside.
+// The far plane is skipped, the terrain projection uses an effectively infinite far plane.
+struct frustum
+{
+    float planes[5][4];
+
+    // m is a row-major view * projection matrix for row vectors (DirectXMath convention)
+    void from_view_projection(const float *m)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            float c0 = m[i * 4 + 0];
+            float c1 = m[i * 4 + 1];
+            float c2 = m[i * 4 + 2];
+            float c3 = m[i * 4 + 3];
+            planes[0][i] = c3 + c0; // left
+            planes[1][i] = c3 - c0; // right
+            planes[2][i] = c3 + c1; // bottom
+            planes[3][i] = c3 - c1; // top
+            planes[4][i] = c2;      // near (z in 0..1)
+        }
+    }
+
+    bool aabb_visible(v3 boxMin, v3 boxMax) const
+    {
+        for (int i = 0; i < 5; ++i)
+        {
+            const float *p = planes[i];
+            // the box corner furthest along the plane normal
+            float x = (p[0] >= 0.0f) ? boxMax.x : boxMin.x;
+            float y = (p[1] >= 0.0f) ? boxMax.y : boxMin.y;
+            float z = (p[2] >= 0.0f) ? boxMax.z : boxMin.z;
+            if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+struct clipmap_ring
+{
+    float originX; // world position of the ring's vertex (0, 0)
+    float originZ;
+    float sampleStep;
+    int trimX; // quad column and row of the L-shaped trim, unused for the finest ring
+    int trimZ;
+};
+
+// Per-instance vertex data, the ring index selects the ring's origin and step in the scene constant buffer
+struct clipmap_instance
+{
+    Uint16 x; // piece origin in ring quads
+    Uint16 z;
+    Uint16 ring;
+    Uint16 pad;
+};
+
+struct clipmap_cull_params
+{
+    v3 cameraPos;
+    float minHeight; // conservative terrain height range before curvature
+    float maxHeight;
+    float planetRadius;
+    // optional tighter maxHeight per square region, row major from the ring coordinate origin, may be null
+    const float *regionMaxHeight;
+    int regionCountX;
+    int regionCountZ;
+    float regionSize;
+
+    // highest terrain any point of [minX, maxX] x [minZ, maxZ] can have, maxHeight outside the regions
+    float max_height_in(float minX, float minZ, float maxX, float maxZ) const
+    {
+        if (!regionMaxHeight)
+            return maxHeight;
+        int x0 = (int)SDL_floorf(minX / regionSize);
+        int z0 = (int)SDL_floorf(minZ / regionSize);
+        int x1 = (int)SDL_floorf(maxX / regionSize);
+        int z1 = (int)SDL_floorf(maxZ / regionSize);
+        if (x0 < 0 || z0 < 0 || x1 >= regionCountX || z1 >= regionCountZ)
+            return maxHeight;
+        float result = 0.0f;
+        for (int z = z0; z <= z1; ++z)
+        {
+            for (int x = x0; x <= x1; ++x)
+                result = SDL_max(result, regionMaxHeight[x + z * regionCountX]);
+        }
+        return result;
+    }
+
+    float nearest_dist2(float minX, float minZ, float maxX, float maxZ) const
+    {
+        float dx = SDL_clamp(cameraPos.x, minX, maxX) - cameraPos.x;
+        float dz = SDL_clamp(cameraPos.z, minZ, maxZ) - cameraPos.z;
+        return dx * dx + dz * dz;
+    }
+
+    bool below_horizon(float minX, float minZ, float maxX, float maxZ) const
+    {
+        return ::below_horizon(cameraPos.y, max_height_in(minX, minZ, maxX, maxZ), nearest_dist2(minX, minZ, maxX, maxZ), planetRadius);
+    }
+};
+
+struct clipmap_lod_params
+{
+    float cameraHeight;      // above the zero height plane
+    float centreOffset;      // horizontal distance from the camera to the clipmap centre
+    float fovY;
+    float screenHeight;      // pixels
+    float targetErrorPixels; // largest acceptable on-screen vertex spacing
+    float maxTerrainHeight;
+    float planetRadius;
+    float maxViewDistance;
+};
+
+struct clipmap_lod
+{
+    int firstRing; // finer rings would be below the target error
+    int ringCount;
+    float horizonDistance;
+    float coverage; // distance from the centre to the edge of the outermost ring
+};
+
+// Picks the rings to draw from the camera. The outermost ring has to reach the horizon of the
+// curved terrain, the innermost is the coarsest one whose spacing is still under the target error
+// directly below the camera.
+static inline clipmap_lod clipmap_select_lod(const clipmap_lod_params &params)
+{
+    clipmap_lod lod = {};
+
+    float horizon = horizon_distance(SDL_max(params.cameraHeight, 1.0f), params.maxTerrainHeight, params.planetRadius);
+    lod.horizonDistance = SDL_min(horizon, params.maxViewDistance);
+
+    // the visible half of the horizon circle is at most this far from the forward shifted centre
+    float required = SDL_sqrtf(lod.horizonDistance * lod.horizonDistance + params.centreOffset * params.centreOffset);
+
+    // projected size of one world unit at distance 1
+    float pixelsPerUnit = params.screenHeight / (2.0f * SDL_tanf(params.fovY * 0.5f));
+    float nearest = SDL_max(params.cameraHeight - params.maxTerrainHeight, 1.0f);
+    int firstRing = 0;
+    while (firstRing + 1 < ClipmapConstants::maxRings &&
+           (float)(2 << firstRing) * pixelsPerUnit / nearest <= params.targetErrorPixels)
+        firstRing++;
+
+    // a ring is snapped to twice its step, so its edge is at least fixupPos steps from the centre
+    int lastRing = firstRing;
+    while (lastRing + 1 < ClipmapConstants::maxRings &&
+           (float)ClipmapConstants::fixupPos * (float)(1 << lastRing) < required)
+        lastRing++;
+
+    lod.firstRing = firstRing;
+    lod.ringCount = lastRing + 1;
+    lod.coverage = (float)ClipmapConstants::fixupPos * (float)(1 << lastRing);
+    return lod;
+}
+
+struct clipmap_draw_list
+{
+    static constexpr int maxInstances = ClipmapConstants::maxPiecesPerRing * ClipmapConstants::maxRings;
+
+    clipmap_ring rings[ClipmapConstants::maxRings];
+    int firstRing; // rings below it are skipped, the first drawn ring fills its own hole
+    int ringCount;
+    // grouped by piece type so each piece shape is a single instanced draw over every ring
+    clipmap_instance instances[maxInstances];
+    Uint32 instanceCount;
+    Uint32 pieceFirstInstance[CLIPMAP_PIECE_COUNT];
+    Uint32 pieceInstanceCount[CLIPMAP_PIECE_COUNT];
+
+    Uint32 trianglesSubmitted;
+    Uint32 trianglesTotal;
+    Uint32 trianglesBelowHorizon;
+
+    // Ring origins are snapped to twice their own sample step so every ring lands on the even
+    // vertices of the next coarser one, leaving a gap of zero or one coarse quad for the trim.
+    static float ring_origin(float centre, float sampleStep)
+    {
+        float snapStep = sampleStep * 2.0f;
+        return SDL_floorf(centre / snapStep) * snapStep - (float)ClipmapConstants::fixupPos * sampleStep;
+    }
+
+    // Origins (in ring quads) of every piece of one type in a ring, returns how many were written
+    static int ring_pieces(bool finest, const clipmap_ring &ring, int piece, int out[16][2])
+    {
+        const int B = ClipmapConstants::blockDimQuads;
+        const int blockPos[4] = {0, B, ClipmapConstants::fixupPos + 2, ClipmapConstants::fixupPos + 2 + B};
+        int n = 0;
+        switch (piece)
+        {
+        case CLIPMAP_PIECE_BLOCK:
+        {
+            for (int by = 0; by < 4; ++by)
+            {
+                for (int bx = 0; bx < 4; ++bx)
+                {
+                    bool perimeter = (bx == 0 || bx == 3 || by == 0 || by == 3);
+                    if (finest || perimeter)
+                    {
+                        out[n][0] = blockPos[bx];
+                        out[n][1] = blockPos[by];
+                        n++;
+                    }
+                }
+            }
+        }
+        break;
+        case CLIPMAP_PIECE_FIXUP_V:
+        case CLIPMAP_PIECE_FIXUP_H:
+        {
+            for (int b = 0; b < 4; ++b)
+            {
+                if (!finest && (b == 1 || b == 2))
+                    continue; // inside the hole
+                bool vertical = (piece == CLIPMAP_PIECE_FIXUP_V);
+                out[n][0] = vertical ? ClipmapConstants::fixupPos : blockPos[b];
+                out[n][1] = vertical ? blockPos[b] : ClipmapConstants::fixupPos;
+                n++;
+            }
+        }
+        break;
+        case CLIPMAP_PIECE_TRIM_H:
+        case CLIPMAP_PIECE_TRIM_V:
+        {
+            if (finest)
+                break;
+            // the two legs share their corner quad, it is drawn twice with identical vertices
+            for (int t = 0; t < 2; ++t)
+            {
+                int along = ClipmapConstants::holeStart + t * ClipmapConstants::trimDimQuads;
+                bool horizontal = (piece == CLIPMAP_PIECE_TRIM_H);
+                out[n][0] = horizontal ? along : ring.trimX;
+                out[n][1] = horizontal ? ring.trimZ : along;
+                n++;
+            }
+        }
+        break;
+        case CLIPMAP_PIECE_CENTRE:
+        {
+            if (!finest)
+                break;
+            out[n][0] = ClipmapConstants::fixupPos;
+            out[n][1] = ClipmapConstants::fixupPos;
+            n++;
+        }
+        break;
+        }
+        return n;
+    }
+
+    void build(v3 clipmapCentre, int skipRings, int activeRings, const frustum &view, const clipmap_cull_params &cull)
+    {
+        ringCount = SDL_clamp(activeRings, 1, ClipmapConstants::maxRings);
+        firstRing = SDL_clamp(skipRings, 0, ringCount - 1);
+        instanceCount = 0;
+        trianglesSubmitted = 0;
+        trianglesTotal = 0;
+        trianglesBelowHorizon = 0;
+
+        for (int i = 0; i < ringCount; ++i)
+        {
+            clipmap_ring &ring = rings[i];
+            float s = (float)(1 << i);
+            ring.sampleStep = s;
+            ring.originX = ring_origin(clipmapCentre.x, s);
+            ring.originZ = ring_origin(clipmapCentre.z, s);
+            ring.trimX = 0;
+            ring.trimZ = 0;
+            if (i > firstRing)
+            {
+                // the finer ring sits at the low or high edge of the hole, the trim fills the other edge
+                const clipmap_ring &inner = rings[i - 1];
+                float holeX = ring.originX + ClipmapConstants::holeStart * s;
+                float holeZ = ring.originZ + ClipmapConstants::holeStart * s;
+                int holeEnd = ClipmapConstants::holeStart + ClipmapConstants::holeDimQuads - 1;
+                ring.trimX = (inner.originX > holeX + 0.5f * s) ? ClipmapConstants::holeStart : holeEnd;
+                ring.trimZ = (inner.originZ > holeZ + 0.5f * s) ? ClipmapConstants::holeStart : holeEnd;
+            }
+        }
+
+        // a ring whose whole square is past the horizon (only possible with a forward shifted centre) is skipped outright
+        bool ringBelowHorizon[ClipmapConstants::maxRings];
+        for (int i = firstRing; i < ringCount; ++i)
+        {
+            const clipmap_ring &ring = rings[i];
+            float extent = (float)ClipmapConstants::gridDimQuads * ring.sampleStep;
+            ringBelowHorizon[i] = cull.below_horizon(ring.originX, ring.originZ, ring.originX + extent, ring.originZ + extent);
+        }
+
+        int pieces[16][2];
+        for (int p = 0; p < CLIPMAP_PIECE_COUNT; ++p)
+        {
+            Uint32 pieceTriangles = (Uint32)(clipmapPieceQuads[p][0] * clipmapPieceQuads[p][1] * 2);
+            pieceFirstInstance[p] = instanceCount;
+            for (int i = firstRing; i < ringCount; ++i)
+            {
+                const clipmap_ring &ring = rings[i];
+                float s = ring.sampleStep;
+                int pieceNum = ring_pieces(i == firstRing, ring, p, pieces);
+                for (int n = 0; n < pieceNum; ++n)
+                {
+                    int px = pieces[n][0];
+                    int pz = pieces[n][1];
+                    trianglesTotal += pieceTriangles;
+
+                    v3 boxMin = {ring.originX + px * s, 0.0f, ring.originZ + pz * s};
+                    v3 boxMax = {boxMin.x + clipmapPieceQuads[p][0] * s, 0.0f, boxMin.z + clipmapPieceQuads[p][1] * s};
+                    if (ringBelowHorizon[i] || cull.below_horizon(boxMin.x, boxMin.z, boxMax.x, boxMax.z))
+                    {
+                        trianglesBelowHorizon += pieceTriangles;
+                        continue;
+                    }
+                    curved_height_range(cull, boxMin, boxMax);
+                    if (!view.aabb_visible(boxMin, boxMax))
+                        continue;
+
+                    clipmap_instance &instance = instances[instanceCount++];
+                    instance.x = (Uint16)px;
+                    instance.z = (Uint16)pz;
+                    instance.ring = (Uint16)i;
+                    instance.pad = 0;
+                    trianglesSubmitted += pieceTriangles;
+                }
+            }
+            pieceInstanceCount[p] = instanceCount - pieceFirstInstance[p];
+        }
+    }
+
+    // The vertex shader bends terrain down by dist^2 / (2 * planetRadius) around the camera,
+    // so the box has to cover that drop over its nearest and furthest points.
+    static void curved_height_range(const clipmap_cull_params &cull, v3 &boxMin, v3 &boxMax)
+    {
+        float farX = SDL_max(SDL_fabsf(boxMin.x - cull.cameraPos.x), SDL_fabsf(boxMax.x - cull.cameraPos.x));
+        float farZ = SDL_max(SDL_fabsf(boxMin.z - cull.cameraPos.z), SDL_fabsf(boxMax.z - cull.cameraPos.z));
+        float nearDist2 = cull.nearest_dist2(boxMin.x, boxMin.z, boxMax.x, boxMax.z);
+        float farDist2 = farX * farX + farZ * farZ;
+        boxMin.y = cull.minHeight - farDist2 / (2.0f * cull.planetRadius);
+        boxMax.y = cull.max_height_in(boxMin.x, boxMin.z, boxMax.x, boxMax.z) - nearDist2 / (2.0f * cull.planetRadius);
+    }
+};
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include "clipmap.h"
+#include "height_overview.h"
+
+// CPU clipmap height pyramid: one small levelDim x levelDim height level per clipmap ring, addressed
+// toroidally so that moving the camera only rewrites the newly exposed L-shaped strips.
+// Levels are decimated (point sampled) from the streamed tiles, which keeps every coarse vertex at the
+// exact height of the finer ring vertex it shares a position with, the same as reading the full tiles.
+// Levels no finer than the height overview (see height_overview.h) read it instead, it covers the whole world.
+struct HeightPyramidConstants
+{
+    static constexpr int levelDim = 256; // power of two >= ClipmapConstants::gridDimVerts, wrapping is a mask
+    static constexpr int levelMask = levelDim - 1;
+    static constexpr int levelCount = ClipmapConstants::maxRings;
+    static constexpr int firstLevel = 3; // finer rings keep reading the streamed tiles, which also keeps the CPU tile copies small
+    static constexpr int tileDim = 4096;
+};
+
+static inline int floor_div(int a, int b)
+{
+    int q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+// Decimated CPU copy of one height tile for levels firstLevel.. (about 0.7 MB for a 4096^2 tile)
+struct height_tile_mips
+{
+    int tileX;
+    int tileY;
+    Uint16 maxHeight; // over every texel of the full resolution tile, for horizon culling
+    Uint16 *memory;
+    Uint16 *mips[HeightPyramidConstants::levelCount]; // (tileDim >> l)^2 texels, null below firstLevel
+
+    // texels of every level from firstLevel down
+    static size_t texel_count()
+    {
+        size_t total = 0;
+        for (int l = HeightPyramidConstants::firstLevel; l < HeightPyramidConstants::levelCount; ++l)
+        {
+            size_t dim = (size_t)(HeightPyramidConstants::tileDim >> l);
+            total += dim * dim;
+        }
+        return total;
+    }
+
+    bool allocate()
+    {
+        memory = (Uint16 *)SDL_malloc(texel_count() * sizeof(Uint16));
+        if (!memory)
+            return false;
+        Uint16 *write = memory;
+        for (int l = 0; l < HeightPyramidConstants::levelCount; ++l)
+        {
+            mips[l] = nullptr;
+            if (l < HeightPyramidConstants::firstLevel)
+                continue;
+            int dim = HeightPyramidConstants::tileDim >> l;
+            mips[l] = write;
+            write += (size_t)dim * dim;
+        }
+        return true;
+    }
+
+    // texels are R16_UNORM or R32_FLOAT, tileDim x tileDim
+    bool build(const void *texels, size_t rowPitch, bool isFloat)
+    {
+        if (!allocate())
+            return false;
+
+        maxHeight = 0;
+        for (int y = 0; y < HeightPyramidConstants::tileDim; ++y)
+        {
+            const Uint8 *srcRow = (const Uint8 *)texels + (size_t)y * rowPitch;
+            if (isFloat)
+            {
+                const float *src = (const float *)srcRow;
+                float rowMax = 0.0f;
+                for (int x = 0; x < HeightPyramidConstants::tileDim; ++x)
+                    rowMax = SDL_max(rowMax, src[x]);
+                maxHeight = SDL_max(maxHeight, (Uint16)SDL_ceilf(SDL_clamp(rowMax, 0.0f, 1.0f) * 65535.0f));
+            }
+            else
+            {
+                const Uint16 *src = (const Uint16 *)srcRow;
+                for (int x = 0; x < HeightPyramidConstants::tileDim; ++x)
+                    maxHeight = SDL_max(maxHeight, src[x]);
+            }
+        }
+
+        // first level straight from the tile, every following level from the one before it
+        const int first = HeightPyramidConstants::firstLevel;
+        const int firstDim = HeightPyramidConstants::tileDim >> first;
+        for (int y = 0; y < firstDim; ++y)
+        {
+            const Uint8 *srcRow = (const Uint8 *)texels + (size_t)(y << first) * rowPitch;
+            Uint16 *dstRow = mips[first] + (size_t)y * firstDim;
+            if (isFloat)
+            {
+                const float *src = (const float *)srcRow;
+                for (int x = 0; x < firstDim; ++x)
+                {
+                    float h = SDL_clamp(src[x << first], 0.0f, 1.0f);
+                    dstRow[x] = (Uint16)(h * 65535.0f + 0.5f);
+                }
+            }
+            else
+            {
+                const Uint16 *src = (const Uint16 *)srcRow;
+                for (int x = 0; x < firstDim; ++x)
+                    dstRow[x] = src[x << first];
+            }
+        }
+        for (int l = first + 1; l < HeightPyramidConstants::levelCount; ++l)
+        {
+            int dim = HeightPyramidConstants::tileDim >> l;
+            const Uint16 *src = mips[l - 1];
+            Uint16 *dst = mips[l];
+            for (int y = 0; y < dim; ++y)
+            {
+                const Uint16 *srcRow = src + (size_t)(y * 2) * (dim * 2);
+                for (int x = 0; x < dim; ++x)
+                    dst[(size_t)y * dim + x] = srcRow[x * 2];
+            }
+        }
+        return true;
+    }
+
+    // copy of another tile's mips, for a tile whose content is identical
+    bool clone(const height_tile_mips &from, int _tileX, int _tileY)
+    {
+        if (!allocate())
+            return false;
+        SDL_memcpy(memory, from.memory, texel_count() * sizeof(Uint16));
+        tileX = _tileX;
+        tileY = _tileY;
+        maxHeight = from.maxHeight;
+        return true;
+    }
+
+    // a tile the archive stores as one height, R16_UNORM units
+    bool fill(Uint16 height, int _tileX, int _tileY)
+    {
+        if (!allocate())
+            return false;
+        size_t total = texel_count();
+        for (size_t i = 0; i < total; ++i)
+            memory[i] = height;
+        tileX = _tileX;
+        tileY = _tileY;
+        maxHeight = height;
+        return true;
+    }
+
+    void release()
+    {
+        SDL_free(memory);
+        memory = nullptr;
+        for (int l = 0; l < HeightPyramidConstants::levelCount; ++l)
+            mips[l] = nullptr;
+    }
+};
+
+// Resident CPU tiles, owned by the main thread. Workers hand finished tiles over, they never touch this directly.
+struct height_tile_source
+{
+    static constexpr int maxTiles = 32;
+    height_tile_mips tiles[maxTiles];
+    int tileCount;
+
+    const height_tile_mips *find_tile(int tileX, int tileY) const
+    {
+        for (int i = 0; i < tileCount; ++i)
+        {
+            if (tiles[i].tileX == tileX && tiles[i].tileY == tileY)
+                return &tiles[i];
+        }
+        return nullptr;
+    }
+
+    const Uint16 *find(int tileX, int tileY, int level) const
+    {
+        const height_tile_mips *tile = find_tile(tileX, tileY);
+        return tile ? tile->mips[level] : nullptr;
+    }
+
+    // takes ownership of the mips; tiles outside the given window make room when full
+    void insert(const height_tile_mips &mips, int windowX, int windowY, int windowW)
+    {
+        for (int i = 0; i < tileCount; ++i)
+        {
+            if (tiles[i].tileX == mips.tileX && tiles[i].tileY == mips.tileY)
+            {
+                tiles[i].release();
+                tiles[i] = mips;
+                return;
+            }
+        }
+        if (tileCount == maxTiles)
+        {
+            for (int i = 0; i < tileCount; ++i)
+            {
+                const height_tile_mips &t = tiles[i];
+                bool inWindow = t.tileX >= windowX && t.tileX < windowX + windowW &&
+                                t.tileY >= windowY && t.tileY < windowY + windowW;
+                if (!inWindow)
+                {
+                    tiles[i].release();
+                    tiles[i] = tiles[--tileCount];
+                    break;
+                }
+            }
+        }
+        if (tileCount == maxTiles)
+        {
+            height_tile_mips dropped = mips;
+            dropped.release();
+            return;
+        }
+        tiles[tileCount++] = mips;
+    }
+};
+
+struct clipmap_height_level
+{
+    Uint16 texels[HeightPyramidConstants::levelDim * HeightPyramidConstants::levelDim]; // texel (x, z) at (x & mask, z & mask)
+    int originX; // absolute level texel covered by the first row/column, i.e. world / sampleStep
+    int originZ;
+    bool valid;
+    bool dirty; // changed since the last GPU upload
+};
+
+struct clipmap_height_pyramid
+{
+    clipmap_height_level levels[HeightPyramidConstants::levelCount];
+    Uint32 texelsUpdated; // since the last reset, for profiling
+    const height_overview *overview;
+    int overviewMips[HeightPyramidConstants::levelCount]; // overview mip a level reads, -1 for the streamed tiles
+
+    // Levels whose texels per tile match an overview mip read it from now on. Returns the first such level,
+    // levelCount when the overview doesn't fit any (it has to be cut from tileDim tiles).
+    int use_overview(const height_overview *_overview)
+    {
+        overview = _overview;
+        int first = HeightPyramidConstants::levelCount;
+        for (int l = 0; l < HeightPyramidConstants::levelCount; ++l)
+        {
+            overviewMips[l] = -1;
+            if (l < HeightPyramidConstants::firstLevel || !overview || overview->sourceDim != (Uint32)HeightPyramidConstants::tileDim)
+                continue;
+            Uint32 levelTexels = (Uint32)(HeightPyramidConstants::tileDim >> l);
+            for (Uint32 mip = 0; mip < overview->mipCount; ++mip)
+            {
+                if ((overview->tileDim >> mip) == levelTexels)
+                    overviewMips[l] = (int)mip;
+            }
+            if (overviewMips[l] >= 0)
+            {
+                first = SDL_min(first, l);
+                levels[l].valid = false; // refilled from the overview on the next update
+            }
+        }
+        return first;
+    }
+
+    // Writes level texels [x0, x1) x [z0, z1), copying contiguous runs out of each tile row
+    void fill_rect(int level, int x0, int z0, int x1, int z1, const height_tile_source &source)
+    {
+        const int dim = HeightPyramidConstants::levelDim;
+        const int mask = HeightPyramidConstants::levelMask;
+        const int tileTexels = HeightPyramidConstants::tileDim >> level;
+        clipmap_height_level &lvl = levels[level];
+        if (x1 <= x0 || z1 <= z0)
+            return;
+
+        for (int z = z0; z < z1; ++z)
+        {
+            int tileY = floor_div(z, tileTexels);
+            int localZ = z - tileY * tileTexels;
+            Uint16 *dstRow = lvl.texels + (size_t)(z & mask) * dim;
+            int x = x0;
+            while (x < x1)
+            {
+                int tileX = floor_div(x, tileTexels);
+                int localX = x - tileX * tileTexels;
+                // a run stops at the end of the source tile or where the destination wraps
+                int run = SDL_min(x1 - x, tileTexels - localX);
+                run = SDL_min(run, dim - (x & mask));
+
+                const Uint16 *src = overview && overviewMips[level] >= 0 ? overview->find(tileX, tileY, (Uint32)overviewMips[level])
+                                                                          : source.find(tileX, tileY, level);
+                if (src)
+                    SDL_memcpy(dstRow + (x & mask), src + (size_t)localZ * tileTexels + localX, run * sizeof(Uint16));
+                else
+                    SDL_memset(dstRow + (x & mask), 0, run * sizeof(Uint16));
+                x += run;
+            }
+        }
+        texelsUpdated += (Uint32)((x1 - x0) * (z1 - z0));
+        lvl.dirty = true;
+    }
+
+    // Moves a level to a new origin, only the strips that scrolled into view are rewritten
+    void update(int level, int newOriginX, int newOriginZ, const height_tile_source &source)
+    {
+        const int dim = HeightPyramidConstants::levelDim;
+        clipmap_height_level &lvl = levels[level];
+        int dx = newOriginX - lvl.originX;
+        int dz = newOriginZ - lvl.originZ;
+
+        if (!lvl.valid || SDL_abs(dx) >= dim || SDL_abs(dz) >= dim)
+        {
+            lvl.originX = newOriginX;
+            lvl.originZ = newOriginZ;
+            lvl.valid = true;
+            fill_rect(level, newOriginX, newOriginZ, newOriginX + dim, newOriginZ + dim, source);
+            return;
+        }
+        if (dx == 0 && dz == 0)
+            return;
+
+        // columns that entered, over the full new height
+        int colX0 = (dx > 0) ? lvl.originX + dim : newOriginX;
+        int colX1 = (dx > 0) ? newOriginX + dim : lvl.originX;
+        fill_rect(level, colX0, newOriginZ, colX1, newOriginZ + dim, source);
+
+        // rows that entered, skipping the columns written above
+        int keptX0 = (dx > 0) ? newOriginX : lvl.originX;
+        int keptX1 = (dx > 0) ? lvl.originX + dim : newOriginX + dim;
+        int rowZ0 = (dz > 0) ? lvl.originZ + dim : newOriginZ;
+        int rowZ1 = (dz > 0) ? newOriginZ + dim : lvl.originZ;
+        fill_rect(level, keptX0, rowZ0, keptX1, rowZ1, source);
+
+        lvl.originX = newOriginX;
+        lvl.originZ = newOriginZ;
+    }
+
+    // Refreshes whatever part of every level a newly arrived tile covers
+    void invalidate_tile(int tileX, int tileY, const height_tile_source &source)
+    {
+        const int dim = HeightPyramidConstants::levelDim;
+        for (int l = HeightPyramidConstants::firstLevel; l < HeightPyramidConstants::levelCount; ++l)
+        {
+            const clipmap_height_level &lvl = levels[l];
+            if (!lvl.valid || (overview && overviewMips[l] >= 0))
+                continue; // the overview doesn't change
+            int tileTexels = HeightPyramidConstants::tileDim >> l;
+            int x0 = SDL_max(lvl.originX, tileX * tileTexels);
+            int z0 = SDL_max(lvl.originZ, tileY * tileTexels);
+            int x1 = SDL_min(lvl.originX + dim, (tileX + 1) * tileTexels);
+            int z1 = SDL_min(lvl.originZ + dim, (tileY + 1) * tileTexels);
+            fill_rect(l, x0, z0, x1, z1, source);
+        }
+    }
+};
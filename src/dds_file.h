@@ -0,0 +1,343 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include "mapped_file.h"
+
+// Memory mapped DDS reader. The header (legacy or DX10) is parsed in place and every surface points
+// straight into the mapping, so uploads copy the pixels once, from the page cache into the upload heap.
+// Formats are DXGI_FORMAT values, kept as plain integers so this file builds without the D3D headers.
+struct DdsConstants
+{
+    static constexpr Uint32 magic = 0x20534444; // "DDS "
+    static constexpr size_t headerSize = 124;
+    static constexpr size_t dx10HeaderSize = 20;
+    static constexpr int maxMips = 16;
+
+    // DXGI_FORMAT values the reader knows the layout of
+    static constexpr Uint32 formatR32G32B32A32Float = 2;
+    static constexpr Uint32 formatR16G16B16A16Float = 10;
+    static constexpr Uint32 formatR16G16B16A16Unorm = 11;
+    static constexpr Uint32 formatR32G32Float = 16;
+    static constexpr Uint32 formatR10G10B10A2Unorm = 24;
+    static constexpr Uint32 formatR8G8B8A8Unorm = 28;
+    static constexpr Uint32 formatR8G8B8A8UnormSrgb = 29;
+    static constexpr Uint32 formatR16G16Unorm = 35;
+    static constexpr Uint32 formatR32Float = 41;
+    static constexpr Uint32 formatR8G8Unorm = 49;
+    static constexpr Uint32 formatR16Float = 54;
+    static constexpr Uint32 formatR16Unorm = 56;
+    static constexpr Uint32 formatR8Unorm = 61;
+    static constexpr Uint32 formatBC1Unorm = 71;
+    static constexpr Uint32 formatBC1UnormSrgb = 72;
+    static constexpr Uint32 formatBC2Unorm = 74;
+    static constexpr Uint32 formatBC2UnormSrgb = 75;
+    static constexpr Uint32 formatBC3Unorm = 77;
+    static constexpr Uint32 formatBC3UnormSrgb = 78;
+    static constexpr Uint32 formatBC4Unorm = 80;
+    static constexpr Uint32 formatBC4Snorm = 81;
+    static constexpr Uint32 formatBC5Unorm = 83;
+    static constexpr Uint32 formatBC5Snorm = 84;
+    static constexpr Uint32 formatB8G8R8A8Unorm = 87;
+    static constexpr Uint32 formatB8G8R8X8Unorm = 88;
+    static constexpr Uint32 formatB8G8R8A8UnormSrgb = 91;
+    static constexpr Uint32 formatBC6HUf16 = 95;
+    static constexpr Uint32 formatBC6HSf16 = 96;
+    static constexpr Uint32 formatBC7Unorm = 98;
+    static constexpr Uint32 formatBC7UnormSrgb = 99;
+};
+
+static constexpr Uint32 dds_fourcc(char a, char b, char c, char d)
+{
+    return (Uint32)(Uint8)a | ((Uint32)(Uint8)b << 8) | ((Uint32)(Uint8)c << 16) | ((Uint32)(Uint8)d << 24);
+}
+
+// bytes per 4x4 block for BCn formats, 0 otherwise
+static inline Uint32 dds_block_bytes(Uint32 format)
+{
+    switch (format)
+    {
+    case DdsConstants::formatBC1Unorm:
+    case DdsConstants::formatBC1UnormSrgb:
+    case DdsConstants::formatBC4Unorm:
+    case DdsConstants::formatBC4Snorm:
+        return 8;
+    case DdsConstants::formatBC2Unorm:
+    case DdsConstants::formatBC2UnormSrgb:
+    case DdsConstants::formatBC3Unorm:
+    case DdsConstants::formatBC3UnormSrgb:
+    case DdsConstants::formatBC5Unorm:
+    case DdsConstants::formatBC5Snorm:
+    case DdsConstants::formatBC6HUf16:
+    case DdsConstants::formatBC6HSf16:
+    case DdsConstants::formatBC7Unorm:
+    case DdsConstants::formatBC7UnormSrgb:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+// bits per pixel for uncompressed formats, 0 for BCn and formats the reader doesn't know
+static inline Uint32 dds_bits_per_pixel(Uint32 format)
+{
+    switch (format)
+    {
+    case DdsConstants::formatR32G32B32A32Float:
+        return 128;
+    case DdsConstants::formatR16G16B16A16Float:
+    case DdsConstants::formatR16G16B16A16Unorm:
+    case DdsConstants::formatR32G32Float:
+        return 64;
+    case DdsConstants::formatR10G10B10A2Unorm:
+    case DdsConstants::formatR8G8B8A8Unorm:
+    case DdsConstants::formatR8G8B8A8UnormSrgb:
+    case DdsConstants::formatR16G16Unorm:
+    case DdsConstants::formatR32Float:
+    case DdsConstants::formatB8G8R8A8Unorm:
+    case DdsConstants::formatB8G8R8X8Unorm:
+    case DdsConstants::formatB8G8R8A8UnormSrgb:
+        return 32;
+    case DdsConstants::formatR8G8Unorm:
+    case DdsConstants::formatR16Float:
+    case DdsConstants::formatR16Unorm:
+        return 16;
+    case DdsConstants::formatR8Unorm:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+// byte size of one mip, 0 for formats the reader doesn't know. Tightly packed, the same pitches DirectXTex uses.
+static inline size_t dds_surface_size(Uint32 format, Uint32 width, Uint32 height, size_t *rowPitch)
+{
+    Uint32 blockBytes = dds_block_bytes(format);
+    if (blockBytes)
+    {
+        *rowPitch = (size_t)SDL_max((width + 3) / 4, 1u) * blockBytes;
+        return *rowPitch * SDL_max((height + 3) / 4, 1u);
+    }
+    *rowPitch = ((size_t)width * dds_bits_per_pixel(format) + 7) / 8;
+    return *rowPitch * height;
+}
+
+// one mip, pixels point into a mapping
+struct dds_surface
+{
+    const Uint8 *pixels;
+    size_t rowPitch;
+    size_t slicePitch;
+    Uint32 width;
+    Uint32 height;
+};
+
+// a 2D texture's mip chain, wherever it is mapped from
+struct dds_image
+{
+    Uint32 width;
+    Uint32 height;
+    Uint32 mipLevels;
+    Uint32 format; // DXGI_FORMAT
+    dds_surface surfaces[DdsConstants::maxMips];
+
+    // Points the surfaces at a tightly packed mip chain starting at pixels, false if it doesn't fit in available bytes
+    bool layout(const Uint8 *pixels, size_t available)
+    {
+        if (width == 0 || height == 0 || mipLevels == 0 || mipLevels > (Uint32)DdsConstants::maxMips)
+        {
+            SDL_Log("dds_image: bad dimensions %ux%u, %u mips", width, height, mipLevels);
+            return false;
+        }
+        if (!dds_block_bytes(format) && !dds_bits_per_pixel(format))
+        {
+            SDL_Log("dds_image: unsupported format %u", format);
+            return false;
+        }
+        size_t offset = 0;
+        Uint32 w = width;
+        Uint32 h = height;
+        for (Uint32 mip = 0; mip < mipLevels; ++mip)
+        {
+            dds_surface &s = surfaces[mip];
+            s.width = w;
+            s.height = h;
+            s.slicePitch = dds_surface_size(format, w, h, &s.rowPitch);
+            if (s.slicePitch > available - offset)
+            {
+                SDL_Log("dds_image: truncated at mip %u", mip);
+                return false;
+            }
+            s.pixels = pixels + offset;
+            offset += s.slicePitch;
+            w = SDL_max(w / 2, 1u);
+            h = SDL_max(h / 2, 1u);
+        }
+        return true;
+    }
+};
+
+struct dds_file
+{
+    dds_image image;
+    mapped_file file;
+
+    static Uint32 read_u32(const Uint8 *p)
+    {
+        return (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24);
+    }
+
+    // Legacy pixel format to DXGI_FORMAT, 0 when there is no exact match
+    static Uint32 legacy_format(const Uint8 *pf)
+    {
+        const Uint32 DDPF_ALPHAPIXELS = 0x1;
+        const Uint32 DDPF_FOURCC = 0x4;
+        const Uint32 DDPF_RGB = 0x40;
+        const Uint32 DDPF_LUMINANCE = 0x20000;
+
+        Uint32 flags = read_u32(pf + 4);
+        Uint32 fourCC = read_u32(pf + 8);
+        Uint32 bitCount = read_u32(pf + 12);
+        Uint32 r = read_u32(pf + 16);
+        Uint32 g = read_u32(pf + 20);
+        Uint32 b = read_u32(pf + 24);
+        Uint32 a = (flags & DDPF_ALPHAPIXELS) ? read_u32(pf + 28) : 0;
+
+        if (flags & DDPF_FOURCC)
+        {
+            switch (fourCC)
+            {
+            case dds_fourcc('D', 'X', 'T', '1'):
+                return DdsConstants::formatBC1Unorm;
+            case dds_fourcc('D', 'X', 'T', '2'):
+            case dds_fourcc('D', 'X', 'T', '3'):
+                return DdsConstants::formatBC2Unorm;
+            case dds_fourcc('D', 'X', 'T', '4'):
+            case dds_fourcc('D', 'X', 'T', '5'):
+                return DdsConstants::formatBC3Unorm;
+            case dds_fourcc('A', 'T', 'I', '1'):
+            case dds_fourcc('B', 'C', '4', 'U'):
+                return DdsConstants::formatBC4Unorm;
+            case dds_fourcc('B', 'C', '4', 'S'):
+                return DdsConstants::formatBC4Snorm;
+            case dds_fourcc('A', 'T', 'I', '2'):
+            case dds_fourcc('B', 'C', '5', 'U'):
+                return DdsConstants::formatBC5Unorm;
+            case dds_fourcc('B', 'C', '5', 'S'):
+                return DdsConstants::formatBC5Snorm;
+            case 36: // D3DFMT_A16B16G16R16
+                return DdsConstants::formatR16G16B16A16Unorm;
+            case 111: // D3DFMT_R16F
+                return DdsConstants::formatR16Float;
+            case 113: // D3DFMT_A16B16G16R16F
+                return DdsConstants::formatR16G16B16A16Float;
+            case 114: // D3DFMT_R32F
+                return DdsConstants::formatR32Float;
+            case 115: // D3DFMT_G32R32F
+                return DdsConstants::formatR32G32Float;
+            case 116: // D3DFMT_A32B32G32R32F
+                return DdsConstants::formatR32G32B32A32Float;
+            default:
+                return 0;
+            }
+        }
+        if (flags & DDPF_RGB)
+        {
+            if (bitCount == 32 && r == 0xff && g == 0xff00 && b == 0xff0000 && a == 0xff000000)
+                return DdsConstants::formatR8G8B8A8Unorm;
+            if (bitCount == 32 && r == 0xff0000 && g == 0xff00 && b == 0xff && a == 0xff000000)
+                return DdsConstants::formatB8G8R8A8Unorm;
+            if (bitCount == 32 && r == 0xff0000 && g == 0xff00 && b == 0xff && a == 0)
+                return DdsConstants::formatB8G8R8X8Unorm;
+            if (bitCount == 32 && r == 0xffff && g == 0xffff0000 && b == 0 && a == 0)
+                return DdsConstants::formatR16G16Unorm;
+            if (bitCount == 32 && r == 0xffffffff)
+                return DdsConstants::formatR32Float; // some writers store R32F as a 32 bit red mask
+            return 0;
+        }
+        if (flags & DDPF_LUMINANCE)
+        {
+            if (bitCount == 16 && r == 0xffff)
+                return DdsConstants::formatR16Unorm;
+            if (bitCount == 8 && r == 0xff)
+                return DdsConstants::formatR8Unorm;
+            if (bitCount == 16 && r == 0xff && a == 0xff00)
+                return DdsConstants::formatR8G8Unorm;
+        }
+        return 0;
+    }
+
+    // Parses a whole DDS file held in memory, surfaces point into it. 2D textures with one slice only.
+    bool parse(const void *fileData, size_t fileSize)
+    {
+        const Uint32 DDS_RESOURCE_DIMENSION_TEXTURE2D = 3;
+        const Uint32 DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+        const Uint32 DDSCAPS2_CUBEMAP = 0x200;
+        const Uint32 DDSCAPS2_VOLUME = 0x200000;
+
+        const Uint8 *bytes = (const Uint8 *)fileData;
+        if (fileSize < 4 + DdsConstants::headerSize || read_u32(bytes) != DdsConstants::magic)
+        {
+            SDL_Log("dds_file: not a DDS file");
+            return false;
+        }
+        const Uint8 *header = bytes + 4;
+        if (read_u32(header) != DdsConstants::headerSize || read_u32(header + 72) != 32)
+        {
+            SDL_Log("dds_file: bad header size");
+            return false;
+        }
+
+        image.height = read_u32(header + 8);
+        image.width = read_u32(header + 12);
+        image.mipLevels = SDL_max(read_u32(header + 24), 1u);
+        Uint32 caps2 = read_u32(header + 108);
+        size_t offset = 4 + DdsConstants::headerSize;
+
+        if ((read_u32(header + 76) & 0x4) && read_u32(header + 80) == dds_fourcc('D', 'X', '1', '0'))
+        {
+            if (fileSize < offset + DdsConstants::dx10HeaderSize)
+            {
+                SDL_Log("dds_file: truncated DX10 header");
+                return false;
+            }
+            const Uint8 *dx10 = bytes + offset;
+            image.format = read_u32(dx10);
+            Uint32 dimension = read_u32(dx10 + 4);
+            Uint32 miscFlag = read_u32(dx10 + 8);
+            Uint32 arraySize = read_u32(dx10 + 12);
+            if (dimension != DDS_RESOURCE_DIMENSION_TEXTURE2D || (miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) || arraySize != 1)
+            {
+                SDL_Log("dds_file: only single 2D textures are supported");
+                return false;
+            }
+            offset += DdsConstants::dx10HeaderSize;
+        }
+        else
+        {
+            if (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))
+            {
+                SDL_Log("dds_file: only single 2D textures are supported");
+                return false;
+            }
+            image.format = legacy_format(header + 72);
+        }
+
+        return image.layout(bytes + offset, fileSize - offset);
+    }
+
+    // Maps the file read only and parses it, the surfaces stay valid until close
+    bool open(const wchar_t *filename)
+    {
+        if (!file.open(filename))
+            return false;
+        if (!parse(file.data, file.size))
+        {
+            file.close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() { file.close(); }
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+// HEIGHT_CODEC_NO_SSE2 forces the scalar path, height_codec_test builds both
+#if !defined(HEIGHT_CODEC_NO_SSE2) && (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__))
+#include <emmintrin.h>
+#define HEIGHT_CODEC_SSE2 1
+#endif
+
+// Lossless (or bounded error) codec for bands of 16-bit height rows, written by pack_tiles.py.
+//
+// Every sample is predicted from its left, upper and upper-left neighbours as a + b - c, with
+// neighbours outside the band read as 0. The residuals are zig-zag mapped and bit-packed in blocks of
+// 128 with one bit width per block. Blocks use a vertical layout: value 8 * t + lane sits in 16-bit
+// lane `lane` of the block's words, at bit t * width of that lane's stream, so eight lanes unpack with
+// the same shifts. The gradient predictor (rather than MED) keeps decode vectorisable: x - b is a
+// running sum of the residuals along the row.
+//
+// Band layout: Uint16 quantStep, Uint8 width per block, then each block's width * 8 Uint16 words.
+// quantStep > 1 means samples were stored as round(h / quantStep) and decode to min(q * quantStep, 65535),
+// i.e. a max error of quantStep / 2.
+struct HeightCodecConstants
+{
+    static constexpr int blockSamples = 128;
+    static constexpr int lanes = 8;
+};
+
+static inline Uint16 height_codec_unzigzag(Uint16 z)
+{
+    return (Uint16)((z >> 1) ^ (Uint16)(0u - (z & 1u)));
+}
+
+// Unpacks one block of zig-zag residuals into out (128 values)
+static inline void height_codec_unpack_block(const Uint8 *words, int width, Uint16 *out)
+{
+    const int lanes = HeightCodecConstants::lanes;
+    const int steps = HeightCodecConstants::blockSamples / lanes;
+    if (width == 0)
+    {
+        SDL_memset(out, 0, HeightCodecConstants::blockSamples * sizeof(Uint16));
+        return;
+    }
+#ifdef HEIGHT_CODEC_SSE2
+    const __m128i mask = _mm_set1_epi16((short)(Uint16)((1u << width) - 1u));
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    for (int t = 0; t < steps; ++t)
+    {
+        int bit = t * width;
+        int k = bit >> 4;
+        int s = bit & 15;
+        __m128i v = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(words + k * 16)), _mm_cvtsi32_si128(s));
+        if (s + width > 16)
+            v = _mm_or_si128(v, _mm_sll_epi16(_mm_loadu_si128((const __m128i *)(words + (k + 1) * 16)), _mm_cvtsi32_si128(16 - s)));
+        v = _mm_and_si128(v, mask);
+        // un-zig-zag: (z >> 1) ^ -(z & 1)
+        v = _mm_xor_si128(_mm_srli_epi16(v, 1), _mm_sub_epi16(zero, _mm_and_si128(v, one)));
+        _mm_storeu_si128((__m128i *)(out + t * lanes), v);
+    }
+#else
+    const Uint32 mask = (1u << width) - 1u;
+    for (int t = 0; t < steps; ++t)
+    {
+        int bit = t * width;
+        int k = bit >> 4;
+        int s = bit & 15;
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            const Uint8 *w0 = words + (k * lanes + lane) * 2;
+            Uint32 v = (Uint32)(w0[0] | (w0[1] << 8)) >> s;
+            if (s + width > 16)
+            {
+                const Uint8 *w1 = words + ((k + 1) * lanes + lane) * 2;
+                v |= (Uint32)(w1[0] | (w1[1] << 8)) << (16 - s);
+            }
+            out[t * lanes + lane] = height_codec_unzigzag((Uint16)(v & mask));
+        }
+    }
+#endif
+}
+
+// Turns a row of residuals into heights in place, above is the reconstructed row before it (null for the first)
+static inline void height_codec_reconstruct_row(Uint16 *row, const Uint16 *above, int width)
+{
+    int x = 0;
+#ifdef HEIGHT_CODEC_SSE2
+    __m128i carry = _mm_setzero_si128(); // running sum of x - b, broadcast to every lane
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(row + x));
+        v = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+        v = _mm_add_epi16(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi16(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi16(v, carry);
+        carry = _mm_shufflehi_epi16(v, 0xFF);
+        carry = _mm_unpackhi_epi64(carry, carry);
+        if (above)
+            v = _mm_add_epi16(v, _mm_loadu_si128((const __m128i *)(above + x)));
+        _mm_storeu_si128((__m128i *)(row + x), v);
+    }
+    Uint16 d = (Uint16)_mm_extract_epi16(carry, 0);
+#else
+    Uint16 d = 0;
+#endif
+    for (; x < width; ++x)
+    {
+        d = (Uint16)(d + row[x]);
+        row[x] = (Uint16)(d + (above ? above[x] : 0));
+    }
+}
+
+// Decodes a band of rows x width samples into dst, false when src is corrupt
+static bool height_codec_decode_band(const Uint8 *src, size_t srcSize, Uint16 *dst, int width, int rows)
+{
+    const int blockSamples = HeightCodecConstants::blockSamples;
+    size_t samples = (size_t)width * rows;
+    size_t blockCount = (samples + blockSamples - 1) / blockSamples;
+    if (srcSize < 2 + blockCount)
+        return false;
+
+    Uint16 quantStep = (Uint16)(src[0] | (src[1] << 8));
+    const Uint8 *widths = src + 2;
+    const Uint8 *words = widths + blockCount;
+    const Uint8 *end = src + srcSize;
+
+    for (size_t b = 0; b < blockCount; ++b)
+    {
+        int width16 = widths[b];
+        size_t blockBytes = (size_t)width16 * HeightCodecConstants::lanes * 2;
+        if (width16 > 16 || blockBytes > (size_t)(end - words))
+            return false;
+        size_t first = b * blockSamples;
+        if (first + blockSamples <= samples)
+        {
+            height_codec_unpack_block(words, width16, dst + first);
+        }
+        else
+        {
+            Uint16 tail[HeightCodecConstants::blockSamples];
+            height_codec_unpack_block(words, width16, tail);
+            SDL_memcpy(dst + first, tail, (samples - first) * sizeof(Uint16));
+        }
+        words += blockBytes;
+    }
+
+    for (int y = 0; y < rows; ++y)
+        height_codec_reconstruct_row(dst + (size_t)y * width, y > 0 ? dst + (size_t)(y - 1) * width : nullptr, width);
+
+    if (quantStep > 1)
+    {
+        for (size_t i = 0; i < samples; ++i)
+            dst[i] = (Uint16)SDL_min((Uint32)dst[i] * quantStep, 65535u);
+    }
+    return true;
+}
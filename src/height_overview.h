@@ -0,0 +1,109 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include "mapped_file.h"
+#include "world_manifest.h"
+
+// Low resolution copy of every height tile in the world, cut by pack_tiles.py --overview into its own file:
+// a header, then per tile in manifest order an R16_UNORM mip chain of tileDim x tileDim texels down to 1x1.
+// Texels are point sampled from the source tiles the same way the height pyramid decimates them, so a ring
+// reading the overview sees the heights it would have read from the streamed tiles. The whole thing is read
+// into memory once and stays there, the far rings cover the horizon without streaming anything.
+struct HeightOverviewConstants
+{
+    static constexpr Uint32 magic = 0x564F5648; // "HVOV"
+    static constexpr Uint32 version = 1;
+    static constexpr int maxMips = 16;
+};
+
+struct height_overview_header
+{
+    Uint32 magic;
+    Uint32 version;
+    Uint32 tileCount; // the manifest's
+    Uint32 tileDim;   // overview texels per tile side at mip 0, a power of two
+    Uint32 mipCount;  // down to 1x1
+    Uint32 sourceDim; // texels per side of the height tiles it was cut from
+    Uint64 manifestHash; // world_manifest::keysHash of the archive it was cut for
+};
+
+static_assert(sizeof(height_overview_header) == 32, "height_overview_header must match pack_tiles.py");
+
+struct height_overview
+{
+    Uint16 *texels = nullptr; // every tile's chain, manifest order
+    const world_manifest *manifest = nullptr;
+    Uint32 tileDim = 0;
+    Uint32 mipCount = 0;
+    Uint32 sourceDim = 0;
+    size_t tileTexels = 0; // one tile's chain
+    size_t mipOffsets[HeightOverviewConstants::maxMips];
+
+    bool open(const wchar_t *filename, const world_manifest &_manifest)
+    {
+        release();
+        mapped_file file;
+        if (!file.open(filename))
+            return false;
+
+        const height_overview_header *header = (const height_overview_header *)file.data;
+        if (file.size < sizeof(height_overview_header) || header->magic != HeightOverviewConstants::magic ||
+            header->version != HeightOverviewConstants::version)
+        {
+            SDL_Log("height_overview: %ls is not a version %u overview", filename, HeightOverviewConstants::version);
+            return false;
+        }
+        if (header->tileCount != _manifest.tileCount || header->manifestHash != _manifest.keysHash)
+        {
+            SDL_Log("height_overview: %ls was cut for another tile archive, run pack_tiles.py --overview again", filename);
+            return false;
+        }
+        if (header->tileDim == 0 || (header->tileDim & (header->tileDim - 1)) != 0 || header->sourceDim < header->tileDim ||
+            header->mipCount == 0 || header->mipCount > (Uint32)HeightOverviewConstants::maxMips || (header->tileDim >> (header->mipCount - 1)) != 1)
+        {
+            SDL_Log("height_overview: unsupported layout (%u texel tiles, %u mips)", header->tileDim, header->mipCount);
+            return false;
+        }
+
+        tileTexels = 0;
+        for (Uint32 mip = 0; mip < header->mipCount; ++mip)
+        {
+            mipOffsets[mip] = tileTexels;
+            size_t dim = header->tileDim >> mip;
+            tileTexels += dim * dim;
+        }
+        size_t bytes = tileTexels * header->tileCount * sizeof(Uint16);
+        if (file.size - sizeof(height_overview_header) < bytes)
+        {
+            SDL_Log("height_overview: %ls is truncated", filename);
+            return false;
+        }
+        texels = (Uint16 *)SDL_malloc(SDL_max(bytes, sizeof(Uint16)));
+        if (!texels)
+            return false;
+        SDL_memcpy(texels, file.data + sizeof(height_overview_header), bytes);
+        manifest = &_manifest;
+        tileDim = header->tileDim;
+        mipCount = header->mipCount;
+        sourceDim = header->sourceDim;
+        return true;
+    }
+
+    void release()
+    {
+        SDL_free(texels);
+        texels = nullptr;
+        manifest = nullptr;
+        tileDim = mipCount = sourceDim = 0;
+    }
+
+    size_t resident_bytes() const { return manifest ? tileTexels * manifest->tileCount * sizeof(Uint16) : 0; }
+
+    // (tileDim >> mip)^2 texels of one tile, null for tiles the world doesn't have
+    const Uint16 *find(int tileX, int tileY, Uint32 mip) const
+    {
+        int tile = texels && mip < mipCount ? manifest->find(tileX, tileY) : -1;
+        return tile >= 0 ? texels + (size_t)tile * tileTexels + mipOffsets[mip] : nullptr;
+    }
+};
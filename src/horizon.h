@@ -0,0 +1,19 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+// The terrain shader bends everything down by d^2 / (2 * planetRadius) around the eye. Against that
+// parabola, a ray from eye height h grazes the zero height surface at sqrt(2Rh), and a point of height H
+// stays visible for another sqrt(2RH) beyond it. Heights are measured from the lowest possible surface.
+static inline float horizon_distance(float eyeHeight, float maxHeight, float planetRadius)
+{
+    return SDL_sqrtf(2.0f * planetRadius * SDL_max(eyeHeight, 0.0f)) +
+           SDL_sqrtf(2.0f * planetRadius * SDL_max(maxHeight, 0.0f));
+}
+
+// True when nothing of a region whose closest point is sqrt(nearestDist2) away can rise above the horizon
+static inline bool below_horizon(float eyeHeight, float regionMaxHeight, float nearestDist2, float planetRadius)
+{
+    float d = horizon_distance(eyeHeight, regionMaxHeight, planetRadius);
+    return nearestDist2 > d * d;
+}
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Work-stealing job system. Every worker (and the thread that calls init, usually the main thread)
+// owns a lock-free deque it pushes and pops at the bottom while idle workers steal from the top.
+// Other threads submit through a small shared injection queue. Idle workers park on a condition
+// variable and are woken one at a time, only when someone is actually asleep.
+
+struct job_group
+{
+    std::atomic<int> pending{0};
+};
+
+struct job
+{
+    void (*function)(void *data);
+    void *data;
+    job_group *group; // may be null
+};
+
+// Chase-Lev deque with a fixed ring (Le, Pop, Cohen, Nardelli 2013). Slots are relaxed atomics so a
+// thief can read a slot the owner is about to reuse, it just loses the CAS on top afterwards.
+struct job_deque
+{
+    static constexpr Sint64 capacity = 4096; // power of two
+    static constexpr Sint64 mask = capacity - 1;
+
+    struct slot
+    {
+        std::atomic<void (*)(void *)> function;
+        std::atomic<void *> data;
+        std::atomic<job_group *> group;
+    };
+
+    slot slots[capacity];
+    std::atomic<Sint64> top{0};
+    char padding[64]; // keeps thieves on top off the owner's cache line
+    std::atomic<Sint64> bottom{0};
+
+    // owner only, false when full
+    bool push(const job &j)
+    {
+        Sint64 b = bottom.load(std::memory_order_relaxed);
+        Sint64 t = top.load(std::memory_order_acquire);
+        if (b - t >= capacity)
+            return false;
+        slot &s = slots[b & mask];
+        s.function.store(j.function, std::memory_order_relaxed);
+        s.data.store(j.data, std::memory_order_relaxed);
+        s.group.store(j.group, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release); // pairs with the acquire load of bottom in steal
+        return true;
+    }
+
+    // owner only, newest job first
+    bool pop(job &out)
+    {
+        Sint64 b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        Sint64 t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        read(b, out);
+        if (t == b)
+        {
+            // last job, race any thief for it
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // any thread, oldest job first
+    bool steal(job &out)
+    {
+        Sint64 t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        Sint64 b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+        read(t, out);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    bool empty() const
+    {
+        return bottom.load(std::memory_order_acquire) <= top.load(std::memory_order_acquire);
+    }
+
+    void read(Sint64 index, job &out) const
+    {
+        const slot &s = slots[index & mask];
+        out.function = s.function.load(std::memory_order_relaxed);
+        out.data = s.data.load(std::memory_order_relaxed);
+        out.group = s.group.load(std::memory_order_relaxed);
+    }
+};
+
+static thread_local int jobWorkerIndex = -1; // deque owned by this thread, -1 for outside threads
+
+struct job_system
+{
+    static constexpr int maxThreads = 64;
+
+    job_deque *deques = nullptr; // [0] belongs to the thread that called init
+    int dequeCount = 0;
+    std::vector<std::thread> workers;
+
+    std::mutex injectionMutex;
+    std::deque<job> injection;
+    std::atomic<int> injectionCount{0};
+
+    std::mutex parkMutex;
+    std::condition_variable parkCv;
+    std::atomic<int> sleepers{0};
+    std::atomic<int> spinning{0}; // workers searching for a job before they park
+    static constexpr int spinAttempts = 64;
+    std::atomic<Uint32> wakeEpoch{0};
+    std::atomic<bool> stopping{false};
+
+    bool init(int workerCount)
+    {
+        workerCount = SDL_clamp(workerCount, 1, maxThreads - 1);
+        dequeCount = workerCount + 1;
+        deques = new (std::nothrow) job_deque[dequeCount];
+        if (!deques)
+            return false;
+
+        jobWorkerIndex = 0;
+        workers.reserve(workerCount);
+        for (int i = 1; i <= workerCount; ++i)
+            workers.emplace_back([this, i]() { worker_main(i); });
+        return true;
+    }
+
+    void shutdown()
+    {
+        stopping.store(true);
+        {
+            std::lock_guard<std::mutex> lk(parkMutex);
+            wakeEpoch.fetch_add(1);
+        }
+        parkCv.notify_all();
+        for (auto &t : workers)
+        {
+            if (t.joinable())
+                t.join();
+        }
+        workers.clear();
+        delete[] deques;
+        deques = nullptr;
+    }
+
+    void submit(void (*function)(void *), void *data, job_group *group = nullptr)
+    {
+        if (group)
+            group->pending.fetch_add(1, std::memory_order_relaxed);
+        job j = {function, data, group};
+        int index = jobWorkerIndex;
+        if (index < 0 || index >= dequeCount || !deques[index].push(j))
+        {
+            std::lock_guard<std::mutex> lk(injectionMutex);
+            injection.push_back(j);
+            injectionCount.fetch_add(1, std::memory_order_release);
+        }
+        wake_one();
+    }
+
+    // Helps with any queued job until every job of the group has finished
+    void wait(job_group &group)
+    {
+        int index = jobWorkerIndex;
+        while (group.pending.load(std::memory_order_acquire) > 0)
+        {
+            job j;
+            if (find_job(index, j))
+                execute(j);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    // body(begin, end) over [0, count) in chunks of grain, returns once every chunk ran
+    template <typename F>
+    void parallel_for(int count, int grain, const F &body)
+    {
+        struct range
+        {
+            const F *body;
+            int begin;
+            int end;
+
+            static void run(void *data)
+            {
+                range *r = (range *)data;
+                (*r->body)(r->begin, r->end);
+            }
+        };
+
+        grain = SDL_max(grain, 1);
+        int chunkCount = (count + grain - 1) / grain;
+        std::vector<range> ranges((size_t)chunkCount);
+        job_group group;
+        for (int c = 0; c < chunkCount; ++c)
+        {
+            ranges[c].body = &body;
+            ranges[c].begin = c * grain;
+            ranges[c].end = SDL_min(count, (c + 1) * grain);
+            submit(&range::run, &ranges[c], &group);
+        }
+        wait(group);
+    }
+
+    void execute(const job &j)
+    {
+        j.function(j.data);
+        if (j.group)
+            j.group->pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    bool find_job(int index, job &out)
+    {
+        if (index >= 0 && index < dequeCount && deques[index].pop(out))
+            return true;
+
+        if (injectionCount.load(std::memory_order_acquire) > 0)
+        {
+            std::lock_guard<std::mutex> lk(injectionMutex);
+            if (!injection.empty())
+            {
+                out = injection.front();
+                injection.pop_front();
+                injectionCount.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        // steal, starting after our own deque so thieves spread out
+        int start = (index >= 0) ? index + 1 : 0;
+        for (int n = 0; n < dequeCount; ++n)
+        {
+            int victim = (start + n) % dequeCount;
+            if (victim != index && deques[victim].steal(out))
+                return true;
+        }
+        return false;
+    }
+
+    bool has_work() const
+    {
+        if (injectionCount.load(std::memory_order_acquire) > 0)
+            return true;
+        for (int i = 0; i < dequeCount; ++i)
+        {
+            if (!deques[i].empty())
+                return true;
+        }
+        return false;
+    }
+
+    void wake_one()
+    {
+        // pairs with the counter updates in worker_main and park, one of the two always sees the other
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (spinning.load(std::memory_order_seq_cst) > 0 || sleepers.load(std::memory_order_seq_cst) == 0)
+            return; // a searching worker will pick the job up, it wakes the next one itself
+        {
+            std::lock_guard<std::mutex> lk(parkMutex);
+            wakeEpoch.fetch_add(1, std::memory_order_relaxed);
+        }
+        parkCv.notify_one();
+    }
+
+    void park()
+    {
+        Uint32 epoch = wakeEpoch.load(std::memory_order_acquire);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        if (!has_work() && !stopping.load())
+        {
+            std::unique_lock<std::mutex> lk(parkMutex);
+            parkCv.wait(lk, [&] { return stopping.load() || wakeEpoch.load(std::memory_order_relaxed) != epoch; });
+        }
+        sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void worker_main(int index)
+    {
+        jobWorkerIndex = index;
+        while (true)
+        {
+            job j;
+            if (find_job(index, j))
+            {
+                execute(j);
+                continue;
+            }
+            if (stopping.load())
+                return;
+
+            // search a little longer before parking, so bursts of tiny jobs don't pay for a wake-up each
+            bool found = false;
+            spinning.fetch_add(1, std::memory_order_seq_cst);
+            for (int attempt = 0; attempt < spinAttempts && !found; ++attempt)
+            {
+                std::this_thread::yield();
+                found = find_job(index, j);
+            }
+            spinning.fetch_sub(1, std::memory_order_seq_cst);
+            if (found)
+            {
+                // hand the search over before running, more work may have arrived while nobody was woken
+                if (has_work())
+                    wake_one();
+                execute(j);
+                continue;
+            }
+            park();
+        }
+    }
+};
+
+static job_system jobSystem;
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+// Decoder for the LZ4 block format (no frame header), as written by lz4.block.compress(store_size=False)
+// in pack_tiles.py. Every read and write is bounds checked, a corrupt block fails instead of overrunning.
+// Returns the number of bytes written to dst, or -1.
+static int lz4_decompress_block(const Uint8 *src, size_t srcSize, Uint8 *dst, size_t dstCapacity)
+{
+    const Uint8 *ip = src;
+    const Uint8 *const ipEnd = src + srcSize;
+    Uint8 *op = dst;
+    Uint8 *const opEnd = dst + dstCapacity;
+
+    while (ip < ipEnd)
+    {
+        // token: literal length in the high nibble, match length - 4 in the low nibble
+        Uint32 token = *ip++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15)
+        {
+            Uint8 extra;
+            do
+            {
+                if (ip >= ipEnd)
+                    return -1;
+                extra = *ip++;
+                literalLength += extra;
+            } while (extra == 255);
+        }
+        if (literalLength > (size_t)(ipEnd - ip) || literalLength > (size_t)(opEnd - op))
+            return -1;
+        SDL_memcpy(op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == ipEnd)
+            break; // the last sequence is literals only
+
+        if (ipEnd - ip < 2)
+            return -1;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst))
+            return -1;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15)
+        {
+            Uint8 extra;
+            do
+            {
+                if (ip >= ipEnd)
+                    return -1;
+                extra = *ip++;
+                matchLength += extra;
+            } while (extra == 255);
+        }
+        matchLength += 4;
+        if (matchLength > (size_t)(opEnd - op))
+            return -1;
+
+        // matches may overlap their own output, copy 8 bytes at a time only when they can't
+        const Uint8 *match = op - offset;
+        if (offset >= 8)
+        {
+            size_t i = 0;
+            for (; i + 8 <= matchLength; i += 8)
+                SDL_memcpy(op + i, match + i, 8);
+            for (; i < matchLength; ++i)
+                op[i] = match[i];
+        }
+        else
+        {
+            for (size_t i = 0; i < matchLength; ++i)
+                op[i] = match[i];
+        }
+        op += matchLength;
+    }
+    return (int)(op - dst);
+}
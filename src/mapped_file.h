@@ -0,0 +1,102 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read only view of a whole file, valid until close
+struct mapped_file
+{
+    const Uint8 *data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+    bool open(const wchar_t *filename)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            SDL_Log("mapped_file: failed to open %ls", filename);
+            return false;
+        }
+        LARGE_INTEGER fileSize = {};
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            SDL_Log("mapped_file: failed to size %ls", filename);
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        data = mapping ? (const Uint8 *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!data)
+        {
+            SDL_Log("mapped_file: failed to map %ls", filename);
+            close();
+            return false;
+        }
+        size = (size_t)fileSize.QuadPart;
+#else
+        char *path = SDL_iconv_wchar_utf8(filename);
+        fd = path ? ::open(path, O_RDONLY) : -1;
+        SDL_free(path);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            SDL_Log("mapped_file: failed to open %ls", filename);
+            close();
+            return false;
+        }
+        void *view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED)
+        {
+            SDL_Log("mapped_file: failed to map %ls", filename);
+            close();
+            return false;
+        }
+        data = (const Uint8 *)view;
+        size = (size_t)st.st_size;
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data)
+            munmap((void *)data, size);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    ~mapped_file() { close(); }
+};
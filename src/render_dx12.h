@@ -18,6 +18,13 @@
 #pragma warning(pop)
 
 #include "error.h"
+#include "clipmap_heights.h"
+#include "dds_file.h"
+#include "upload_ring.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 struct dxc_context
 {
@@ -53,16 +60,23 @@ static struct
     DirectX::XMFLOAT4X4 projection;
 
     DirectX::XMVECTOR cameraPos;
-    DirectX::XMFLOAT2 ringOffset;
     double timeElapsed;
     float ringWorldSize;
-    float ringSampleStep;
     float planetScaleRatio = 1.0f / 75.0f;
     int terrainGridDimensionInVertices;
     float debug_scaler = 1.0f;
 
     unsigned int tileCount;
     unsigned int visibleTileWidth;
+
+    // clipmap height pyramid, rings from heightPyramidFirstRing on read it instead of the tiles
+    int terrainWindowOriginX; // world position of the streamed window, pyramid texels are absolute
+    int terrainWindowOriginZ;
+    unsigned int heightPyramidSRV;
+    unsigned int heightPyramidFirstRing;
+
+    // per clipmap ring: xy = world origin, z = sample step, w = ring index. 16-byte aligned like HLSL arrays
+    DirectX::XMFLOAT4A clipmapRings[ClipmapConstants::maxRings];
 } constantBufferData;
 
 struct vertex
@@ -78,11 +92,7 @@ struct vertex_optimised
     uint16_t y;
 };
 
-// TODO ultra optimised heightmap for grids that are set to 129x129 vertices?
-//  struct vertex_ultra_optimised_heightmap {
-//      uint8_t x;
-//      uint8_t y;
-//  };
+// grids up to 256x256 vertices use 8-bit coordinates, see clipmap_grid_template
 
 // Simple free list based allocator
 struct ImGuiDescriptorHeapAllocator
@@ -166,7 +176,7 @@ struct d3d12_index_buffer
 {
     D3D12_INDEX_BUFFER_VIEW indexBufferView = {};
     ID3D12Resource *indexBuffer = nullptr;
-    bool create_and_upload(size_t indexBufferSize, void *indexBufferData)
+    bool create_and_upload(size_t indexBufferSize, void *indexBufferData, DXGI_FORMAT format = DXGI_FORMAT_R32_UINT)
     {
         CD3DX12_HEAP_PROPERTIES heapPropsUpload(D3D12_HEAP_TYPE_UPLOAD);
         CD3DX12_RESOURCE_DESC indexBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize);
@@ -192,7 +202,7 @@ struct d3d12_index_buffer
 
         indexBufferView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
         indexBufferView.SizeInBytes = (UINT)indexBufferSize;
-        indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+        indexBufferView.Format = format;
         return true;
     }
 };
@@ -201,6 +211,7 @@ struct d3d12_vertex_buffer
 {
     D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
     ID3D12Resource *vertexBuffer = nullptr;
+    void *mappedData = nullptr; // only for dynamic buffers
 
     // stride == size of 1 vertex
     bool create_and_upload(size_t vertexBufferSize, void *terrainPoints, UINT stride)
@@ -235,6 +246,36 @@ struct d3d12_vertex_buffer
         vertexBufferView.SizeInBytes = vertexBufferSize;
         return true;
     }
+
+    // stays mapped, for per-instance data that is rewritten every frame
+    bool create_dynamic(size_t vertexBufferSize, UINT stride)
+    {
+        CD3DX12_HEAP_PROPERTIES heapPropsUpload(D3D12_HEAP_TYPE_UPLOAD);
+        CD3DX12_RESOURCE_DESC vertexBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize);
+        HRESULT hr = renderState.device->CreateCommittedResource(
+            &heapPropsUpload,
+            D3D12_HEAP_FLAG_NONE,
+            &vertexBufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr, IID_PPV_ARGS(&vertexBuffer));
+        if (FAILED(hr))
+        {
+            errhr("CreateCommittedResource failed (dynamic vertex buffer)", hr);
+            return false;
+        }
+        CD3DX12_RANGE readRange(0, 0);
+        hr = vertexBuffer->Map(0, &readRange, &mappedData);
+        if (FAILED(hr))
+        {
+            errhr("Map failed (dynamic vertex buffer)", hr);
+            return false;
+        }
+
+        vertexBufferView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
+        vertexBufferView.StrideInBytes = stride;
+        vertexBufferView.SizeInBytes = (UINT)vertexBufferSize;
+        return true;
+    }
 };
 
 struct d3d12_texture_2d
@@ -386,6 +427,291 @@ struct d3d12_texture_2d
     }
 };
 
+struct d3d12_upload_buffer
+{
+    ID3D12Resource *buffer = nullptr;
+    void *mappedData = nullptr;
+    UINT64 size = 0;
+
+    bool create(UINT64 _size)
+    {
+        size = _size;
+        CD3DX12_HEAP_PROPERTIES heapPropsUpload(D3D12_HEAP_TYPE_UPLOAD);
+        CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+        HRESULT hr = renderState.device->CreateCommittedResource(
+            &heapPropsUpload,
+            D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&buffer));
+        if (FAILED(hr))
+        {
+            errhr("CreateCommittedResource failed (upload buffer)", hr);
+            return false;
+        }
+        CD3DX12_RANGE readRange(0, 0);
+        hr = buffer->Map(0, &readRange, &mappedData);
+        if (FAILED(hr))
+        {
+            errhr("Map failed (upload buffer)", hr);
+            return false;
+        }
+        return true;
+    }
+};
+
+struct StreamUploadConstants
+{
+    static constexpr UINT64 ringBytes = 64ull << 20; // upload memory shared by every batch in flight, at least
+    static constexpr int batchCount = 4;              // one recording while the rest are on the copy queue
+};
+
+// Streamed tile uploads on their own copy queue. Workers stage mips in a persistent upload ring and record the
+// copies into the open batch, the main thread submits that batch once a frame. An upload is done once the
+// copy fence reaches the value upload returned, until then nothing may sample what it wrote.
+// Mips are staged one at a time, so a chain bigger than the ring goes out over several batches. Ring space
+// and the copy are recorded under the mutex, the fence waits and the memcpy happen outside it.
+// Textures it writes rest in COMMON: the copy queue promotes them to COPY_DEST, draws to shader resource.
+struct d3d12_stream_uploader
+{
+    struct batch
+    {
+        ID3D12CommandAllocator *allocator;
+        ID3D12GraphicsCommandList *list;
+        UINT64 fenceValue; // the batch's copies are done once the fence gets here
+        UINT copies;
+        int writers; // copies recorded whose source memcpy hasn't finished, it can't be submitted yet
+        bool live;   // writes a texture frames may be sampling, the direct queue waits for it
+    };
+
+    ID3D12CommandQueue *queue = nullptr;
+    ID3D12Fence *fence = nullptr;
+    d3d12_upload_buffer ring;
+    upload_ring_allocator ringAllocator = {};
+    batch batches[StreamUploadConstants::batchCount] = {};
+    int current = 0; // open batch, workers record into it under mutex
+    UINT64 nextFenceValue = 1;
+    UINT64 liveFenceValue = 0; // last submitted batch that wrote a live texture
+    UINT64 liveFenceWaited = 0;
+    std::mutex mutex;
+    std::condition_variable submitted;   // flush closed the open batch
+    std::condition_variable writersDone; // the open batch's last memcpy finished
+    bool flushing = false;               // flush is waiting for writersDone
+    std::atomic<int> submitWaiters{0};   // workers out of ring space until the open batch is submitted
+
+    // stats since startup
+    std::atomic<UINT64> bytesStaged{0};
+    std::atomic<Uint32> copiesRecorded{0};
+    Uint32 batchesSubmitted = 0;
+    std::atomic<UINT64> ringUsed{0}; // after the latest allocation or submission
+
+    static Uint64 fence_completed(void *context) { return ((ID3D12Fence *)context)->GetCompletedValue(); }
+    static void fence_wait(void *context, Uint64 value) { ((ID3D12Fence *)context)->SetEventOnCompletion(value, nullptr); } // no event blocks
+
+    // largestMipBytes: the biggest single mip that will be streamed, the ring holds two of them
+    bool create(UINT64 largestMipBytes)
+    {
+        UINT64 ringBytes = SDL_max(StreamUploadConstants::ringBytes, 2 * largestMipBytes);
+        ringBytes = (ringBytes + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~(UINT64)(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+
+        D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+        queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+        HRESULT hr = renderState.device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&queue));
+        if (FAILED(hr))
+        {
+            errhr("CreateCommandQueue (stream uploads) failed", hr);
+            return false;
+        }
+        hr = renderState.device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence));
+        if (FAILED(hr))
+        {
+            errhr("CreateFence (stream uploads) failed", hr);
+            return false;
+        }
+        if (!ring.create(ringBytes))
+            return false;
+        ringAllocator.init(ringBytes, {fence_completed, fence_wait, fence});
+
+        for (int i = 0; i < StreamUploadConstants::batchCount; ++i)
+        {
+            batch &b = batches[i];
+            hr = renderState.device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&b.allocator));
+            if (FAILED(hr))
+            {
+                errhr("CreateCommandAllocator (stream uploads) failed", hr);
+                return false;
+            }
+            hr = renderState.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, b.allocator, nullptr, IID_PPV_ARGS(&b.list));
+            if (FAILED(hr))
+            {
+                errhr("CreateCommandList (stream uploads) failed", hr);
+                return false;
+            }
+            if (i != current)
+                b.list->Close(); // reset when its turn comes
+        }
+        batches[current].fenceValue = nextFenceValue++; // known up front, uploads hand it out
+        return true;
+    }
+
+    UINT64 capacity() const { return ringAllocator.capacity; }
+
+    // stages mips [firstMip, firstMip + count) of texture and records their copies. live uploads write a
+    // texture frames may be sampling. Returns the fence value the copies are done at, 0 on failure.
+    UINT64 upload(ID3D12Resource *texture, UINT firstMip, UINT count, const D3D12_SUBRESOURCE_DATA *subresources, bool live)
+    {
+        D3D12_RESOURCE_DESC desc = texture->GetDesc();
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT layouts[DdsConstants::maxMips];
+        UINT rows[DdsConstants::maxMips];
+        UINT64 rowBytes[DdsConstants::maxMips];
+        UINT64 totalBytes = 0;
+        renderState.device->GetCopyableFootprints(&desc, firstMip, count, 0, layouts, rows, rowBytes, &totalBytes);
+
+        // batches go out in order, the one holding the last mip finishes after every earlier one
+        UINT64 fenceValue = 0;
+        for (UINT i = 0; i < count; ++i)
+        {
+            UINT64 mipEnd = i + 1 < count ? layouts[i + 1].Offset : totalBytes;
+            UINT64 mipBytes = mipEnd - layouts[i].Offset;
+            D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout = layouts[i];
+
+            std::unique_lock<std::mutex> lk(mutex);
+            batch *b = nullptr;
+            for (;;)
+            {
+                submitted.wait(lk, [&]
+                               { return !flushing; }); // the open batch is waiting on its writers, don't join it
+                UINT64 offset = 0;
+                UINT64 waitValue = 0;
+                upload_ring_status status = ringAllocator.try_allocate(mipBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, offset, waitValue);
+                if (status == UPLOAD_RING_OK)
+                {
+                    layout.Offset = offset;
+                    b = &batches[current];
+                    break;
+                }
+                if (status == UPLOAD_RING_TOO_BIG)
+                {
+                    SDL_Log("stream uploader: a %llu byte mip doesn't fit the upload ring", (unsigned long long)mipBytes);
+                    return 0;
+                }
+                if (status == UPLOAD_RING_WAIT)
+                {
+                    lk.unlock();
+                    fence_wait(fence, waitValue);
+                    lk.lock();
+                }
+                else
+                {
+                    // the open batch holds the space, the main thread submits it next frame
+                    Uint32 before = batchesSubmitted;
+                    submitWaiters.fetch_add(1, std::memory_order_release);
+                    submitted.wait(lk, [&]
+                                   { return batchesSubmitted != before; });
+                    submitWaiters.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            // the copy reads the ring only once the batch executes, flush holds the batch until the memcpy is done
+            CD3DX12_TEXTURE_COPY_LOCATION dst(texture, firstMip + i);
+            CD3DX12_TEXTURE_COPY_LOCATION src(ring.buffer, layout);
+            b->list->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+            b->copies++;
+            b->writers++;
+            b->live |= live;
+            fenceValue = b->fenceValue;
+            ringUsed.store(ringAllocator.used(), std::memory_order_relaxed);
+            lk.unlock();
+
+            D3D12_MEMCPY_DEST dest = {(byte *)ring.mappedData + layout.Offset, layout.Footprint.RowPitch, (SIZE_T)layout.Footprint.RowPitch * rows[i]};
+            MemcpySubresource(&dest, &subresources[i], (SIZE_T)rowBytes[i], rows[i], layout.Footprint.Depth);
+            bytesStaged.fetch_add(mipBytes, std::memory_order_relaxed);
+            copiesRecorded.fetch_add(1, std::memory_order_relaxed);
+
+            lk.lock();
+            if (--b->writers == 0)
+                writersDone.notify_all();
+        }
+        return fenceValue;
+    }
+
+    // main thread, once a frame after its submission signalled frameFenceValue on frameFence. The batch waits
+    // for that frame, so its copies never overlap a frame recorded before them.
+    bool flush(ID3D12Fence *frameFence, UINT64 frameFenceValue)
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        batch &b = batches[current];
+        if (b.copies == 0)
+            return true;
+        flushing = true;
+        writersDone.wait(lk, [&]
+                         { return b.writers == 0; }); // copies in flight are a memcpy away from done
+        flushing = false;
+
+        HRESULT hr = b.list->Close();
+        if (FAILED(hr))
+        {
+            errhr("Close (stream uploads) failed", hr);
+            return false;
+        }
+        queue->Wait(frameFence, frameFenceValue);
+        ID3D12CommandList *lists[] = {b.list};
+        queue->ExecuteCommandLists(1, lists);
+        queue->Signal(fence, b.fenceValue);
+        ringAllocator.close(b.fenceValue);
+        ringAllocator.retire();
+        ringUsed.store(ringAllocator.used(), std::memory_order_relaxed);
+        if (b.live)
+            liveFenceValue = b.fenceValue;
+        batchesSubmitted++;
+        submitted.notify_all();
+
+        // the next batch in the pool was submitted batchCount flushes ago, it has usually long retired
+        current = (current + 1) % StreamUploadConstants::batchCount;
+        batch &next = batches[current];
+        if (fence->GetCompletedValue() < next.fenceValue)
+            fence_wait(fence, next.fenceValue);
+        hr = next.allocator->Reset();
+        if (SUCCEEDED(hr))
+            hr = next.list->Reset(next.allocator, nullptr);
+        if (FAILED(hr))
+        {
+            errhr("Reset (stream uploads) failed", hr);
+            return false;
+        }
+        next.fenceValue = nextFenceValue++;
+        next.copies = 0;
+        next.writers = 0;
+        next.live = false;
+        return true;
+    }
+
+    // main thread: a worker is blocked until the open batch goes out. Only flush submits it, so a main thread
+    // that waits on those workers has to flush while it does.
+    bool submit_wanted() const { return submitWaiters.load(std::memory_order_acquire) > 0; }
+
+    // main thread, before submitting a frame: it must not sample a texture a live batch is still writing
+    void wait_live(ID3D12CommandQueue *directQueue)
+    {
+        if (liveFenceValue > liveFenceWaited)
+        {
+            directQueue->Wait(fence, liveFenceValue);
+            liveFenceWaited = liveFenceValue;
+        }
+    }
+
+    UINT64 completed() const { return fence->GetCompletedValue(); }
+
+    // main thread, blocks until the batch that took fenceValue has executed, it must have been flushed
+    void wait(UINT64 fenceValue)
+    {
+        if (fence->GetCompletedValue() < fenceValue)
+            fence_wait(fence, fenceValue);
+    }
+};
+
+static d3d12_stream_uploader streamUploader;
+
 struct d3d12_bindless_texture
 {
     ID3D12Resource *texture;
@@ -396,31 +722,32 @@ struct d3d12_bindless_texture
     UINT width;
     UINT height;
 
-    bool loadFromDDS(const wchar_t *filename, UINT srvIndex, bool useMips)
+    // cpuMips (optional) receives a decimated CPU copy of a height tile for the clipmap height pyramid
+    bool loadFromDDS(const wchar_t *filename, UINT srvIndex, bool useMips, height_tile_mips *cpuMips = nullptr)
+    {
+        dds_file file;
+        if (!file.open(filename))
+        {
+            err("dds_file open failed");
+            return false;
+        }
+        return load(file.image, srvIndex, useMips, cpuMips);
+    }
+
+    // image is usually a view into a mapped file or tile archive
+    bool load(const dds_image &dds, UINT srvIndex, bool useMips, height_tile_mips *cpuMips = nullptr)
     {
         texture = nullptr;
         uploadHeap = nullptr;
         descriptorIndex = srvIndex;
 
-        DirectX::ScratchImage image;
-        DirectX::TexMetadata metadata;
-
-        HRESULT hr = DirectX::LoadFromDDSFile(
-            filename,
-            DirectX::DDS_FLAGS_NONE,
-            &metadata,
-            image);
+        width = dds.width;
+        height = dds.height;
+        mipLevels = useMips ? dds.mipLevels : 1;
+        format = (DXGI_FORMAT)dds.format;
 
-        if (FAILED(hr))
-        {
-            errhr(L"LoadFromDDSFile failed", hr);
+        if (cpuMips && !build_cpu_mips(dds, cpuMips))
             return false;
-        }
-
-        width = (UINT)metadata.width;
-        height = (UINT)metadata.height;
-        mipLevels = useMips ? (UINT)metadata.mipLevels : 1;
-        format = metadata.format;
 
         // --- Create GPU texture ---
         D3D12_RESOURCE_DESC desc = {};
@@ -436,7 +763,7 @@ struct d3d12_bindless_texture
 
         CD3DX12_HEAP_PROPERTIES heapPropsDefault(D3D12_HEAP_TYPE_DEFAULT);
 
-        hr = renderState.device->CreateCommittedResource(
+        HRESULT hr = renderState.device->CreateCommittedResource(
             &heapPropsDefault,
             D3D12_HEAP_FLAG_NONE,
             &desc,
@@ -450,17 +777,15 @@ struct d3d12_bindless_texture
             return false;
         }
 
-        // --- Prepare subresources (no std::vector) ---
-        const DirectX::Image *imgs = image.GetImages();
-
-        D3D12_SUBRESOURCE_DATA subresources[32]; // supports up to 32 mips
+        // --- Prepare subresources, straight out of the mapped file ---
+        D3D12_SUBRESOURCE_DATA subresources[DdsConstants::maxMips];
         UINT count = mipLevels;
 
         for (UINT i = 0; i < count; i++)
         {
-            subresources[i].pData = imgs[i].pixels;
-            subresources[i].RowPitch = imgs[i].rowPitch;
-            subresources[i].SlicePitch = imgs[i].slicePitch;
+            subresources[i].pData = dds.surfaces[i].pixels;
+            subresources[i].RowPitch = (LONG_PTR)dds.surfaces[i].rowPitch;
+            subresources[i].SlicePitch = (LONG_PTR)dds.surfaces[i].slicePitch;
         }
 
         // --- Create upload heap ---
@@ -492,12 +817,11 @@ struct d3d12_bindless_texture
             count,
             subresources);
 
-        // --- Transition to SRV state ---
+        // --- Rest in COMMON, draws promote it to a shader resource and the stream uploader's copy queue can write it ---
         auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
             texture,
             D3D12_RESOURCE_STATE_COPY_DEST,
-            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE |
-                D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            D3D12_RESOURCE_STATE_COMMON);
 
         renderState.commandList->ResourceBarrier(1, &barrier);
 
@@ -517,178 +841,70 @@ struct d3d12_bindless_texture
         return true;
     }
 
-    // ...existing code...
-    bool update_data(const wchar_t *filename)
+    bool build_cpu_mips(const dds_image &dds, height_tile_mips *cpuMips)
     {
-        if (!texture)
-            return false;
-
-        DirectX::ScratchImage image;
-        DirectX::TexMetadata metadata;
-
-        HRESULT hr = DirectX::LoadFromDDSFile(
-            filename,
-            DirectX::DDS_FLAGS_NONE,
-            &metadata,
-            image);
-
-        if (FAILED(hr))
+        const dds_surface &img = dds.surfaces[0];
+        bool isFloat = (dds.format == DdsConstants::formatR32Float);
+        if ((!isFloat && dds.format != DdsConstants::formatR16Unorm) ||
+            img.width != HeightPyramidConstants::tileDim || img.height != HeightPyramidConstants::tileDim)
         {
-            errhr(L"LoadFromDDSFile failed", hr);
+            SDL_Log("build_cpu_mips: height tile must be %dx%d R16_UNORM or R32_FLOAT", HeightPyramidConstants::tileDim, HeightPyramidConstants::tileDim);
             return false;
         }
-
-        if (metadata.width != width || metadata.height != height || metadata.format != format)
+        if (!cpuMips->build(img.pixels, img.rowPitch, isFloat))
         {
-            SDL_Log("update_data: DDS mismatch (size/format)");
-            SDL_Log("Expected: %d, %d, %d", width, height, format);
-            SDL_Log("Retrieved: %d, %d, %d", metadata.width, metadata.height, metadata.format);
-            return false;
-        }
-
-        const DirectX::Image *imgs = image.GetImages();
-        UINT mipCount = mipLevels;
-
-        D3D12_SUBRESOURCE_DATA subresources[32];
-        for (UINT i = 0; i < mipCount; i++)
-        {
-            subresources[i].pData = imgs[i].pixels;
-            subresources[i].RowPitch = (LONG_PTR)imgs[i].rowPitch;
-            subresources[i].SlicePitch = (LONG_PTR)imgs[i].slicePitch;
-        }
-
-        // Prepare an upload heap size
-        UINT64 uploadSize = GetRequiredIntermediateSize(texture, 0, mipCount);
-
-        // Create temporary upload heap
-        CD3DX12_HEAP_PROPERTIES heapPropsUpload(D3D12_HEAP_TYPE_UPLOAD);
-        auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadSize);
-
-        ID3D12Resource *localUploadHeap = nullptr;
-        hr = renderState.device->CreateCommittedResource(
-            &heapPropsUpload,
-            D3D12_HEAP_FLAG_NONE,
-            &uploadDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&localUploadHeap));
-        if (FAILED(hr))
-        {
-            errhr(L"CreateCommittedResource (update upload buffer) failed", hr);
-            return false;
-        }
-
-        // Create temporary command allocator + command list
-        ID3D12CommandAllocator *tmpAlloc = nullptr;
-        hr = renderState.device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&tmpAlloc));
-        if (FAILED(hr))
-        {
-            errhr("CreateCommandAllocator (update) failed", hr);
-            localUploadHeap->Release();
+            err("build_cpu_mips: out of memory");
             return false;
         }
+        return true;
+    }
 
-        ID3D12GraphicsCommandList *tmpList = nullptr;
-        hr = renderState.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, tmpAlloc, nullptr, IID_PPV_ARGS(&tmpList));
-        if (FAILED(hr))
+    // ...existing code...
+    bool update_data(const wchar_t *filename, UINT64 &uploadFence, height_tile_mips *cpuMips = nullptr)
+    {
+        dds_file file;
+        if (!file.open(filename))
         {
-            errhr("CreateCommandList (update) failed", hr);
-            tmpAlloc->Release();
-            localUploadHeap->Release();
+            err("dds_file open failed");
             return false;
         }
+        return update_data(file.image, uploadFence, cpuMips);
+    }
 
-        // Transition texture to COPY_DEST if needed
-        auto toCopy = CD3DX12_RESOURCE_BARRIER::Transition(
-            texture,
-            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
-            D3D12_RESOURCE_STATE_COPY_DEST);
-        tmpList->ResourceBarrier(1, &toCopy);
-
-        // Upload subresources using the temporary command list
-        UpdateSubresources(tmpList, texture, localUploadHeap, 0, 0, mipCount, subresources);
-
-        // Transition back to PIXEL_SHADER_RESOURCE
-        auto toShader = CD3DX12_RESOURCE_BARRIER::Transition(
-            texture,
-            D3D12_RESOURCE_STATE_COPY_DEST,
-            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-        tmpList->ResourceBarrier(1, &toShader);
-
-        hr = tmpList->Close();
-        if (FAILED(hr))
-        {
-            errhr("Close tmp update command list failed", hr);
-            tmpList->Release();
-            tmpAlloc->Release();
-            localUploadHeap->Release();
+    // firstMip > 0 uploads just mips [firstMip, mipLevels), dds then holds only those (see tile_archive::mip_span).
+    // The copies go out with the stream uploader's next batch, nothing may sample them before the copy fence
+    // reaches uploadFence. live when frames may be sampling the texture meanwhile.
+    bool update_data(const dds_image &dds, UINT64 &uploadFence, height_tile_mips *cpuMips = nullptr, UINT firstMip = 0, bool live = false)
+    {
+        if (!texture || firstMip >= mipLevels)
             return false;
-        }
-
-        // Execute and wait for completion
-        ID3D12CommandList *lists[] = {tmpList};
-        renderState.commandQueue->ExecuteCommandLists(1, lists);
 
-        // create a fence and wait
-        ID3D12Fence *fence = nullptr;
-        hr = renderState.device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence));
-        if (FAILED(hr))
+        UINT expectedWidth = SDL_max(width >> firstMip, 1u);
+        UINT expectedHeight = SDL_max(height >> firstMip, 1u);
+        if (dds.width != expectedWidth || dds.height != expectedHeight || dds.format != (Uint32)format || dds.mipLevels < mipLevels - firstMip)
         {
-            errhr("CreateFence (update) failed", hr);
-            tmpList->Release();
-            tmpAlloc->Release();
-            localUploadHeap->Release();
+            SDL_Log("update_data: DDS mismatch (size/format)");
+            SDL_Log("Expected: %d, %d, %d", expectedWidth, expectedHeight, format);
+            SDL_Log("Retrieved: %d, %d, %d", dds.width, dds.height, dds.format);
             return false;
         }
 
-        HANDLE event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-        if (!event)
-        {
-            err("CreateEvent failed (update)");
-            fence->Release();
-            tmpList->Release();
-            tmpAlloc->Release();
-            localUploadHeap->Release();
-            return false;
-        }
+        UINT mipCount = mipLevels - firstMip;
 
-        UINT64 fenceVal = 1;
-        hr = renderState.commandQueue->Signal(fence, fenceVal);
-        if (FAILED(hr))
-        {
-            errhr("Signal (update) failed", hr);
-            CloseHandle(event);
-            fence->Release();
-            tmpList->Release();
-            tmpAlloc->Release();
-            localUploadHeap->Release();
+        if (cpuMips && !build_cpu_mips(dds, cpuMips))
             return false;
-        }
 
-        hr = fence->SetEventOnCompletion(fenceVal, event);
-        if (FAILED(hr))
+        D3D12_SUBRESOURCE_DATA subresources[DdsConstants::maxMips];
+        for (UINT i = 0; i < mipCount; i++)
         {
-            errhr("SetEventOnCompletion (update) failed", hr);
-            CloseHandle(event);
-            fence->Release();
-            tmpList->Release();
-            tmpAlloc->Release();
-            localUploadHeap->Release();
-            return false;
+            subresources[i].pData = dds.surfaces[i].pixels;
+            subresources[i].RowPitch = (LONG_PTR)dds.surfaces[i].rowPitch;
+            subresources[i].SlicePitch = (LONG_PTR)dds.surfaces[i].slicePitch;
         }
 
-        WaitForSingleObject(event, INFINITE);
-
-        CloseHandle(event);
-        fence->Release();
-
-        // cleanup
-        tmpList->Release();
-        tmpAlloc->Release();
-        localUploadHeap->Release();
-
-        return true;
-    }    
+        uploadFence = streamUploader.upload(texture, firstMip, mipCount, subresources, live);
+        return uploadFence != 0;
+    }
 };
 
 struct d3d12_texture_array
@@ -701,6 +917,7 @@ struct d3d12_texture_array
     UINT slices = 0;
     UINT mipLevels = 0;
     DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COPY_DEST;
 
     // Create the empty array resource + SRV
     bool create(UINT _width,
@@ -765,6 +982,32 @@ struct d3d12_texture_array
         return true;
     }
 
+    void transition(ID3D12GraphicsCommandList *commandList, D3D12_RESOURCE_STATES after)
+    {
+        if (state == after)
+            return;
+        auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(texture, state, after);
+        commandList->ResourceBarrier(1, &barrier);
+        state = after;
+    }
+
+    // records a copy of one mip of one slice from a tightly packed region of an upload buffer,
+    // rowPitch must be a multiple of D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+    void copy_slice_from_buffer(ID3D12GraphicsCommandList *commandList, ID3D12Resource *src, UINT64 srcOffset, UINT slice, UINT rowPitch, UINT mip = 0)
+    {
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+        footprint.Offset = srcOffset;
+        footprint.Footprint.Format = format;
+        footprint.Footprint.Width = SDL_max(width >> mip, 1u);
+        footprint.Footprint.Height = SDL_max(height >> mip, 1u);
+        footprint.Footprint.Depth = 1;
+        footprint.Footprint.RowPitch = rowPitch;
+
+        CD3DX12_TEXTURE_COPY_LOCATION dst(texture, D3D12CalcSubresource(mip, slice, 0, mipLevels, slices));
+        CD3DX12_TEXTURE_COPY_LOCATION srcLocation(src, footprint);
+        commandList->CopyTextureRegion(&dst, 0, 0, 0, &srcLocation, nullptr);
+    }
+
     bool uploadSliceFromDDS(const wchar_t *filename,
                             UINT slice,
                             bool mipmaps)
@@ -772,52 +1015,43 @@ struct d3d12_texture_array
         if (!texture || slice >= slices)
             return false;
 
-        DirectX::ScratchImage image;
-        DirectX::TexMetadata metadata;
-
-        HRESULT hr = DirectX::LoadFromDDSFile(
-            filename,
-            DirectX::DDS_FLAGS_NONE,
-            &metadata,
-            image);
-
-        if (FAILED(hr))
+        dds_file file;
+        if (!file.open(filename))
         {
-            errhr(L"LoadFromDDSFile failed", hr);
+            err("dds_file open failed");
             return false;
         }
+        const dds_image &dds = file.image;
 
-        if (!mipmaps && metadata.mipLevels > 1)
+        if (!mipmaps && dds.mipLevels > 1)
         {
             err("Mipmaps in file but mipmaps=false specified. Remove the mipmaps from the file or use mipmaps");
             return false;
         }
 
-        if (metadata.width != width || metadata.height != height)
+        if (dds.width != width || dds.height != height)
         {
             err("DDS file does not match array texture dimensions");
             return false;
         }
 
-        if (metadata.format != format)
+        if (dds.format != (Uint32)format)
         {
             err("DDS file does not match array texture format");
             return false;
         }
 
         // Determine how many mips to upload
-        UINT srcMipLevels = mipmaps ? (UINT)metadata.mipLevels : 1;
+        UINT srcMipLevels = mipmaps ? dds.mipLevels : 1;
         if (srcMipLevels > mipLevels)
             srcMipLevels = mipLevels;
 
-        const DirectX::Image *imgs = image.GetImages();
-
-        D3D12_SUBRESOURCE_DATA subresources[32]; // supports up to 32 mips
+        D3D12_SUBRESOURCE_DATA subresources[DdsConstants::maxMips];
         UINT subresourceCount = srcMipLevels;
 
         for (UINT mip = 0; mip < srcMipLevels; ++mip)
         {
-            const DirectX::Image &img = imgs[mip];
+            const dds_surface &img = dds.surfaces[mip];
             subresources[mip].pData = img.pixels;
             subresources[mip].RowPitch = img.rowPitch;
             subresources[mip].SlicePitch = img.slicePitch;
@@ -834,7 +1068,7 @@ struct d3d12_texture_array
         auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
 
         ID3D12Resource *uploadHeap = nullptr;
-        hr = renderState.device->CreateCommittedResource(
+        HRESULT hr = renderState.device->CreateCommittedResource(
             &heapPropsUpload,
             D3D12_HEAP_FLAG_NONE,
             &uploadDesc,
@@ -1048,6 +1282,7 @@ struct d3d12_pipeline_state
     }
 };
 
+// persistently mapped upload heap buffer, callers slice it per frame in flight
 struct d3d12_constant_buffer
 {
     ID3D12Resource *constantBuffer = nullptr;
@@ -1098,4 +1333,18 @@ struct d3d12_constant_buffer
         memcpy(CbvDataBegin, data, size);
         // constantBuffer->Unmap();
     }
+
+    // created with a copy per frame in flight, each frame writes and binds its own so frames still on the GPU
+    // keep reading what they were recorded with
+    void upload(void *data, size_t size, UINT slice)
+    {
+        CD3DX12_RANGE readRangeCBV(0, 0);
+        constantBuffer->Map(0, &readRangeCBV, reinterpret_cast<void **>(&CbvDataBegin));
+        memcpy(reinterpret_cast<byte *>(CbvDataBegin) + (size_t)slice * constantBufferSize, data, size);
+    }
+
+    D3D12_GPU_VIRTUAL_ADDRESS gpu_address(UINT slice) const
+    {
+        return constantBuffer->GetGPUVirtualAddress() + (UINT64)slice * constantBufferSize;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+
+#include "v3.h"
+
+// How streaming and LOD give way to camera speed. Ground speed in tiles per second is smoothed and mapped to
+// a degradation between 0 (full detail) and 1. While the camera is fast albedo only comes in as mip tails and
+// full chains wait until it slows down, prefetch looks further along the path, and the clipmap and the
+// virtual texture accept a larger on-screen error, which moves the near rings onto coarser height levels
+// (the overview's, when there is one). Leaving the fast state takes a lower threshold held for a moment,
+// so hovering around one speed doesn't flip refines on and off.
+struct StreamPolicyConstants
+{
+    static constexpr float slowTilesPerSecond = 0.05f; // full detail up to here
+    static constexpr float fastTilesPerSecond = 0.5f;  // fully degraded from here
+    static constexpr float enterFast = 0.3f;           // degradation that starts deferring refines
+    static constexpr float leaveFast = 0.1f;           // and stops again, after resumeSeconds below it
+    static constexpr float resumeSeconds = 0.5f;
+    static constexpr float smoothingPerSecond = 4.0f;
+    static constexpr float maxLookAheadScale = 3.0f;   // prefetch look-ahead at full degradation
+    static constexpr float maxErrorScale = 4.0f;       // clipmap and page error at full degradation
+    static constexpr int prefetchSamples = 8;          // points along the predicted path, at rest
+    static constexpr int maxPrefetchSamples = 16;      // at full degradation
+};
+
+struct stream_speed_policy
+{
+    bool enabled = true;
+    float tilesPerSecond = 0.0f; // smoothed ground speed
+    float degradation = 0.0f;
+    bool fast = false;
+    float slowSeconds = 0.0f; // below leaveFast
+
+    Uint32 fastFrames = 0; // stats since startup
+
+    void update(v3 velocity, float tileWorldSize, float deltaTime)
+    {
+        float speed = SDL_sqrtf(velocity.x * velocity.x + velocity.z * velocity.z) / tileWorldSize;
+        tilesPerSecond += (speed - tilesPerSecond) * SDL_min(deltaTime * StreamPolicyConstants::smoothingPerSecond, 1.0f);
+        float t = (tilesPerSecond - StreamPolicyConstants::slowTilesPerSecond) /
+                  (StreamPolicyConstants::fastTilesPerSecond - StreamPolicyConstants::slowTilesPerSecond);
+        degradation = enabled ? SDL_clamp(t, 0.0f, 1.0f) : 0.0f;
+
+        if (degradation >= StreamPolicyConstants::enterFast)
+        {
+            fast = true;
+            slowSeconds = 0.0f;
+        }
+        else if (fast && degradation <= StreamPolicyConstants::leaveFast)
+        {
+            slowSeconds += deltaTime;
+            fast = slowSeconds < StreamPolicyConstants::resumeSeconds;
+        }
+        fastFrames += fast ? 1 : 0;
+    }
+
+    // full albedo chains wait, tiles stay on the mip tail they went resident with
+    bool defer_refines() const { return fast; }
+    // albedo mip tail first even with progressive tiles off
+    bool tail_first() const { return fast; }
+    float look_ahead_scale() const { return 1.0f + (StreamPolicyConstants::maxLookAheadScale - 1.0f) * degradation; }
+    float error_scale() const { return 1.0f + (StreamPolicyConstants::maxErrorScale - 1.0f) * degradation; }
+    int prefetch_samples() const
+    {
+        return StreamPolicyConstants::prefetchSamples +
+               (int)(degradation * (float)(StreamPolicyConstants::maxPrefetchSamples - StreamPolicyConstants::prefetchSamples) + 0.5f);
+    }
+};
+
+struct StreamFlightConstants
+{
+    static constexpr float timestep = 1.0f / 60.0f; // fixed, so every run visits the same positions on the same frames
+    static constexpr float altitude = 80.0f;
+    static constexpr float slowSpeed = 20.0f;      // units per second after the cruise, refines catch up
+    static constexpr float slowSeconds = 5.0f;
+    static constexpr float ioMegabytesPerFrame = 8.0f; // deterministic I/O budget, about a SATA SSD at 60 Hz
+};
+
+// Streaming test: a straight flight across the world at cruise speed, then a slow stretch. Counts the frames
+// the wanted window had tiles missing (the published one lagged or drew them flat), the longest run of them
+// and what streaming did, to compare policies and speeds on the same route. With deterministic I/O (see
+// stream_flight_io) the counts only depend on the route, the policy and the disk budget, so a run replays.
+struct stream_test_flight
+{
+    bool active = false;
+    v3 start = {};
+    v3 direction = {};
+    float cruiseSpeed = 0.0f;
+    float cruiseSeconds = 0.0f;
+    float time = 0.0f;
+
+    struct counters
+    {
+        Uint32 forcedPublishes;
+        Uint32 deferredFrames;
+        Uint32 loadsIssued;
+        Uint32 refinesIssued;
+    };
+    counters before = {};
+
+    // results of the current or last flight
+    Uint32 frames = 0;
+    Uint32 stallFrames = 0;
+    Uint32 longestStall = 0;
+    Uint32 stall = 0;
+    counters delta = {};
+    bool finished = false;
+
+    void begin(v3 from, v3 to, float speed, const counters &now)
+    {
+        v3 path = to - from;
+        float length = SDL_sqrtf(path.x * path.x + path.z * path.z);
+        start = {from.x, StreamFlightConstants::altitude, from.z};
+        direction = length > 0.0f ? v3{path.x / length, 0.0f, path.z / length} : v3{1.0f, 0.0f, 0.0f};
+        cruiseSpeed = speed;
+        cruiseSeconds = speed > 0.0f ? length / speed : 0.0f;
+        time = 0.0f;
+        before = now;
+        frames = stallFrames = longestStall = stall = 0;
+        delta = {};
+        finished = false;
+        active = true;
+    }
+
+    // where the camera is this frame and the timestep to run it with, false once the flight is over
+    bool advance(v3 &pos, float &deltaTime)
+    {
+        if (!active)
+            return false;
+        float total = cruiseSeconds + StreamFlightConstants::slowSeconds;
+        if (time >= total)
+        {
+            active = false;
+            finished = true;
+            return false;
+        }
+        float cruise = SDL_min(time, cruiseSeconds);
+        float slow = SDL_max(time - cruiseSeconds, 0.0f);
+        float distance = cruise * cruiseSpeed + slow * StreamFlightConstants::slowSpeed;
+        pos = start + direction * distance;
+        deltaTime = StreamFlightConstants::timestep;
+        time += deltaTime;
+        return true;
+    }
+
+    void frame_finished(int tilesNotResident, const counters &now)
+    {
+        frames++;
+        if (tilesNotResident > 0)
+        {
+            stallFrames++;
+            stall++;
+            longestStall = SDL_max(longestStall, stall);
+        }
+        else
+        {
+            stall = 0;
+        }
+        delta.forcedPublishes = now.forcedPublishes - before.forcedPublishes;
+        delta.deferredFrames = now.deferredFrames - before.deferredFrames;
+        delta.loadsIssued = now.loadsIssued - before.loadsIssued;
+        delta.refinesIssued = now.refinesIssued - before.refinesIssued;
+    }
+};
+
+// Deterministic I/O for the test flight. Each frame first waits for every load issued so far and its copies,
+// then lands them as if one disk read them most urgent first (lowest priority value, then request order) at
+// bytesPerFrame, so what lands on which frame depends on the route, the policy and the budget alone. A load
+// bigger than a frame's budget lands once enough frames have passed, an idle disk doesn't bank bytes. Loads
+// superseded while they wait count as dropped before their read, callers zero their bytes.
+struct stream_flight_io
+{
+    Uint64 bytesPerFrame = 0;
+    Uint64 credit = 0; // read so far towards the most urgent load still waiting
+
+    // Sorts the loads waiting to land, returns how many from the front land this frame.
+    // T needs priority, sequence and timing.bytes.
+    template <typename T>
+    size_t landing(T *loads, size_t count)
+    {
+        std::sort(loads, loads + count, [](const T &a, const T &b)
+                  { return a.priority < b.priority || (a.priority == b.priority && a.sequence < b.sequence); });
+        credit += bytesPerFrame;
+        size_t landed = 0;
+        while (landed < count && loads[landed].timing.bytes <= credit)
+            credit -= loads[landed++].timing.bytes;
+        if (landed == count)
+            credit = 0;
+        return landed;
+    }
+};
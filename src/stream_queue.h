@@ -0,0 +1,199 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Generation counter that requests are issued against, bumping it supersedes every request issued
+// before. Requests still queued when that happens are dropped before their I/O starts.
+struct stream_token
+{
+    std::atomic<Uint32> generation;
+
+    Uint32 current() const { return generation.load(std::memory_order_acquire); }
+    void supersede() { generation.fetch_add(1, std::memory_order_acq_rel); }
+};
+
+struct stream_request
+{
+    float priority; // lower runs first, distance to the camera for tile loads
+    Uint64 sequence; // keeps equal priorities in submission order
+    const stream_token *token; // may be null for requests that can't be cancelled
+    Uint32 generation;
+    // always reports back once, cancelled requests should only report back. Reporting back has to be the last
+    // thing it does: if it throws, it is run again as cancelled so its owner still hears about it.
+    std::function<void(bool cancelled)> run;
+};
+
+struct stream_request_order
+{
+    bool operator()(const stream_request &a, const stream_request &b) const
+    {
+        if (a.priority != b.priority)
+            return a.priority > b.priority;
+        return a.sequence > b.sequence;
+    }
+};
+
+// Priority ordered request queue, drained by jobs on the job system
+struct stream_request_queue
+{
+    std::mutex mutex;
+    std::priority_queue<stream_request, std::vector<stream_request>, stream_request_order> requests;
+    Uint64 nextSequence = 0;
+
+    // stats since startup
+    std::atomic<Uint32> depth{0};
+    Uint32 peakDepth = 0;
+    std::atomic<Uint32> issued{0};
+    std::atomic<Uint32> completed{0};
+    std::atomic<Uint32> cancelled{0};
+    std::atomic<Uint32> failed{0}; // threw, reported back as cancelled
+
+    // caller holds mutex
+    void push_locked(float priority, const stream_token *token, std::function<void(bool cancelled)> run)
+    {
+        stream_request request;
+        request.priority = priority;
+        request.sequence = nextSequence++;
+        request.token = token;
+        request.generation = token ? token->current() : 0;
+        request.run = std::move(run);
+        requests.push(std::move(request));
+
+        Uint32 newDepth = (Uint32)requests.size();
+        depth.store(newDepth, std::memory_order_relaxed);
+        peakDepth = SDL_max(peakDepth, newDepth);
+        issued.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // caller holds mutex, returns false when empty
+    bool pop_locked(stream_request &out)
+    {
+        if (requests.empty())
+            return false;
+        // priority_queue::top is const, the request is moved out just before pop discards it
+        out = std::move(const_cast<stream_request &>(requests.top()));
+        requests.pop();
+        depth.store((Uint32)requests.size(), std::memory_order_relaxed);
+        return true;
+    }
+
+    // runs a popped request, dropping it if its token moved on since it was queued. A request that throws
+    // reports back as cancelled, a worker must never swallow a request its owner is still counting on.
+    void execute(stream_request &request)
+    {
+        bool superseded = request.token && request.token->current() != request.generation;
+        try
+        {
+            request.run(superseded);
+        }
+        catch (...)
+        {
+            failed.fetch_add(1, std::memory_order_relaxed);
+            try
+            {
+                request.run(true);
+            }
+            catch (...)
+            {
+                // nothing left to report with, keep the worker alive
+            }
+            return;
+        }
+        if (superseded)
+            cancelled.fetch_add(1, std::memory_order_relaxed);
+        else
+            completed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // job entry point, one job is submitted per pushed request and runs whichever request is most urgent by then
+    static void run_next(void *data)
+    {
+        stream_request_queue *queue = (stream_request_queue *)data;
+        stream_request request;
+        {
+            std::lock_guard<std::mutex> lk(queue->mutex);
+            if (!queue->pop_locked(request))
+                return;
+        }
+        queue->execute(request);
+    }
+};
+
+// Bounded queue stream workers post finished loads to and the main thread drains once a frame, with no lock on
+// either side. Each cell's sequence number says whose turn it is: producers claim cells by bumping head, the
+// consumer hands a cell back by moving its sequence a lap ahead (Vyukov's bounded queue, single consumer).
+template <typename T, Uint32 capacity>
+struct stream_completion_queue
+{
+    static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    struct cell
+    {
+        std::atomic<Uint32> sequence;
+        T value;
+    };
+    cell cells[capacity];
+    std::atomic<Uint32> head{0}; // next cell a producer claims
+    Uint32 tail = 0;             // next cell the consumer reads, main thread only
+
+    void init()
+    {
+        for (Uint32 i = 0; i < capacity; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        head.store(0, std::memory_order_relaxed);
+        tail = 0;
+    }
+
+    // false when every cell holds a result the consumer hasn't taken yet
+    bool try_push(const T &value)
+    {
+        Uint32 pos = head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell &c = cells[pos & (capacity - 1)];
+            Sint32 lag = (Sint32)(c.sequence.load(std::memory_order_acquire) - pos);
+            if (lag == 0)
+            {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    c.value = value;
+                    c.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lag < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // callers size capacity above the loads they can have in flight, so this only waits if that's wrong
+    void push(const T &value)
+    {
+        while (!try_push(value))
+            std::this_thread::yield();
+    }
+
+    bool pop(T &out)
+    {
+        cell &c = cells[tail & (capacity - 1)];
+        if ((Sint32)(c.sequence.load(std::memory_order_acquire) - (tail + 1)) < 0)
+            return false;
+        out = c.value;
+        c.sequence.store(tail + capacity, std::memory_order_release);
+        tail++;
+        return true;
+    }
+};
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include <float.h>
+#include <imgui.h>
+
+#include "tile_residency.h"
+
+// Per request timestamps of a tile load, filled in as it moves through the streaming path.
+// Performance counter ticks, 0 for a stage it never reached. Loads through the mapping have no separate
+// I/O stage, their page faults land in decode and upload.
+struct stream_load_timing
+{
+    Uint64 enqueued;
+    Uint64 ioStart;
+    Uint64 ioEnd;
+    Uint64 decodeEnd;
+    Uint64 uploadEnd;
+    Uint64 bytes; // read from the archive
+};
+
+struct StreamTelemetryConstants
+{
+    static constexpr int maxRecords = 4096; // most recent finished loads, kept for the CSV
+    static constexpr int historyFrames = 256;
+    static constexpr int histogramBuckets = 16; // log2 of milliseconds, the first bucket ends at 1/8 ms
+    static constexpr float firstBucketMs = 0.125f;
+};
+
+enum stream_stage
+{
+    STREAM_STAGE_QUEUE,     // enqueued -> I/O start
+    STREAM_STAGE_IO,        // I/O start -> end
+    STREAM_STAGE_DECODE,    // I/O end -> decoded
+    STREAM_STAGE_UPLOAD,    // decoded -> uploaded
+    STREAM_STAGE_LOAD,      // enqueued -> uploaded
+    STREAM_STAGE_FIRST_USE, // enqueued -> first frame that drew the tile
+    STREAM_STAGE_COUNT
+};
+
+static const char *stream_stage_name(stream_stage stage)
+{
+    static const char *names[STREAM_STAGE_COUNT] = {"queue", "io", "decode", "upload", "load", "first_use"};
+    return names[stage];
+}
+
+struct stream_load_record
+{
+    stream_load_timing timing;
+    Uint64 firstUse; // 0 when the tile was evicted or reloaded before a frame drew it
+    int tileX;
+    int tileY;
+    bool albedo;
+    bool speculative;
+    bool refine; // full albedo chain for a tile that went resident on its mip tail
+    bool ok;
+    bool cancelled;
+};
+
+// Main thread only: loads report their timing back with their results, the frame loop feeds the rest
+struct stream_telemetry
+{
+    stream_load_record records[StreamTelemetryConstants::maxRecords]; // ring, oldest overwritten
+    int recordCount;
+    int nextRecord;
+
+    // finished loads whose tile hasn't been drawn yet, height and albedo per slot
+    stream_load_record pending[TileResidencyConstants::maxSlots][2];
+    bool pendingUsed[TileResidencyConstants::maxSlots][2];
+
+    Uint32 histograms[STREAM_STAGE_COUNT][StreamTelemetryConstants::histogramBuckets];
+    float stageMaxMs[STREAM_STAGE_COUNT];
+
+    // per frame history, for the plots and the frames CSV
+    float queueDepthHistory[StreamTelemetryConstants::historyFrames];
+    float inFlightHistory[StreamTelemetryConstants::historyFrames];
+    float mbPerSecondHistory[StreamTelemetryConstants::historyFrames];
+    float nonResidentHistory[StreamTelemetryConstants::historyFrames];
+    int historyIndex;
+
+    // stats since startup
+    Uint32 loadsRequested;
+    Uint32 loadsFinished;
+    Uint32 loadsFailed;
+    Uint32 loadsCancelled;
+    Uint32 loadsNeverUsed;
+    Uint32 framesDrawn;
+    Uint32 framesWithNonResident; // frames drawn while a window tile wasn't resident
+    Uint64 bytesLoaded;
+    Uint64 bytesThisFrame;
+    Uint64 lastFrameTicks;
+
+    static float ticks_to_ms(Uint64 ticks)
+    {
+        return (float)((double)ticks * 1000.0 / (double)SDL_GetPerformanceFrequency());
+    }
+
+    static float stage_ms(const stream_load_record &r, stream_stage stage)
+    {
+        const stream_load_timing &t = r.timing;
+        Uint64 from = 0;
+        Uint64 to = 0;
+        switch (stage)
+        {
+        case STREAM_STAGE_QUEUE:
+            from = t.enqueued, to = t.ioStart;
+            break;
+        case STREAM_STAGE_IO:
+            from = t.ioStart, to = t.ioEnd;
+            break;
+        case STREAM_STAGE_DECODE:
+            from = t.ioEnd, to = t.decodeEnd;
+            break;
+        case STREAM_STAGE_UPLOAD:
+            from = t.decodeEnd, to = t.uploadEnd;
+            break;
+        case STREAM_STAGE_LOAD:
+            from = t.enqueued, to = t.uploadEnd;
+            break;
+        default:
+            from = t.enqueued, to = r.firstUse;
+            break;
+        }
+        return (from && to >= from) ? ticks_to_ms(to - from) : -1.0f;
+    }
+
+    void add_sample(stream_stage stage, float ms)
+    {
+        if (ms < 0.0f)
+            return;
+        int bucket = 0;
+        for (float end = StreamTelemetryConstants::firstBucketMs; ms >= end && bucket < StreamTelemetryConstants::histogramBuckets - 1; end *= 2.0f)
+            ++bucket;
+        histograms[stage][bucket]++;
+        stageMaxMs[stage] = SDL_max(stageMaxMs[stage], ms);
+    }
+
+    // upper edge of the bucket holding the given fraction of a stage's samples
+    float percentile_ms(stream_stage stage, float fraction) const
+    {
+        Uint32 total = 0;
+        for (int i = 0; i < StreamTelemetryConstants::histogramBuckets; ++i)
+            total += histograms[stage][i];
+        Uint32 seen = 0;
+        float end = StreamTelemetryConstants::firstBucketMs;
+        for (int i = 0; i < StreamTelemetryConstants::histogramBuckets; ++i, end *= 2.0f)
+        {
+            seen += histograms[stage][i];
+            if (total > 0 && (float)seen >= fraction * (float)total)
+                return SDL_min(end, stageMaxMs[stage]);
+        }
+        return stageMaxMs[stage];
+    }
+
+    void record(const stream_load_record &r)
+    {
+        records[nextRecord] = r;
+        nextRecord = (nextRecord + 1) % StreamTelemetryConstants::maxRecords;
+        recordCount = SDL_min(recordCount + 1, StreamTelemetryConstants::maxRecords);
+        if (r.firstUse)
+            add_sample(STREAM_STAGE_FIRST_USE, stage_ms(r, STREAM_STAGE_FIRST_USE));
+        else if (!r.cancelled)
+            loadsNeverUsed++;
+    }
+
+    void load_requested() { loadsRequested++; }
+
+    // a load's result reached the main thread
+    void load_finished(int slot, const stream_load_record &r)
+    {
+        loadsFinished++;
+        loadsFailed += (!r.ok && !r.cancelled) ? 1 : 0;
+        loadsCancelled += r.cancelled ? 1 : 0;
+        bytesThisFrame += r.timing.bytes;
+        bytesLoaded += r.timing.bytes;
+        if (r.cancelled || !r.ok)
+        {
+            record(r);
+            return;
+        }
+        for (int stage = STREAM_STAGE_QUEUE; stage <= STREAM_STAGE_LOAD; ++stage)
+            add_sample((stream_stage)stage, stage_ms(r, (stream_stage)stage));
+
+        int layer = r.albedo ? 1 : 0;
+        if (slot < 0 || slot >= TileResidencyConstants::maxSlots)
+        {
+            record(r);
+            return;
+        }
+        if (pendingUsed[slot][layer])
+            record(pending[slot][layer]);
+        pending[slot][layer] = r;
+        pendingUsed[slot][layer] = true;
+    }
+
+    // a frame is about to draw the slot's tile
+    void tile_used(int slot, Uint64 frameTicks)
+    {
+        for (int layer = 0; layer < 2; ++layer)
+        {
+            if (!pendingUsed[slot][layer])
+                continue;
+            pending[slot][layer].firstUse = frameTicks;
+            record(pending[slot][layer]);
+            pendingUsed[slot][layer] = false;
+        }
+    }
+
+    // the slot is being loaded with another tile, whatever it held was never drawn
+    void slot_reassigned(int slot)
+    {
+        for (int layer = 0; layer < 2; ++layer)
+        {
+            if (pendingUsed[slot][layer])
+                record(pending[slot][layer]);
+            pendingUsed[slot][layer] = false;
+        }
+    }
+
+    void end_frame(Uint32 queueDepth, int nonResidentTiles)
+    {
+        Uint64 now = SDL_GetPerformanceCounter();
+        float seconds = lastFrameTicks ? ticks_to_ms(now - lastFrameTicks) / 1000.0f : 0.0f;
+        lastFrameTicks = now;
+
+        int i = historyIndex;
+        queueDepthHistory[i] = (float)queueDepth;
+        inFlightHistory[i] = (float)SDL_max((int)(loadsRequested - loadsFinished), 0);
+        mbPerSecondHistory[i] = seconds > 0.0f ? (float)bytesThisFrame / (1024.0f * 1024.0f) / seconds : 0.0f;
+        nonResidentHistory[i] = (float)nonResidentTiles;
+        historyIndex = (i + 1) % StreamTelemetryConstants::historyFrames;
+
+        bytesThisFrame = 0;
+        framesDrawn++;
+        framesWithNonResident += nonResidentTiles > 0 ? 1 : 0;
+    }
+
+    // one row per recorded load (times in ms from the first record's enqueue, -1 for stages not reached),
+    // one row per frame of history
+    bool dump_csv(const char *loadsPath, const char *framesPath) const
+    {
+        SDL_IOStream *loads = SDL_IOFromFile(loadsPath, "w");
+        if (!loads)
+        {
+            SDL_Log("stream_telemetry: failed to write %s", loadsPath);
+            return false;
+        }
+        int first = (nextRecord - recordCount + StreamTelemetryConstants::maxRecords) % StreamTelemetryConstants::maxRecords;
+        Uint64 origin = recordCount > 0 ? records[first].timing.enqueued : 0;
+        SDL_IOprintf(loads, "tile_x,tile_y,layer,speculative,refine,ok,cancelled,bytes,enqueued_ms");
+        for (int stage = 0; stage < STREAM_STAGE_COUNT; ++stage)
+            SDL_IOprintf(loads, ",%s_ms", stream_stage_name((stream_stage)stage));
+        SDL_IOprintf(loads, "\n");
+        for (int n = 0; n < recordCount; ++n)
+        {
+            const stream_load_record &r = records[(first + n) % StreamTelemetryConstants::maxRecords];
+            SDL_IOprintf(loads, "%d,%d,%s,%d,%d,%d,%d,%llu,%.3f", r.tileX, r.tileY, r.albedo ? "albedo" : "height", r.speculative, r.refine, r.ok,
+                         r.cancelled, (unsigned long long)r.timing.bytes,
+                         r.timing.enqueued >= origin ? ticks_to_ms(r.timing.enqueued - origin) : 0.0f);
+            for (int stage = 0; stage < STREAM_STAGE_COUNT; ++stage)
+                SDL_IOprintf(loads, ",%.3f", stage_ms(r, (stream_stage)stage));
+            SDL_IOprintf(loads, "\n");
+        }
+        bool ok = SDL_CloseIO(loads);
+
+        SDL_IOStream *frames = SDL_IOFromFile(framesPath, "w");
+        if (!frames)
+        {
+            SDL_Log("stream_telemetry: failed to write %s", framesPath);
+            return false;
+        }
+        SDL_IOprintf(frames, "frame,queue_depth,in_flight,mb_per_s,non_resident_tiles\n");
+        int frameCount = SDL_min((int)framesDrawn, StreamTelemetryConstants::historyFrames);
+        for (int n = 0; n < frameCount; ++n)
+        {
+            int i = (historyIndex - frameCount + n + StreamTelemetryConstants::historyFrames) % StreamTelemetryConstants::historyFrames;
+            SDL_IOprintf(frames, "%u,%.0f,%.0f,%.2f,%.0f\n", framesDrawn - frameCount + n, queueDepthHistory[i], inFlightHistory[i],
+                         mbPerSecondHistory[i], nonResidentHistory[i]);
+        }
+        return SDL_CloseIO(frames) && ok;
+    }
+
+    void imgui_show()
+    {
+        ImGui::Begin("Streaming Telemetry");
+
+        ImGui::Text("Loads: %u requested, %u finished, %u failed, %u cancelled, %u never drawn", loadsRequested, loadsFinished,
+                    loadsFailed, loadsCancelled, loadsNeverUsed);
+        ImGui::Text("Loaded: %.1f MB", (double)bytesLoaded / (1024.0 * 1024.0));
+        ImGui::Text("Frames with a non-resident tile: %u / %u", framesWithNonResident, framesDrawn);
+
+        if (ImGui::BeginTable("stages", 4))
+        {
+            ImGui::TableSetupColumn("stage");
+            ImGui::TableSetupColumn("p50 ms");
+            ImGui::TableSetupColumn("p95 ms");
+            ImGui::TableSetupColumn("max ms");
+            ImGui::TableHeadersRow();
+            for (int stage = 0; stage < STREAM_STAGE_COUNT; ++stage)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(stream_stage_name((stream_stage)stage));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", percentile_ms((stream_stage)stage, 0.5f));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", percentile_ms((stream_stage)stage, 0.95f));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", stageMaxMs[stage]);
+            }
+            ImGui::EndTable();
+        }
+
+        static int histogramStage = STREAM_STAGE_LOAD;
+        ImGui::SliderInt("Histogram stage", &histogramStage, 0, STREAM_STAGE_COUNT - 1, stream_stage_name((stream_stage)histogramStage));
+        float buckets[StreamTelemetryConstants::histogramBuckets];
+        for (int i = 0; i < StreamTelemetryConstants::histogramBuckets; ++i)
+            buckets[i] = (float)histograms[histogramStage][i];
+        ImGui::PlotHistogram("Latency (log2 ms from 1/8)", buckets, StreamTelemetryConstants::histogramBuckets, 0, nullptr, 0.0f,
+                             FLT_MAX, ImVec2(0, 60));
+
+        int offset = historyIndex;
+        int frames = StreamTelemetryConstants::historyFrames;
+        ImGui::PlotLines("Queue depth", queueDepthHistory, frames, offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+        ImGui::PlotLines("In flight", inFlightHistory, frames, offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+        ImGui::PlotLines("MB/s", mbPerSecondHistory, frames, offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+        ImGui::PlotLines("Non-resident tiles", nonResidentHistory, frames, offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+
+        if (ImGui::Button("Dump CSV"))
+            dump_csv("stream_loads.csv", "stream_frames.csv");
+        ImGui::End();
+    }
+};
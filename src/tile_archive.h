@@ -0,0 +1,525 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "dds_file.h"
+#include "mapped_file.h"
+#include "lz4_block.h"
+#include "height_codec.h"
+#include "job_system.h"
+#include "world_manifest.h"
+
+// One packed file per dataset, written by pack_tiles.py. A fixed header, then the directory: tileCount
+// world_tile_info records sorted by key (the world manifest), then tileCount * layerCount entries (tile
+// major, then layer), then the tiles' mip chains without their DDS headers, each starting on an alignment
+// boundary. Everything is little endian. Only tiles that exist are in the directory.
+// The archive is mapped once, an uncompressed tile is a hash lookup and a directory read into the mapping.
+// A compressed tile is its mip chain cut into chunks that decode independently, in parallel: a table of
+// chunk sizes, then the chunks back to back. LZ4 chunks are chunkSize pieces of the chain, height codec
+// chunks are bands of whole rows of one mip, at most chunkSize bytes decoded (see height_codec.h).
+// The packer stores byte identical tiles once, their entries share a payload offset. Two tiles with the same
+// offset for a layer have the same content there, so the offset doubles as a content id.
+// Tiles whose top mip stays within a tolerance of one value are stored as that value, without a payload:
+// offset 0 like a missing tile, so loads pass them over, compression TILE_COMPRESSION_CONSTANT and the value
+// in chunkCount. Heights are R16_UNORM, colours RGBA8 with red in the low byte.
+struct TileArchiveConstants
+{
+    static constexpr Uint32 magic = 0x4B415054; // "TPAK"
+    static constexpr Uint32 version = 3;
+    static constexpr Uint32 chunkStoredRaw = 0x80000000u; // chunk size flag, the chunk didn't compress
+};
+
+enum tile_compression
+{
+    TILE_COMPRESSION_NONE,
+    TILE_COMPRESSION_LZ4_CHUNKS,
+    TILE_COMPRESSION_HEIGHT_DELTA, // R16_UNORM only
+    TILE_COMPRESSION_CONSTANT      // no payload, chunkCount holds the value
+};
+
+enum tile_archive_layer
+{
+    TILE_LAYER_HEIGHT,
+    TILE_LAYER_ALBEDO,
+    TILE_LAYER_COUNT
+};
+
+struct tile_archive_header
+{
+    Uint32 magic;
+    Uint32 version;
+    Uint32 tileCount;
+    Uint32 layerCount;
+    Uint32 alignment; // payload alignment in bytes, 64 KiB by default
+    Uint32 chunkSize; // uncompressed bytes per compressed chunk
+    Uint32 reserved[2];
+    Uint64 directoryOffset;
+};
+
+struct tile_archive_entry
+{
+    Uint64 offset;     // of the payload from the start of the archive, 0 for a missing tile
+    Uint64 size;       // whole mip chain, uncompressed
+    Uint64 storedSize; // payload bytes in the archive
+    Uint32 format;     // DXGI_FORMAT
+    Uint32 width;
+    Uint32 height;
+    Uint32 mipLevels;
+    Uint32 compression; // tile_compression
+    Uint32 chunkCount; // or the value of a constant tile
+    Uint64 mipOffsets[DdsConstants::maxMips]; // into the uncompressed mip chain
+};
+
+static_assert(sizeof(tile_archive_header) == 40, "tile_archive_header must match pack_tiles.py");
+static_assert(sizeof(tile_archive_entry) == 48 + 8 * DdsConstants::maxMips, "tile_archive_entry must match pack_tiles.py");
+
+// where one chunk decodes to, inside the uncompressed mip chain
+struct tile_archive_chunk
+{
+    Uint64 dstOffset;
+    Uint64 dstSize;
+    Uint32 width; // row bands only
+    Uint32 rows;
+};
+
+// Lays out an entry's chunks, returns how many there are (0 when the entry can't be chunked).
+// chunks may be null to only count them.
+static Uint32 tile_archive_plan_chunks(const tile_archive_entry &e, Uint32 chunkSize, tile_archive_chunk *chunks, Uint32 maxChunks)
+{
+    if (chunkSize == 0)
+        return 0;
+    Uint32 count = 0;
+    if (e.compression == TILE_COMPRESSION_LZ4_CHUNKS)
+    {
+        for (Uint64 offset = 0; offset < e.size; offset += chunkSize, ++count)
+        {
+            if (chunks && count < maxChunks)
+                chunks[count] = {offset, SDL_min((Uint64)chunkSize, e.size - offset), 0, 0};
+        }
+        return count;
+    }
+    if (e.compression != TILE_COMPRESSION_HEIGHT_DELTA || e.format != DdsConstants::formatR16Unorm)
+        return 0;
+
+    Uint64 offset = 0;
+    Uint32 w = e.width;
+    Uint32 h = e.height;
+    for (Uint32 mip = 0; mip < e.mipLevels; ++mip)
+    {
+        Uint32 bandRows = SDL_max(chunkSize / (w * 2), 1u);
+        for (Uint32 row = 0; row < h; row += bandRows, ++count)
+        {
+            Uint32 rows = SDL_min(bandRows, h - row);
+            if (chunks && count < maxChunks)
+                chunks[count] = {offset + (Uint64)row * w * 2, (Uint64)rows * w * 2, w, rows};
+        }
+        offset += (Uint64)w * h * 2;
+        w = SDL_max(w / 2, 1u);
+        h = SDL_max(h / 2, 1u);
+    }
+    return offset == e.size ? count : 0;
+}
+
+// Stored bytes of a tile's payload that hold mips [firstMip, mipLevels), see tile_archive::mip_span
+struct tile_archive_span
+{
+    Uint32 firstMip;
+    Uint64 storedBegin; // into the payload
+    Uint64 storedEnd;
+    Uint32 firstChunk; // compressed tiles, first chunk the span decodes
+    Uint64 pixelBegin; // offset into the uncompressed mip chain where the span's first chunk starts
+};
+
+// Where a worker decodes compressed tiles, kept between loads so streaming doesn't allocate
+struct tile_decode_buffer
+{
+    Uint8 *data = nullptr;
+    size_t capacity = 0;
+
+    bool reserve(size_t size)
+    {
+        if (size <= capacity)
+            return true;
+        SDL_free(data);
+        data = (Uint8 *)SDL_malloc(size);
+        capacity = data ? size : 0;
+        return data != nullptr;
+    }
+
+    ~tile_decode_buffer() { SDL_free(data); }
+};
+
+// Decode buffers handed out per load. Not thread local: a worker waiting on a decode's chunks may start
+// another load itself, which then needs a buffer of its own.
+struct tile_decode_pool
+{
+    std::mutex mutex;
+    std::vector<tile_decode_buffer *> free;
+
+    tile_decode_buffer *acquire()
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        if (free.empty())
+            return new tile_decode_buffer();
+        tile_decode_buffer *buffer = free.back();
+        free.pop_back();
+        return buffer;
+    }
+
+    void release(tile_decode_buffer *buffer)
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        free.push_back(buffer);
+    }
+
+    ~tile_decode_pool()
+    {
+        for (tile_decode_buffer *buffer : free)
+            delete buffer;
+    }
+};
+
+// What sharing payloads saved, per layer
+struct tile_archive_dedup_stats
+{
+    Uint32 entries;         // tiles that have the layer
+    Uint32 uniquePayloads;  // distinct payloads among them
+    Uint64 duplicateBytes;  // uncompressed bytes the duplicates would have taken, GPU memory for each resident copy
+    Uint64 duplicateStored; // stored bytes they would have taken, the archive size and reads saved
+    Uint32 constantTiles;   // stored as a value, never read
+    Uint64 constantBytes;   // uncompressed bytes they would have taken
+};
+
+static int tile_archive_entry_offset_compare(const void *a, const void *b)
+{
+    Uint64 x = (*(const tile_archive_entry *const *)a)->offset;
+    Uint64 y = (*(const tile_archive_entry *const *)b)->offset;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+struct tile_archive
+{
+    mapped_file file;
+    const tile_archive_header *header = nullptr;
+    world_manifest manifest;
+    const tile_archive_entry *entries = nullptr;
+
+    // decode stats since startup, across every worker
+    std::atomic<Uint64> decodedBytes{0};
+    std::atomic<Uint64> decodedStoredBytes{0};
+    std::atomic<Uint64> decodeTicks{0};
+
+    tile_archive_dedup_stats dedup[TILE_LAYER_COUNT] = {};
+
+    bool open(const wchar_t *filename)
+    {
+        if (!file.open(filename))
+            return false;
+
+        header = (const tile_archive_header *)file.data;
+        if (file.size < sizeof(tile_archive_header) || header->magic != TileArchiveConstants::magic ||
+            header->version != TileArchiveConstants::version || header->alignment == 0)
+        {
+            SDL_Log("tile_archive: %ls is not a version %u tile archive", filename, TileArchiveConstants::version);
+            close();
+            return false;
+        }
+        Uint64 entryCount = (Uint64)header->tileCount * header->layerCount;
+        Uint64 directorySize = (Uint64)header->tileCount * sizeof(world_tile_info) + entryCount * sizeof(tile_archive_entry);
+        if (header->directoryOffset > file.size || directorySize > file.size - header->directoryOffset)
+        {
+            SDL_Log("tile_archive: truncated directory");
+            close();
+            return false;
+        }
+        const world_tile_info *tiles = (const world_tile_info *)(file.data + header->directoryOffset);
+        entries = (const tile_archive_entry *)(tiles + header->tileCount);
+        if (!manifest.build(tiles, header->tileCount))
+        {
+            SDL_Log("tile_archive: %ls has a bad tile manifest", filename);
+            close();
+            return false;
+        }
+
+        // payloads are validated once here so lookups can't run off the mapping
+        for (Uint64 i = 0; i < entryCount; ++i)
+        {
+            const tile_archive_entry &e = entries[i];
+            bool compressed = e.compression != TILE_COMPRESSION_NONE;
+            if (e.offset != 0 &&
+                (e.offset > file.size || e.storedSize > file.size - e.offset || e.mipLevels > (Uint32)DdsConstants::maxMips ||
+                 (!compressed && e.storedSize != e.size) ||
+                 (compressed && (e.chunkCount == 0 || e.chunkCount != tile_archive_plan_chunks(e, header->chunkSize, nullptr, 0) ||
+                                 (Uint64)e.chunkCount * sizeof(Uint32) > e.storedSize))))
+            {
+                SDL_Log("tile_archive: entry %u lies outside the archive", (Uint32)i);
+                close();
+                return false;
+            }
+        }
+        count_duplicates();
+        return true;
+    }
+
+    // fills dedup from the directory, entries sharing a payload offset are one payload
+    void count_duplicates()
+    {
+        const tile_archive_entry **sorted = (const tile_archive_entry **)SDL_malloc(sizeof(tile_archive_entry *) * SDL_max(header->tileCount, 1u));
+        if (!sorted)
+            return;
+        for (Uint32 layer = 0; layer < SDL_min(header->layerCount, (Uint32)TILE_LAYER_COUNT); ++layer)
+        {
+            tile_archive_dedup_stats &stats = dedup[layer];
+            stats = {};
+            for (Uint32 tile = 0; tile < header->tileCount; ++tile)
+            {
+                const tile_archive_entry &e = entries[(size_t)tile * header->layerCount + layer];
+                if (e.offset != 0)
+                    sorted[stats.entries++] = &e;
+                else if (e.compression == TILE_COMPRESSION_CONSTANT)
+                {
+                    stats.constantTiles++;
+                    stats.constantBytes += e.size;
+                }
+            }
+            SDL_qsort(sorted, stats.entries, sizeof(tile_archive_entry *), tile_archive_entry_offset_compare);
+            for (Uint32 i = 0; i < stats.entries; ++i)
+            {
+                if (i > 0 && sorted[i]->offset == sorted[i - 1]->offset)
+                {
+                    stats.duplicateBytes += sorted[i]->size;
+                    stats.duplicateStored += sorted[i]->storedSize;
+                }
+                else
+                {
+                    stats.uniquePayloads++;
+                }
+            }
+        }
+        SDL_free(sorted);
+    }
+
+    // Identifies what a tile's layers in layerMask hold, tiles with the same key have identical content there.
+    // Payloads start on alignment boundaries, so each layer's payload index fits its half of the key.
+    Uint64 content_key(int tileX, int tileY, Uint32 layerMask) const
+    {
+        static_assert(TILE_LAYER_COUNT <= 2, "content_key packs one 32 bit payload index per layer");
+        Uint64 key = 0;
+        for (Uint32 layer = 0; layer < TILE_LAYER_COUNT; ++layer)
+        {
+            const tile_archive_entry *e = (layerMask & (1u << layer)) ? entry((tile_archive_layer)layer, tileX, tileY) : nullptr;
+            if (e)
+                key |= (e->offset / header->alignment) << (32 * layer);
+        }
+        return key;
+    }
+
+    // Entry of a layer stored as a constant value, null when the layer has a payload or the tile lacks it
+    const tile_archive_entry *constant_entry(tile_archive_layer layer, int tileX, int tileY) const
+    {
+        if (!header || (Uint32)layer >= header->layerCount)
+            return nullptr;
+        int tile = manifest.find(tileX, tileY);
+        if (tile < 0)
+            return nullptr;
+        const tile_archive_entry &e = entries[(size_t)tile * header->layerCount + (size_t)layer];
+        return e.offset == 0 && e.compression == TILE_COMPRESSION_CONSTANT ? &e : nullptr;
+    }
+
+    // bit per tile_archive_layer the tile stores as a constant value
+    Uint32 constant_layers(int tileX, int tileY) const
+    {
+        int tile = header ? manifest.find(tileX, tileY) : -1;
+        if (tile < 0)
+            return 0;
+        Uint32 mask = 0;
+        for (Uint32 layer = 0; layer < header->layerCount && layer < (Uint32)TILE_LAYER_COUNT; ++layer)
+        {
+            const tile_archive_entry &e = entries[(size_t)tile * header->layerCount + layer];
+            if (e.offset == 0 && e.compression == TILE_COMPRESSION_CONSTANT)
+                mask |= 1u << layer;
+        }
+        return mask;
+    }
+
+    // uncompressed bytes of the biggest single mip any tile streams, the top mip of the largest tile
+    Uint64 largest_mip_bytes() const
+    {
+        Uint64 largest = 0;
+        Uint64 entryCount = header ? (Uint64)header->tileCount * header->layerCount : 0;
+        for (Uint64 i = 0; i < entryCount; ++i)
+        {
+            const tile_archive_entry &e = entries[i];
+            if (e.offset != 0)
+                largest = SDL_max(largest, e.mipLevels > 1 ? e.mipOffsets[1] - e.mipOffsets[0] : e.size);
+        }
+        return largest;
+    }
+
+    void close()
+    {
+        file.close();
+        manifest.release();
+        header = nullptr;
+        entries = nullptr;
+    }
+
+    // Directory entry of a tile, null when the world doesn't have the tile or the tile lacks the layer
+    const tile_archive_entry *entry(tile_archive_layer layer, int tileX, int tileY) const
+    {
+        if (!header || (Uint32)layer >= header->layerCount)
+            return nullptr;
+        int tile = manifest.find(tileX, tileY);
+        if (tile < 0)
+            return nullptr;
+        const tile_archive_entry &e = entries[(size_t)tile * header->layerCount + (size_t)layer];
+        return e.offset != 0 ? &e : nullptr;
+    }
+
+    // Points out at the tile's mips [firstMip, mipLevels) (as an image of their own), inside the mapping or,
+    // for compressed tiles, inside scratch after decoding it there in parallel. False for missing or corrupt tiles.
+    bool tile(tile_archive_layer layer, int tileX, int tileY, dds_image &out, tile_decode_buffer *scratch = nullptr, Uint32 firstMip = 0)
+    {
+        const tile_archive_entry *e = entry(layer, tileX, tileY);
+        tile_archive_span span;
+        return e && mip_span(*e, firstMip, span) && tile(*e, span, file.data + e->offset + span.storedBegin, out, scratch);
+    }
+
+    // Which stored bytes of the entry's payload hold mips [firstMip, mipLevels). Coarse mips sit at the end of
+    // the chain, so a mip tail is a short read. Past the first mip a compressed tile's chunk table is read
+    // through the mapping, it's 4 bytes per chunk.
+    bool mip_span(const tile_archive_entry &e, Uint32 firstMip, tile_archive_span &span) const
+    {
+        if (firstMip >= e.mipLevels)
+            return false;
+        span.firstMip = firstMip;
+        span.storedEnd = e.storedSize;
+        span.firstChunk = 0;
+        if (e.compression == TILE_COMPRESSION_NONE)
+        {
+            span.storedBegin = span.pixelBegin = e.mipOffsets[firstMip];
+            return true;
+        }
+        span.storedBegin = span.pixelBegin = 0; // the read includes the chunk table
+        if (firstMip == 0)
+            return true;
+
+        tile_archive_chunk chunks[1024];
+        Uint32 count = tile_archive_plan_chunks(e, header->chunkSize, chunks, (Uint32)SDL_arraysize(chunks));
+        if (count != e.chunkCount || count > (Uint32)SDL_arraysize(chunks))
+            return false;
+        const Uint32 *chunkSizes = (const Uint32 *)(file.data + e.offset);
+        Uint64 stored = (Uint64)count * sizeof(Uint32);
+        Uint32 c = 0;
+        for (; c < count && chunks[c].dstOffset + chunks[c].dstSize <= e.mipOffsets[firstMip]; ++c)
+            stored += chunkSizes[c] & ~TileArchiveConstants::chunkStoredRaw;
+        if (c == count || stored > e.storedSize)
+            return false;
+        span.storedBegin = stored;
+        span.firstChunk = c;
+        span.pixelBegin = chunks[c].dstOffset;
+        return true;
+    }
+
+    // Same for the span's stored bytes read without touching the mapping, [storedBegin, storedEnd) of the
+    // payload. Uncompressed tiles point into stored itself.
+    bool tile(const tile_archive_entry &e, const tile_archive_span &span, const Uint8 *stored, dds_image &out, tile_decode_buffer *scratch = nullptr)
+    {
+        Uint32 index = (Uint32)(&e - entries);
+        out.width = SDL_max(e.width >> span.firstMip, 1u);
+        out.height = SDL_max(e.height >> span.firstMip, 1u);
+        out.mipLevels = e.mipLevels - span.firstMip;
+        out.format = e.format;
+
+        Uint64 tailOffset = e.mipOffsets[span.firstMip];
+        const Uint8 *storedEnd = stored + (span.storedEnd - span.storedBegin);
+        const Uint8 *pixels = stored;
+        if (e.compression != TILE_COMPRESSION_NONE)
+        {
+            if (!scratch || !scratch->reserve((size_t)(e.size - span.pixelBegin)))
+            {
+                SDL_Log("tile_archive: no decode buffer for compressed entry %u", index);
+                return false;
+            }
+            bool withTable = span.storedBegin == 0;
+            const Uint32 *chunkSizes = withTable ? (const Uint32 *)stored : (const Uint32 *)(file.data + e.offset);
+            const Uint8 *chunkData = withTable ? stored + (size_t)e.chunkCount * sizeof(Uint32) : stored;
+            if (!decode(e, chunkSizes, span.firstChunk, chunkData, storedEnd, scratch->data, span.pixelBegin))
+            {
+                SDL_Log("tile_archive: entry %u is corrupt", index);
+                return false;
+            }
+            pixels = scratch->data + (tailOffset - span.pixelBegin);
+        }
+
+        if (!out.layout(pixels, (size_t)(e.size - tailOffset)))
+            return false;
+        for (Uint32 mip = 0; mip < out.mipLevels; ++mip)
+        {
+            if (out.surfaces[mip].pixels != pixels + (e.mipOffsets[span.firstMip + mip] - tailOffset))
+            {
+                SDL_Log("tile_archive: entry %u has an unexpected mip layout", index);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Decodes chunks [firstChunk, chunkCount) of a compressed tile, spread over the job system. dst receives
+    // the mip chain from byte dstBase on, where chunk firstChunk starts.
+    bool decode(const tile_archive_entry &e, const Uint32 *chunkSizes, Uint32 firstChunk, const Uint8 *chunkData,
+                const Uint8 *payloadEnd, Uint8 *dst, Uint64 dstBase)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+
+        // chunk starts are a running sum, worked out up front so chunks can decode independently
+        const Uint8 *chunkStarts[1024];
+        tile_archive_chunk chunks[1024];
+        Uint32 maxChunks = (Uint32)SDL_arraysize(chunkStarts);
+        if (e.chunkCount > maxChunks || firstChunk >= e.chunkCount)
+            return false;
+        tile_archive_plan_chunks(e, header->chunkSize, chunks, maxChunks);
+        const Uint8 *read = chunkData;
+        for (Uint32 c = firstChunk; c < e.chunkCount; ++c)
+        {
+            chunkStarts[c] = read;
+            read += chunkSizes[c] & ~TileArchiveConstants::chunkStoredRaw;
+            if (read > payloadEnd)
+                return false;
+        }
+
+        std::atomic<bool> ok(true);
+        jobSystem.parallel_for((int)(e.chunkCount - firstChunk), 1, [&](int begin, int end)
+        {
+            for (int c = (int)firstChunk + begin; c < (int)firstChunk + end; ++c)
+            {
+                const tile_archive_chunk &chunk = chunks[c];
+                Uint8 *out = dst + (chunk.dstOffset - dstBase);
+                size_t dstSize = (size_t)chunk.dstSize;
+                size_t srcSize = chunkSizes[c] & ~TileArchiveConstants::chunkStoredRaw;
+                bool chunkOk;
+                if (chunkSizes[c] & TileArchiveConstants::chunkStoredRaw)
+                {
+                    chunkOk = srcSize == dstSize;
+                    if (chunkOk)
+                        SDL_memcpy(out, chunkStarts[c], dstSize);
+                }
+                else if (e.compression == TILE_COMPRESSION_HEIGHT_DELTA)
+                    chunkOk = height_codec_decode_band(chunkStarts[c], srcSize, (Uint16 *)out, (int)chunk.width, (int)chunk.rows);
+                else
+                    chunkOk = lz4_decompress_block(chunkStarts[c], srcSize, out, dstSize) == (int)dstSize;
+                if (!chunkOk)
+                    ok = false;
+            }
+        });
+
+        decodedBytes.fetch_add(e.size - dstBase, std::memory_order_relaxed);
+        decodedStoredBytes.fetch_add((Uint64)(payloadEnd - chunkData), std::memory_order_relaxed);
+        decodeTicks.fetch_add(SDL_GetPerformanceCounter() - start, std::memory_order_relaxed);
+        return ok.load();
+    }
+};
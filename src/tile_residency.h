@@ -0,0 +1,214 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+// Maps world tiles to the physical texture slots holding them. Slots keep their tile after the
+// visible window moves on, so crossing a tile boundary only loads tiles that were never resident.
+// Tiles with identical content (same content key, see tile_archive::content_key) share one slot.
+struct TileResidencyConstants
+{
+    static constexpr int maxSlots = 64;
+    static constexpr Uint32 mipTailDim = 256; // tiles load mips this size and smaller first, finer ones follow
+};
+
+// First mip of a tile's mip tail, 0 when the whole tile is no bigger than the tail
+static Uint32 tile_mip_tail_first(Uint32 width, Uint32 height, Uint32 mipLevels)
+{
+    Uint32 mip = 0;
+    while (mip + 1 < mipLevels && SDL_max(width >> mip, height >> mip) > TileResidencyConstants::mipTailDim)
+        ++mip;
+    return mip;
+}
+
+enum tile_slot_state
+{
+    TILE_SLOT_EMPTY,
+    TILE_SLOT_LOADING, // a stream worker is writing the slot's textures, it must not be reassigned
+    TILE_SLOT_RESIDENT
+};
+
+struct tile_window
+{
+    int x;
+    int y;
+    int w;
+    int h;
+
+    bool contains(int tileX, int tileY) const
+    {
+        return tileX >= x && tileX < x + w && tileY >= y && tileY < y + h;
+    }
+};
+
+struct tile_slot
+{
+    int tileX; // the tile the slot was loaded for, others with the same content may point at it too
+    int tileY;
+    Uint64 contentKey;
+    tile_slot_state state;
+    int pendingLoads; // height and albedo complete separately
+    bool cancelRequested; // no longer wanted, queued loads for it are being dropped
+    bool dropped;         // a load was dropped, the slot's contents are incomplete
+    Uint32 lastUsedFrame;
+    Uint32 minMip;      // most detailed albedo mip uploaded so far, sampling is clamped to it
+    int refinesPending; // finer mips being uploaded into a resident slot, it must not be reassigned
+    Uint64 retireFence; // signalled by the last frame whose indirection table pointed at the slot
+};
+
+// Owned by the main thread, workers report finished loads back through a queue
+struct tile_residency_cache
+{
+    tile_slot slots[TileResidencyConstants::maxSlots];
+    int slotCount;
+
+    Uint32 loadsIssued; // stats since startup
+    Uint32 tilesReused;
+    Uint32 prefetchesIssued;
+    Uint32 refinesIssued;
+    Uint32 tilesNeededNotResident; // window tiles found not resident, summed over frames
+    Uint32 tilesShared;            // window tiles that found their content in another tile's slot
+    Uint64 completedFence;         // frames up to here have retired, set by the renderer each frame
+
+    void init(int count)
+    {
+        slotCount = SDL_min(count, TileResidencyConstants::maxSlots);
+        for (int i = 0; i < slotCount; ++i)
+        {
+            slots[i].tileX = -1;
+            slots[i].tileY = -1;
+            slots[i].contentKey = 0;
+            slots[i].state = TILE_SLOT_EMPTY;
+            slots[i].pendingLoads = 0;
+            slots[i].cancelRequested = false;
+            slots[i].dropped = false;
+            slots[i].lastUsedFrame = 0;
+            slots[i].minMip = 0;
+            slots[i].refinesPending = 0;
+            slots[i].retireFence = 0;
+        }
+        loadsIssued = 0;
+        tilesReused = 0;
+        prefetchesIssued = 0;
+        refinesIssued = 0;
+        tilesNeededNotResident = 0;
+        tilesShared = 0;
+        completedFence = 0;
+    }
+
+    int find(int tileX, int tileY) const
+    {
+        for (int i = 0; i < slotCount; ++i)
+        {
+            if (slots[i].state != TILE_SLOT_EMPTY && slots[i].tileX == tileX && slots[i].tileY == tileY)
+                return i;
+        }
+        return -1;
+    }
+
+    // the tile's own slot, or failing that one holding the same content that isn't being dropped
+    int find_shared(int tileX, int tileY, Uint64 contentKey) const
+    {
+        int own = find(tileX, tileY);
+        if (own >= 0)
+            return own;
+        for (int i = 0; i < slotCount; ++i)
+        {
+            if (slots[i].state != TILE_SLOT_EMPTY && !slots[i].cancelRequested && slots[i].contentKey == contentKey)
+                return i;
+        }
+        return -1;
+    }
+
+    bool resident(int tileX, int tileY) const
+    {
+        int slot = find(tileX, tileY);
+        return slot >= 0 && slots[slot].state == TILE_SLOT_RESIDENT;
+    }
+
+    // Assigns a slot to a tile that is not cached, preferring empty slots, then the least recently
+    // used resident slot outside the window that was last used before evictBefore. Slots a frame still in
+    // flight may sample are never handed out. Returns -1 when every slot is pinned.
+    int assign(int tileX, int tileY, Uint64 contentKey, const tile_window &window, int loadCount, Uint32 evictBefore = 0xFFFFFFFFu)
+    {
+        int best = -1;
+        for (int i = 0; i < slotCount; ++i)
+        {
+            const tile_slot &slot = slots[i];
+            if (slot.retireFence > completedFence)
+                continue;
+            if (slot.state == TILE_SLOT_EMPTY)
+            {
+                best = i;
+                break;
+            }
+            if (slot.state == TILE_SLOT_LOADING || slot.refinesPending > 0 || window.contains(slot.tileX, slot.tileY) || slot.lastUsedFrame >= evictBefore)
+                continue;
+            if (best < 0 || slot.lastUsedFrame < slots[best].lastUsedFrame)
+                best = i;
+        }
+        if (best < 0)
+            return -1;
+
+        tile_slot &slot = slots[best];
+        slot.tileX = tileX;
+        slot.tileY = tileY;
+        slot.contentKey = contentKey;
+        slot.state = TILE_SLOT_LOADING;
+        slot.pendingLoads = loadCount;
+        slot.cancelRequested = false;
+        slot.dropped = false;
+        slot.minMip = 0;
+        loadsIssued++;
+        return best;
+    }
+
+    // the frame signalling fence samples the slot, it stays pinned until that frame retires. A frame marks every
+    // slot it may sample before its first assign, otherwise a slot the GPU is done with from earlier frames is
+    // handed out while this one still reads it.
+    void referenced(int slotIndex, Uint64 fence)
+    {
+        slots[slotIndex].retireFence = SDL_max(slots[slotIndex].retireFence, fence);
+    }
+
+    // minMip is the most detailed mip the load uploaded
+    void load_finished(int slotIndex, bool dropped = false, Uint32 minMip = 0)
+    {
+        tile_slot &slot = slots[slotIndex];
+        if (slot.state != TILE_SLOT_LOADING)
+            return;
+        slot.dropped |= dropped;
+        slot.minMip = SDL_max(slot.minMip, minMip);
+        if (--slot.pendingLoads <= 0)
+            slot.state = slot.dropped ? TILE_SLOT_EMPTY : TILE_SLOT_RESIDENT;
+    }
+
+    // a resident slot still clamped to its mip tail, and nothing already uploading the rest
+    bool needs_refine(int slotIndex) const
+    {
+        const tile_slot &slot = slots[slotIndex];
+        return slot.state == TILE_SLOT_RESIDENT && slot.minMip > 0 && slot.refinesPending == 0;
+    }
+
+    void refine_requested(int slotIndex)
+    {
+        slots[slotIndex].refinesPending++;
+        refinesIssued++;
+    }
+
+    // a dropped refine leaves the slot on its mip tail, it's asked for again once the tile is wanted
+    void refine_finished(int slotIndex, bool dropped)
+    {
+        tile_slot &slot = slots[slotIndex];
+        slot.refinesPending = SDL_max(slot.refinesPending - 1, 0);
+        if (!dropped)
+            slot.minMip = 0;
+    }
+
+    int resident_count() const
+    {
+        int count = 0;
+        for (int i = 0; i < slotCount; ++i)
+            count += (slots[i].state == TILE_SLOT_RESIDENT) ? 1 : 0;
+        return count;
+    }
+};
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include "stream_policy.h"
+#include "tile_residency.h"
+#include "v3.h"
+
+// The per-frame tile streaming step, apart from the renderer so tests fly it headless. A frame pins the
+// slots the published table points at, takes over the loads that landed, gives every tile of the wanted
+// window a slot, prefetches along the camera's predicted path, drops loads nobody wants any more and
+// publishes the window once every tile in it is resident. The step only decides: the caller issues the
+// loads it asks for, supersedes the slots it drops and writes the table it publishes.
+struct TileStreamingConstants
+{
+    static constexpr int maxWindowTiles = 64;
+    static constexpr int maxRequests = 2 * TileResidencyConstants::maxSlots; // a new tile and a refine per slot
+};
+
+// What the step asks about the world, main.cpp answers from the tile archive
+struct tile_stream_world
+{
+    Uint32 (*tile_loads)(void *context, int x, int y);  // layers a slot loads, 0 for holes and tiles stored as values
+    Uint64 (*content_key)(void *context, int x, int y); // tiles with the same key share a slot
+    void *context;
+};
+
+struct tile_stream_request
+{
+    int slot;
+    int x;
+    int y;
+    Uint32 layers; // of a tile new to the slot, 0 for the full albedo chain of a slot on its mip tail
+    bool speculative;
+};
+
+struct tile_stream_window_tile
+{
+    int x;
+    int y;
+    int slot;    // -1 without one, a tile with nothing to load never takes one
+    bool shared; // the slot was loaded for another tile with the same content
+};
+
+struct tile_streamer
+{
+    tile_residency_cache *cache;
+    tile_stream_world world;
+    tile_window extent; // tiles the world spans, the window stays inside
+    int windowWidth;
+    float tileWorldSize;
+
+    bool prefetch;
+    float prefetchLookAheadSeconds;
+    stream_speed_policy policy; // coarser and further ahead as the camera speeds up
+    v3 velocity;                // smoothed, for prediction
+    v3 lastPos;
+
+    tile_window window; // wanted this frame
+    bool windowMoved;   // since the previous frame
+    tile_stream_window_tile windowTiles[TileStreamingConstants::maxWindowTiles];
+    int windowTileCount;
+    int notResident;    // window tiles without a resident slot this frame
+    bool demandLoading; // and so some are loading, predictions only keep what they have
+    bool starved;       // a window tile found no free slot, the published window holds them
+
+    // the window the table was last published for and the slots it points at, -1 drawn flat
+    tile_window published;
+    int publishedSlots[TileStreamingConstants::maxWindowTiles];
+    bool tableDirty; // loads landed since, or a forced table waits on its missing tiles
+
+    // this frame's loads to issue, in order, and the slots whose queued loads have to be dropped
+    tile_stream_request requests[TileStreamingConstants::maxRequests];
+    int requestCount;
+    int superseded[TileResidencyConstants::maxSlots];
+    int supersededCount;
+
+    Uint32 tablesPublished; // stats since startup
+    Uint32 tablesForced;
+    Uint32 tablesDeferred; // frames the wanted window waited on its tiles
+
+    void init(tile_residency_cache *_cache, const tile_stream_world &_world, const tile_window &_extent, int _windowWidth,
+              float _tileWorldSize, v3 pos)
+    {
+        cache = _cache;
+        world = _world;
+        extent = _extent;
+        windowWidth = SDL_min(_windowWidth, 8);
+        tileWorldSize = _tileWorldSize;
+        prefetch = true;
+        prefetchLookAheadSeconds = 2.0f;
+        policy = stream_speed_policy();
+        velocity = {};
+        lastPos = pos;
+        window = window_at(pos);
+        windowMoved = false;
+        windowTileCount = 0;
+        notResident = 0;
+        demandLoading = false;
+        starved = false;
+        published = {};
+        for (int i = 0; i < TileStreamingConstants::maxWindowTiles; ++i)
+            publishedSlots[i] = -1;
+        tableDirty = true;
+        requestCount = 0;
+        supersededCount = 0;
+        tablesPublished = 0;
+        tablesForced = 0;
+        tablesDeferred = 0;
+    }
+
+    // window of tiles centred on a position, clamped to the world's extent
+    tile_window window_at(v3 pos) const
+    {
+        int halfW = windowWidth / 2;
+        tile_window w = {};
+        w.x = SDL_clamp((int)SDL_floorf(pos.x / tileWorldSize) - halfW, extent.x, SDL_max(extent.x + extent.w - windowWidth, extent.x));
+        w.y = SDL_clamp((int)SDL_floorf(pos.z / tileWorldSize) - halfW, extent.y, SDL_max(extent.y + extent.h - windowWidth, extent.y));
+        w.w = windowWidth;
+        w.h = windowWidth;
+        return w;
+    }
+
+    // lower loads first: by distance, speculative ones behind every demand load, refines behind new tiles
+    float priority(const tile_stream_request &request, v3 pos) const
+    {
+        float centreX = ((float)request.x + 0.5f) * tileWorldSize - pos.x;
+        float centreZ = ((float)request.y + 0.5f) * tileWorldSize - pos.z;
+        float distance = SDL_sqrtf(centreX * centreX + centreZ * centreZ);
+        if (request.layers == 0)
+            return distance + (request.speculative ? 2.0e9f : 1.0e6f);
+        return distance + (request.speculative ? 1.0e9f : 0.0f);
+    }
+
+    // the slots a table samples stay pinned until the frame signalling fence retires
+    void pin_published(Uint64 fence)
+    {
+        for (int i = 0; i < published.w * published.h; ++i)
+        {
+            if (publishedSlots[i] >= 0)
+                cache->referenced(publishedSlots[i], fence);
+        }
+    }
+
+    // Starts a frame at pos once frames up to completedFence have retired. Unless a new table goes out this
+    // frame samples the published slots too, they are pinned before anything is assigned.
+    void begin_frame(v3 pos, float deltaTime, Uint64 completedFence, Uint64 frameFence)
+    {
+        tile_window wanted = window_at(pos);
+        windowMoved = wanted.x != window.x || wanted.y != window.y;
+        window = wanted;
+        cache->completedFence = completedFence;
+        policy.update(velocity, tileWorldSize, deltaTime);
+        pin_published(frameFence);
+        requestCount = 0;
+        supersededCount = 0;
+    }
+
+    // a load the caller issued has landed, or was dropped. minMip is the finest albedo mip it uploaded
+    void landed(int slot, bool refine, bool dropped, Uint32 minMip)
+    {
+        if (refine)
+            cache->refine_finished(slot, dropped);
+        else
+            cache->load_finished(slot, dropped, minMip);
+        tableDirty = true;
+    }
+
+    // every window tile gets a slot, new ones a load. Slots this frame already touched aren't evicted, a
+    // shared one can belong to a tile outside the window.
+    void stream_window(Uint32 frame)
+    {
+        windowTileCount = 0;
+        notResident = 0;
+        demandLoading = false;
+        starved = false;
+        for (int wy = 0; wy < window.h; ++wy)
+        {
+            for (int wx = 0; wx < window.w; ++wx)
+            {
+                tile_stream_window_tile &tile = windowTiles[windowTileCount++];
+                tile.x = window.x + wx;
+                tile.y = window.y + wy;
+                tile.slot = -1;
+                tile.shared = false;
+                Uint32 loads = world.tile_loads(world.context, tile.x, tile.y);
+                if (loads == 0)
+                    continue; // drawn from the tile table alone
+                Uint64 contentKey = world.content_key(world.context, tile.x, tile.y);
+                int slot = cache->find_shared(tile.x, tile.y, contentKey);
+                tile.shared = slot >= 0 && (cache->slots[slot].tileX != tile.x || cache->slots[slot].tileY != tile.y);
+                if (slot < 0)
+                {
+                    slot = cache->assign(tile.x, tile.y, contentKey, window, layer_count(loads), frame);
+                    if (slot >= 0)
+                        request(slot, tile.x, tile.y, loads, false);
+                    else
+                        starved = true;
+                }
+                else if (windowMoved)
+                {
+                    cache->tilesReused++;
+                    cache->tilesShared += tile.shared ? 1 : 0;
+                }
+                tile.slot = slot;
+                if (slot >= 0)
+                    cache->slots[slot].lastUsedFrame = frame;
+                if (slot < 0 || cache->slots[slot].state != TILE_SLOT_RESIDENT)
+                {
+                    notResident++;
+                    demandLoading = true;
+                }
+                else if (cache->needs_refine(slot) && !policy.defer_refines())
+                {
+                    refine(slot, tile.x, tile.y, false);
+                }
+            }
+        }
+        cache->tilesNeededNotResident += (Uint32)notResident;
+    }
+
+    // Moves the camera on to pos and prefetches the windows along its predicted path. Speculative loads only
+    // go out while no demand load is waiting, and never evict anything the window or an earlier prediction
+    // touched this frame.
+    void stream_prediction(v3 pos, float deltaTime, Uint32 frame)
+    {
+        if (deltaTime > 0.0f)
+        {
+            v3 frameVelocity = (pos - lastPos) * (1.0f / deltaTime);
+            velocity = velocity + (frameVelocity - velocity) * SDL_min(deltaTime * 4.0f, 1.0f);
+        }
+        lastPos = pos;
+        if (!prefetch)
+            return;
+        // faster flights look further ahead, with more points on the path, sampled every half tile so fast
+        // flights prefetch each window on the way
+        v3 travel = velocity * (prefetchLookAheadSeconds * policy.look_ahead_scale());
+        float travelDist = SDL_sqrtf(travel.x * travel.x + travel.z * travel.z);
+        int samples = SDL_min((int)SDL_ceilf(travelDist / (tileWorldSize * 0.5f)), policy.prefetch_samples());
+        for (int i = 1; i <= samples; ++i)
+        {
+            tile_window predicted = window_at(pos + travel * ((float)i / (float)samples));
+            for (int wy = 0; wy < predicted.h; ++wy)
+            {
+                for (int wx = 0; wx < predicted.w; ++wx)
+                {
+                    int x = predicted.x + wx;
+                    int y = predicted.y + wy;
+                    Uint32 loads = world.tile_loads(world.context, x, y);
+                    if (loads == 0)
+                        continue;
+                    Uint64 contentKey = world.content_key(world.context, x, y);
+                    int slot = cache->find_shared(x, y, contentKey);
+                    if (slot < 0)
+                    {
+                        if (demandLoading)
+                            continue; // predictions only keep what they already have
+                        slot = cache->assign(x, y, contentKey, window, layer_count(loads), frame);
+                        if (slot < 0)
+                            continue; // no spare slot left this frame
+                        request(slot, x, y, loads, true);
+                        cache->prefetchesIssued++;
+                    }
+                    else if (!demandLoading && !policy.defer_refines() && cache->needs_refine(slot))
+                    {
+                        refine(slot, x, y, true);
+                    }
+                    cache->slots[slot].lastUsedFrame = frame;
+                }
+            }
+        }
+    }
+
+    // loads for tiles that neither the window nor a prediction wants any more are dropped before they start
+    void drop_unwanted(Uint32 frame)
+    {
+        for (int i = 0; i < cache->slotCount; ++i)
+        {
+            tile_slot &slot = cache->slots[i];
+            if (slot.state == TILE_SLOT_LOADING && !slot.cancelRequested && slot.lastUsedFrame != frame)
+            {
+                slot.cancelRequested = true;
+                superseded[supersededCount++] = i;
+            }
+            else if (slot.state == TILE_SLOT_RESIDENT && slot.refinesPending > 0 && slot.lastUsedFrame != frame)
+            {
+                superseded[supersededCount++] = i;
+            }
+        }
+    }
+
+    // Window slot -> physical slot. A new window is published only once every tile in it is resident, frames
+    // keep drawing the last complete one until then so old and new tiles never mix. If the published window
+    // pins the slots the new one needs it goes out early, its tiles still loading drawn flat. Returns true
+    // when the table has to be written, and pins the slots it points at for the frame signalling fence.
+    bool publish(Uint64 frameFence)
+    {
+        tile_window publishWindow = published;
+        bool windowComplete = notResident == 0;
+        if (windowComplete || starved || published.w == 0)
+            publishWindow = window;
+        bool moved = publishWindow.x != published.x || publishWindow.y != published.y || published.w == 0;
+        bool write = moved || tableDirty;
+        if (write)
+        {
+            if (moved)
+            {
+                tablesPublished++;
+                tablesForced += windowComplete ? 0 : 1;
+            }
+            for (int wy = 0; wy < publishWindow.h; ++wy)
+            {
+                for (int wx = 0; wx < publishWindow.w; ++wx)
+                {
+                    int x = publishWindow.x + wx;
+                    int y = publishWindow.y + wy;
+                    int slot = world.tile_loads(world.context, x, y) == 0 ? -1 : cache->find_shared(x, y, world.content_key(world.context, x, y));
+                    if (slot >= 0 && cache->slots[slot].state != TILE_SLOT_RESIDENT)
+                        slot = -1; // still being written, only reachable by a forced publish
+                    publishedSlots[wx + wy * publishWindow.w] = slot;
+                }
+            }
+            published = publishWindow;
+            // a forced table is rebuilt as its missing tiles land
+            tableDirty = !windowComplete && publishWindow.x == window.x && publishWindow.y == window.y;
+        }
+        else
+        {
+            tablesDeferred += (publishWindow.x != window.x || publishWindow.y != window.y) ? 1 : 0;
+        }
+        pin_published(frameFence);
+        return write;
+    }
+
+    static int layer_count(Uint32 layers)
+    {
+        int count = 0;
+        for (; layers; layers &= layers - 1)
+            count++;
+        return count;
+    }
+
+    void request(int slot, int x, int y, Uint32 layers, bool speculative)
+    {
+        requests[requestCount++] = {slot, x, y, layers, speculative};
+    }
+
+    void refine(int slot, int x, int y, bool speculative)
+    {
+        cache->refine_requested(slot);
+        requests[requestCount++] = {slot, x, y, 0, speculative};
+    }
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+// Fence an upload ring retires against. The renderer wraps its copy queue fence, anything that counts up
+// will do, a plain counter stands in for the GPU when the allocator is exercised on its own.
+struct upload_fence
+{
+    Uint64 (*completed)(void *context);
+    void (*wait)(void *context, Uint64 value); // returns once completed reaches value
+    void *context;
+};
+
+struct UploadRingConstants
+{
+    static constexpr int maxBatches = 64; // closed batches still waiting on the fence
+};
+
+enum upload_ring_status
+{
+    UPLOAD_RING_OK,
+    UPLOAD_RING_WAIT,     // the space frees once the fence reaches waitValue
+    UPLOAD_RING_SUBMIT,   // held by allocations that haven't been closed yet, submit them first
+    UPLOAD_RING_TOO_BIG   // bigger than the whole ring
+};
+
+// Hands out a persistent upload buffer front to back. Allocations are grouped into batches that are closed
+// with the fence value their copies finish at, a batch's memory comes back once the fence gets there.
+// Positions only grow, an allocation sits at its position modulo capacity and never straddles the end.
+struct upload_ring_allocator
+{
+    struct batch_mark
+    {
+        Uint64 fenceValue;
+        Uint64 end; // head when the batch was closed
+    };
+
+    Uint64 capacity; // multiple of every alignment asked for
+    Uint64 head;     // next free position
+    Uint64 tail;     // everything before it has retired
+    batch_mark batches[UploadRingConstants::maxBatches];
+    int firstBatch;
+    int batchCount;
+    upload_fence fence;
+
+    Uint32 fenceWaits; // stats since startup, allocations told to wait for the GPU
+
+    void init(Uint64 _capacity, upload_fence _fence)
+    {
+        capacity = _capacity;
+        head = 0;
+        tail = 0;
+        firstBatch = 0;
+        batchCount = 0;
+        fence = _fence;
+        fenceWaits = 0;
+    }
+
+    Uint64 used() const { return head - tail; }
+
+    // frees every closed batch the fence has passed
+    void retire()
+    {
+        Uint64 completed = fence.completed(fence.context);
+        while (batchCount > 0 && batches[firstBatch].fenceValue <= completed)
+        {
+            tail = SDL_max(tail, batches[firstBatch].end);
+            firstBatch = (firstBatch + 1) % UploadRingConstants::maxBatches;
+            batchCount--;
+        }
+    }
+
+    // Never blocks, so callers can hold a lock around it and wait for the fence after letting go
+    upload_ring_status try_allocate(Uint64 size, Uint64 alignment, Uint64 &offset, Uint64 &waitValue)
+    {
+        if (size > capacity)
+            return UPLOAD_RING_TOO_BIG;
+        Uint64 pos = (head + alignment - 1) & ~(alignment - 1);
+        if (pos % capacity + size > capacity)
+            pos = (pos / capacity + 1) * capacity; // would straddle the end, start the next lap
+        if (head == tail)
+            tail = pos; // nothing outstanding, the whole ring is free from here
+        if (pos + size - tail > capacity)
+            retire();
+        if (pos + size - tail <= capacity)
+        {
+            head = pos + size;
+            offset = pos % capacity;
+            return UPLOAD_RING_OK;
+        }
+        // the oldest closed batch whose retirement makes room
+        for (int i = 0; i < batchCount; ++i)
+        {
+            const batch_mark &mark = batches[(firstBatch + i) % UploadRingConstants::maxBatches];
+            if (pos + size - mark.end <= capacity)
+            {
+                waitValue = mark.fenceValue;
+                fenceWaits++;
+                return UPLOAD_RING_WAIT;
+            }
+        }
+        return UPLOAD_RING_SUBMIT;
+    }
+
+    // everything allocated since the previous close is free once the fence reaches fenceValue
+    void close(Uint64 fenceValue)
+    {
+        if (batchCount == UploadRingConstants::maxBatches)
+        {
+            fenceWaits++;
+            fence.wait(fence.context, batches[firstBatch].fenceValue);
+            retire();
+        }
+        batch_mark &mark = batches[(firstBatch + batchCount) % UploadRingConstants::maxBatches];
+        mark.fenceValue = fenceValue;
+        mark.end = head;
+        batchCount++;
+    }
+};
@@ -0,0 +1,509 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include "clipmap.h"
+#include "clipmap_heights.h"
+#include "dds_file.h"
+#include "lz4_block.h"
+#include "mapped_file.h"
+#include "world_manifest.h"
+
+// Page granular virtual texture, written by pack_tiles.py --pages.
+//
+// Tiles are in the tile archive's manifest order, so the page file only has pages for tiles that exist.
+// Every tile mip down to a single page is cut into pageSize^2 pages, each stored with pageBorder texels
+// of its neighbours (taken from the adjacent tiles at tile edges) so filtering never reads past a page.
+// The physical page cache is a texture array with one page per slice. The page table covers the
+// streamed window with one mip per page mip, and every entry names the page itself or, until that
+// arrives, its finest resident ancestor, so a lookup is a single fetch.
+//
+// Albedo only. Heights stream as whole R16 tiles through the tile cache, paging them is its own item in
+// BACKLOG.md.
+struct VirtualTextureConstants
+{
+    static constexpr Uint32 magic = 0x47505456; // "VTPG"
+    static constexpr Uint32 version = 2;
+    static constexpr int pageSize = 128;  // shaders.hlsl has the same two values
+    static constexpr int pageBorder = 4;  // one BCn block
+    static constexpr int physicalPageDim = pageSize + 2 * pageBorder;
+    static constexpr int maxMips = 8;
+    static constexpr int physicalPages = 1024;     // cache slices, 72 MB of RGBA8 or 9 MB of BC1
+    static constexpr int hashSize = 4096;          // power of two, a quarter full at most
+    static constexpr int maxRequests = 4096;       // footprint pages considered per frame
+    static constexpr int maxLoadsPerFrame = 64;    // new page loads started per frame
+    static constexpr int maxUploadsPerFrame = 32;  // finished pages copied into the cache per frame
+    static constexpr Uint32 pageLz4 = 1;           // vt_page_entry::flags
+    static constexpr Uint32 tableEmpty = 0xFFFFFFFFu;
+};
+
+struct vt_page_file_header
+{
+    Uint32 magic;
+    Uint32 version;
+    Uint32 tileCount; // the manifest's
+    Uint32 tileDim; // texels per tile side at mip 0
+    Uint32 pageSize;
+    Uint32 pageBorder;
+    Uint32 mipCount; // page mips per tile, the last one holds the whole tile in one page
+    Uint32 format;   // DXGI_FORMAT, uncompressed or BCn
+    Uint32 pageBytes; // one page with its border, decoded
+    Uint32 pagesPerTile;
+    Uint64 manifestHash;    // world_manifest::keysHash of the archive it was cut for
+    Uint64 directoryOffset; // tileCount * pagesPerTile entries: tiles in manifest order, then mips, then row major pages
+};
+
+struct vt_page_entry
+{
+    Uint64 offset; // 0 for pages of tiles without albedo
+    Uint32 storedSize;
+    Uint32 flags;
+};
+
+static_assert(sizeof(vt_page_file_header) == 56, "vt_page_file_header must match pack_tiles.py");
+static_assert(sizeof(vt_page_entry) == 16, "vt_page_entry must match pack_tiles.py");
+
+// mip and signed page coordinates at that mip across the whole world, 28 bits each
+static inline Uint64 vt_page_key(int mip, int pageX, int pageY)
+{
+    return ((Uint64)mip << 56) | ((Uint64)((Uint32)pageY & 0x0FFFFFFFu) << 28) | (Uint64)((Uint32)pageX & 0x0FFFFFFFu);
+}
+
+static inline int vt_page_key_mip(Uint64 key) { return (int)(key >> 56); }
+static inline int vt_page_key_x(Uint64 key) { return (int)((Uint32)key << 4) >> 4; }
+static inline int vt_page_key_y(Uint64 key) { return (int)((Uint32)(key >> 28) << 4) >> 4; }
+
+struct vt_page_file
+{
+    mapped_file file;
+    const vt_page_file_header *header = nullptr;
+    const vt_page_entry *entries = nullptr;
+    const world_manifest *manifest = nullptr;
+    int pagesPerTileSide = 0; // at mip 0
+    int mipFirstPage[VirtualTextureConstants::maxMips];
+    Uint32 blockDim = 1;      // 4 for BCn
+    Uint32 rowBytes = 0;      // one row of blocks (or texels) of a page
+    Uint32 rows = 0;
+
+    bool open(const wchar_t *filename, const world_manifest &_manifest)
+    {
+        if (!file.open(filename))
+            return false;
+
+        header = (const vt_page_file_header *)file.data;
+        if (file.size < sizeof(vt_page_file_header) || header->magic != VirtualTextureConstants::magic ||
+            header->version != VirtualTextureConstants::version)
+        {
+            SDL_Log("vt_page_file: %ls is not a version %u page file", filename, VirtualTextureConstants::version);
+            close();
+            return false;
+        }
+        if (header->tileCount != _manifest.tileCount || header->manifestHash != _manifest.keysHash)
+        {
+            SDL_Log("vt_page_file: %ls was cut for another tile archive, run pack_tiles.py --pages again", filename);
+            close();
+            return false;
+        }
+        if (header->pageSize != (Uint32)VirtualTextureConstants::pageSize || header->pageBorder != (Uint32)VirtualTextureConstants::pageBorder ||
+            header->mipCount == 0 || header->mipCount > (Uint32)VirtualTextureConstants::maxMips ||
+            (header->tileDim / header->pageSize) >> (header->mipCount - 1) != 1 || header->tileDim % header->pageSize != 0)
+        {
+            SDL_Log("vt_page_file: unsupported page layout (%u texel pages, %u border, %u mips)", header->pageSize, header->pageBorder, header->mipCount);
+            close();
+            return false;
+        }
+
+        // pages are copied straight into texture array slices, so the format decides the row layout
+        Uint32 blockBytes = dds_block_bytes(header->format);
+        blockDim = blockBytes ? 4 : 1;
+        size_t pitch = 0;
+        size_t bytes = dds_surface_size(header->format, VirtualTextureConstants::physicalPageDim, VirtualTextureConstants::physicalPageDim, &pitch);
+        rowBytes = (Uint32)pitch;
+        rows = VirtualTextureConstants::physicalPageDim / blockDim;
+        if (bytes == 0 || bytes != header->pageBytes)
+        {
+            SDL_Log("vt_page_file: format %u pages should be %u bytes", header->format, (Uint32)bytes);
+            close();
+            return false;
+        }
+
+        pagesPerTileSide = (int)(header->tileDim / header->pageSize);
+        Uint32 pages = 0;
+        for (Uint32 mip = 0; mip < header->mipCount; ++mip)
+        {
+            mipFirstPage[mip] = (int)pages;
+            Uint32 side = (Uint32)pagesPerTileSide >> mip;
+            pages += side * side;
+        }
+        Uint64 entryCount = (Uint64)header->tileCount * header->pagesPerTile;
+        if (pages != header->pagesPerTile || header->directoryOffset > file.size ||
+            entryCount > (file.size - header->directoryOffset) / sizeof(vt_page_entry))
+        {
+            SDL_Log("vt_page_file: truncated directory");
+            close();
+            return false;
+        }
+        entries = (const vt_page_entry *)(file.data + header->directoryOffset);
+
+        for (Uint64 i = 0; i < entryCount; ++i)
+        {
+            const vt_page_entry &e = entries[i];
+            bool lz4 = (e.flags & VirtualTextureConstants::pageLz4) != 0;
+            if (e.offset != 0 && (e.offset > file.size || e.storedSize > file.size - e.offset ||
+                                  (!lz4 && e.storedSize != header->pageBytes) || (lz4 && e.storedSize == 0)))
+            {
+                SDL_Log("vt_page_file: page %llu lies outside the file", (unsigned long long)i);
+                close();
+                return false;
+            }
+        }
+        manifest = &_manifest;
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        header = nullptr;
+        entries = nullptr;
+        manifest = nullptr;
+    }
+
+    int pages_per_side(int mip) const { return SDL_max(pagesPerTileSide >> mip, 1); }
+
+    // Entry of a page in world page coordinates at its mip, null for tiles the world doesn't have
+    const vt_page_entry *page(int mip, int pageX, int pageY) const
+    {
+        if (!header || mip < 0 || mip >= (int)header->mipCount)
+            return nullptr;
+        int side = pages_per_side(mip);
+        int tileX = floor_div(pageX, side);
+        int tileY = floor_div(pageY, side);
+        int tile = manifest->find(tileX, tileY);
+        if (tile < 0)
+            return nullptr;
+        int localX = pageX - tileX * side;
+        int localY = pageY - tileY * side;
+        const vt_page_entry &e = entries[(size_t)tile * header->pagesPerTile + (size_t)mipFirstPage[mip] + (size_t)(localY * side + localX)];
+        return e.offset != 0 ? &e : nullptr;
+    }
+
+    // Decodes a page's stored bytes (from the mapping or a copy of them) into pageBytes at dst
+    bool read_page(const vt_page_entry &e, const Uint8 *stored, Uint8 *dst) const
+    {
+        if (!(e.flags & VirtualTextureConstants::pageLz4))
+        {
+            SDL_memcpy(dst, stored, header->pageBytes);
+            return true;
+        }
+        return lz4_decompress_block(stored, e.storedSize, dst, header->pageBytes) == (int)header->pageBytes;
+    }
+};
+
+enum vt_page_state
+{
+    VT_PAGE_EMPTY,
+    VT_PAGE_LOADING,
+    VT_PAGE_RESIDENT,
+};
+
+struct vt_physical_page
+{
+    Uint64 key;
+    vt_page_state state;
+    bool cancelRequested; // left the footprint while loading, its queued read is being dropped
+    Uint32 lastUsedFrame;
+};
+
+// Physical pages and the key -> page map, owned by the main thread like tile_residency_cache
+struct vt_page_cache
+{
+    vt_physical_page pages[VirtualTextureConstants::physicalPages];
+    Sint16 hash[VirtualTextureConstants::hashSize]; // linear probing, -1 is a free bucket
+
+    Uint32 pagesRequested; // stats since startup
+    Uint32 pagesLoaded;
+    Uint32 pagesEvicted;
+    Uint32 pagesFailed;
+
+    void init()
+    {
+        for (int i = 0; i < VirtualTextureConstants::physicalPages; ++i)
+        {
+            pages[i].key = 0;
+            pages[i].state = VT_PAGE_EMPTY;
+            pages[i].cancelRequested = false;
+            pages[i].lastUsedFrame = 0;
+        }
+        for (int i = 0; i < VirtualTextureConstants::hashSize; ++i)
+            hash[i] = -1;
+        pagesRequested = 0;
+        pagesLoaded = 0;
+        pagesEvicted = 0;
+        pagesFailed = 0;
+    }
+
+    static Uint32 bucket(Uint64 key)
+    {
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDull;
+        key ^= key >> 33;
+        return (Uint32)key & (VirtualTextureConstants::hashSize - 1);
+    }
+
+    int find(Uint64 key) const
+    {
+        for (Uint32 b = bucket(key);; b = (b + 1) & (VirtualTextureConstants::hashSize - 1))
+        {
+            int page = hash[b];
+            if (page < 0)
+                return -1;
+            if (pages[page].key == key)
+                return page;
+        }
+    }
+
+    void insert(int page)
+    {
+        Uint32 b = bucket(pages[page].key);
+        while (hash[b] >= 0)
+            b = (b + 1) & (VirtualTextureConstants::hashSize - 1);
+        hash[b] = (Sint16)page;
+    }
+
+    // backward shift deletion, later entries of the probe run move up so lookups never stop early
+    void remove(int page)
+    {
+        const Uint32 mask = VirtualTextureConstants::hashSize - 1;
+        Uint32 b = bucket(pages[page].key);
+        while (hash[b] != page)
+            b = (b + 1) & mask;
+        Uint32 hole = b;
+        for (Uint32 next = (hole + 1) & mask; hash[next] >= 0; next = (next + 1) & mask)
+        {
+            Uint32 home = bucket(pages[hash[next]].key);
+            // move it up unless its home lies cyclically in (hole, next]
+            if (((next - home) & mask) >= ((next - hole) & mask))
+            {
+                hash[hole] = hash[next];
+                hole = next;
+            }
+        }
+        hash[hole] = -1;
+    }
+
+    // Takes the least recently used page nothing wanted this frame, -1 when every page is in use
+    int acquire(Uint64 key, Uint32 frame)
+    {
+        int best = -1;
+        for (int i = 0; i < VirtualTextureConstants::physicalPages; ++i)
+        {
+            const vt_physical_page &page = pages[i];
+            if (page.state == VT_PAGE_EMPTY)
+            {
+                best = i;
+                break;
+            }
+            if (page.state == VT_PAGE_LOADING || page.lastUsedFrame == frame)
+                continue;
+            if (best < 0 || page.lastUsedFrame < pages[best].lastUsedFrame)
+                best = i;
+        }
+        if (best < 0)
+            return -1;
+
+        vt_physical_page &page = pages[best];
+        if (page.state != VT_PAGE_EMPTY)
+        {
+            remove(best);
+            pagesEvicted++;
+        }
+        page.key = key;
+        page.state = VT_PAGE_LOADING;
+        page.cancelRequested = false;
+        page.lastUsedFrame = frame;
+        insert(best);
+        pagesRequested++;
+        return best;
+    }
+
+    void load_finished(int index, bool ok)
+    {
+        vt_physical_page &page = pages[index];
+        if (page.state != VT_PAGE_LOADING)
+            return;
+        if (ok)
+        {
+            page.state = VT_PAGE_RESIDENT;
+            pagesLoaded++;
+            return;
+        }
+        pagesFailed += page.cancelRequested ? 0 : 1;
+        remove(index);
+        page.state = VT_PAGE_EMPTY;
+    }
+
+    int resident_count() const
+    {
+        int count = 0;
+        for (int i = 0; i < VirtualTextureConstants::physicalPages; ++i)
+            count += pages[i].state == VT_PAGE_RESIDENT ? 1 : 0;
+        return count;
+    }
+};
+
+// CPU copy of the page table over the streamed window, uploaded whole whenever it changes.
+// Entries are the cache slice in the low 16 bits and the page's mip above them.
+struct vt_page_table
+{
+    int dim = 0; // pages per side at mip 0
+    int mipCount = 0;
+    Uint32 *memory = nullptr;
+    Uint32 *mips[VirtualTextureConstants::maxMips];
+    bool dirty = true;
+
+    bool init(int _dim, int _mipCount)
+    {
+        dim = _dim;
+        mipCount = _mipCount;
+        size_t total = 0;
+        for (int mip = 0; mip < mipCount; ++mip)
+            total += (size_t)SDL_max(dim >> mip, 1) * SDL_max(dim >> mip, 1);
+        memory = (Uint32 *)SDL_malloc(total * sizeof(Uint32));
+        if (!memory)
+            return false;
+        Uint32 *write = memory;
+        for (int mip = 0; mip < mipCount; ++mip)
+        {
+            mips[mip] = write;
+            write += (size_t)SDL_max(dim >> mip, 1) * SDL_max(dim >> mip, 1);
+        }
+        return true;
+    }
+
+    void release()
+    {
+        SDL_free(memory);
+        memory = nullptr;
+    }
+
+    // windowPageX/Y: the window's first page at mip 0, in world pages
+    void rebuild(const vt_page_cache &cache, int windowPageX, int windowPageY)
+    {
+        for (int mip = mipCount - 1; mip >= 0; --mip)
+        {
+            int side = SDL_max(dim >> mip, 1);
+            int parentSide = SDL_max(dim >> (mip + 1), 1);
+            for (int y = 0; y < side; ++y)
+            {
+                for (int x = 0; x < side; ++x)
+                {
+                    int page = cache.find(vt_page_key(mip, (windowPageX >> mip) + x, (windowPageY >> mip) + y));
+                    Uint32 entry;
+                    if (page >= 0 && cache.pages[page].state == VT_PAGE_RESIDENT)
+                        entry = (Uint32)page | ((Uint32)mip << 16);
+                    else if (mip + 1 < mipCount)
+                        entry = mips[mip + 1][(y >> 1) * parentSide + (x >> 1)];
+                    else
+                        entry = VirtualTextureConstants::tableEmpty;
+                    mips[mip][y * side + x] = entry;
+                }
+            }
+        }
+        dirty = false;
+    }
+};
+
+struct vt_page_request
+{
+    Uint64 key;
+    float priority; // lower first, like stream requests
+};
+
+static int vt_page_request_compare(const void *a, const void *b)
+{
+    float pa = ((const vt_page_request *)a)->priority;
+    float pb = ((const vt_page_request *)b)->priority;
+    return (pa > pb) - (pa < pb);
+}
+
+// Where the camera needs pages, in the window's own coordinates (tile (0, 0) of the window at the origin)
+struct vt_footprint_params
+{
+    v3 cameraPos;
+    const frustum *view;
+    float pixelsPerRadian; // screen height / (2 tan(fovY / 2))
+    float tileWorldSize;
+    int windowX; // first tile of the window, world tiles
+    int windowY;
+    int windowW;
+    int windowH;
+    float minHeight;
+    float maxHeight;
+    float planetRadius; // terrain drops by d^2 / 2R away from the camera
+};
+
+// Walks each window tile's page quadtree from the single top page down. A page is wanted while one screen
+// pixel at its nearest point covers less than one texel of the mip above it, and pages outside the frustum
+// are dropped, except the top ones, which stay as the fallback for everything under them.
+static int vt_collect_footprint(const vt_page_file &pages, const vt_footprint_params &params, vt_page_request *out, int maxOut)
+{
+    struct node
+    {
+        int mip;
+        int x; // page within the tile at mip
+        int y;
+    };
+    const int top = (int)pages.header->mipCount - 1;
+    const float texelWorld = params.tileWorldSize / (float)pages.header->tileDim;
+    node stack[4 * VirtualTextureConstants::maxMips];
+    int count = 0;
+
+    for (int wy = 0; wy < params.windowH; ++wy)
+    {
+        for (int wx = 0; wx < params.windowW; ++wx)
+        {
+            int tileX = params.windowX + wx;
+            int tileY = params.windowY + wy;
+            if (!pages.page(top, tileX, tileY))
+                continue; // missing tile
+
+            int depth = 0;
+            stack[depth++] = {top, 0, 0};
+            while (depth > 0 && count < maxOut)
+            {
+                node n = stack[--depth];
+                int side = pages.pages_per_side(n.mip);
+                float pageWorld = params.tileWorldSize / (float)side;
+                v3 boxMin = {(float)wx * params.tileWorldSize + (float)n.x * pageWorld, params.minHeight,
+                             (float)wy * params.tileWorldSize + (float)n.y * pageWorld};
+                v3 boxMax = {boxMin.x + pageWorld, params.maxHeight, boxMin.z + pageWorld};
+
+                float dx = SDL_max(SDL_max(boxMin.x - params.cameraPos.x, params.cameraPos.x - boxMax.x), 0.0f);
+                float dz = SDL_max(SDL_max(boxMin.z - params.cameraPos.z, params.cameraPos.z - boxMax.z), 0.0f);
+                float farX = SDL_max(SDL_fabsf(boxMin.x - params.cameraPos.x), SDL_fabsf(boxMax.x - params.cameraPos.x));
+                float farZ = SDL_max(SDL_fabsf(boxMin.z - params.cameraPos.z), SDL_fabsf(boxMax.z - params.cameraPos.z));
+                boxMin.y -= (farX * farX + farZ * farZ) / (2.0f * params.planetRadius);
+                if (n.mip != top && !params.view->aabb_visible(boxMin, boxMax))
+                    continue;
+
+                float dy = SDL_max(SDL_max(boxMin.y - params.cameraPos.y, params.cameraPos.y - boxMax.y), 0.0f);
+                float distance = SDL_max(SDL_sqrtf(dx * dx + dy * dy + dz * dz), 1.0f);
+                float pixelWorld = distance / params.pixelsPerRadian;
+                if (n.mip != top && pixelWorld >= texelWorld * (float)(1 << (n.mip + 1)))
+                    continue; // its parent is enough here, only a sibling needed the split
+                vt_page_request &request = out[count++];
+                request.key = vt_page_key(n.mip, tileX * side + n.x, tileY * side + n.y);
+                // coarser mips go first, they're the fallback for everything under them
+                request.priority = distance + (float)(top - n.mip) * params.tileWorldSize * 0.25f;
+
+                if (n.mip > 0 && pixelWorld < texelWorld * (float)(1 << n.mip))
+                {
+                    for (int c = 0; c < 4; ++c)
+                        stack[depth++] = {n.mip - 1, n.x * 2 + (c & 1), n.y * 2 + (c >> 1)};
+                }
+            }
+        }
+    }
+    return count;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+// Which tiles a dataset has and what's known about them before they load. Coverage is sparse: only tiles
+// that exist have a record, keyed by their signed tile coordinates, so the holes in a continent cost nothing
+// and the world has no fixed size. The records live in the tile archive's directory (see tile_archive.h),
+// lookups go through an open addressing hash built once when the archive opens.
+struct WorldManifestConstants
+{
+    static constexpr Uint32 emptyBucket = 0xFFFFFFFFu;
+    static constexpr Uint64 keysHashSeed = 0xCBF29CE484222325ull; // FNV-1a
+    static constexpr Uint64 keysHashPrime = 0x100000001B3ull;
+};
+
+// y in the high half so sorted keys are row major
+static inline Uint64 world_tile_key(int tileX, int tileY) { return ((Uint64)(Uint32)tileY << 32) | (Uint64)(Uint32)tileX; }
+static inline int world_tile_key_x(Uint64 key) { return (int)(Uint32)key; }
+static inline int world_tile_key_y(Uint64 key) { return (int)(Uint32)(key >> 32); }
+
+// One tile's record, written by pack_tiles.py
+struct world_tile_info
+{
+    Uint64 key;
+    Uint16 minHeight; // over the height tile's top mip, R16_UNORM units; 0 and 0 without a height layer
+    Uint16 maxHeight;
+    Uint32 layerMask; // bit per tile_archive_layer the archive has for this tile
+};
+
+static_assert(sizeof(world_tile_info) == 16, "world_tile_info must match pack_tiles.py");
+
+struct world_manifest
+{
+    const world_tile_info *tiles = nullptr; // sorted by key
+    Uint32 tileCount = 0;
+    int minTileX = 0; // inclusive bounds of the tiles that exist
+    int minTileY = 0;
+    int maxTileX = -1;
+    int maxTileY = -1;
+    Uint16 maxHeight = 0; // highest tile in the world
+    Uint64 keysHash = 0;  // over the sorted keys, side files such as the page file are checked against it
+
+    Uint32 *buckets = nullptr; // tile index per bucket, at most half full
+    Uint32 bucketMask = 0;
+
+    static Uint32 bucket(Uint64 key)
+    {
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDull;
+        key ^= key >> 33;
+        return (Uint32)key;
+    }
+
+    // Indexes records that stay valid (mapped) for the manifest's lifetime. False when they aren't sorted
+    // by key, which also rules out duplicates.
+    bool build(const world_tile_info *_tiles, Uint32 count)
+    {
+        release();
+        Uint32 bucketCount = 16;
+        while (bucketCount < count * 2ull)
+            bucketCount *= 2;
+        buckets = (Uint32 *)SDL_malloc(bucketCount * sizeof(Uint32));
+        if (!buckets)
+            return false;
+        bucketMask = bucketCount - 1;
+        for (Uint32 i = 0; i < bucketCount; ++i)
+            buckets[i] = WorldManifestConstants::emptyBucket;
+
+        tiles = _tiles;
+        tileCount = count;
+        keysHash = WorldManifestConstants::keysHashSeed;
+        for (Uint32 i = 0; i < count; ++i)
+        {
+            Uint64 key = tiles[i].key;
+            if (i > 0 && key <= tiles[i - 1].key)
+            {
+                SDL_Log("world_manifest: tile %u is out of order or a duplicate", i);
+                release();
+                return false;
+            }
+            Uint32 b = bucket(key) & bucketMask;
+            while (buckets[b] != WorldManifestConstants::emptyBucket)
+                b = (b + 1) & bucketMask;
+            buckets[b] = i;
+
+            int x = world_tile_key_x(key);
+            int y = world_tile_key_y(key);
+            minTileX = i == 0 ? x : SDL_min(minTileX, x);
+            maxTileX = i == 0 ? x : SDL_max(maxTileX, x);
+            minTileY = i == 0 ? y : SDL_min(minTileY, y);
+            maxTileY = i == 0 ? y : SDL_max(maxTileY, y);
+            maxHeight = SDL_max(maxHeight, tiles[i].maxHeight);
+            for (int byte = 0; byte < 8; ++byte)
+                keysHash = (keysHash ^ ((key >> (byte * 8)) & 0xFF)) * WorldManifestConstants::keysHashPrime;
+        }
+        return true;
+    }
+
+    void release()
+    {
+        SDL_free(buckets);
+        buckets = nullptr;
+        bucketMask = 0;
+        tiles = nullptr;
+        tileCount = 0;
+        minTileX = minTileY = 0;
+        maxTileX = maxTileY = -1;
+        maxHeight = 0;
+    }
+
+    // Index of the tile's record, -1 for a tile the world doesn't have
+    int find(int tileX, int tileY) const
+    {
+        if (!buckets)
+            return -1;
+        Uint64 key = world_tile_key(tileX, tileY);
+        for (Uint32 b = bucket(key) & bucketMask;; b = (b + 1) & bucketMask)
+        {
+            Uint32 index = buckets[b];
+            if (index == WorldManifestConstants::emptyBucket)
+                return -1;
+            if (tiles[index].key == key)
+                return (int)index;
+        }
+    }
+
+    const world_tile_info *tile(int tileX, int tileY) const
+    {
+        int index = find(tileX, tileY);
+        return index >= 0 ? &tiles[index] : nullptr;
+    }
+};
@@ -0,0 +1,236 @@
+// Tile reads through async_file_reader against the blocking path main.cpp falls back to: a job per tile that
+// copies its payload out of the mapped archive, blocking on the page faults. Every tile of a generated file is
+// read once in a shuffled order, each read hands its buffer to a job that checksums it like a decode would.
+// Prints the queue depth each path kept (reads in flight when one starts) and MB/s. On Linux the file is
+// dropped from the page cache before every run, elsewhere the runs read it warm and measure copies.
+//   async_io_bench [tile count, 64 by default] [KB per tile, 2048 by default]
+
+#include <SDL3/SDL.h>
+
+#include <stdlib.h>
+
+#include <utility>
+#include <vector>
+
+#include "src/async_io.h"
+#include "src/job_system.h"
+#include "src/mapped_file.h"
+#include "tests/test.h"
+
+static const wchar_t *archivePathW = L"async_io_bench.pak";
+static const char *archivePath = "async_io_bench.pak";
+
+static Uint64 payload_word(Uint64 tile, Uint64 word)
+{
+    Uint64 x = (tile << 32) + word + 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+struct bench_archive
+{
+    int tileCount;
+    size_t tileBytes;
+    std::vector<Uint64> sums; // of every tile's payload words
+    std::vector<int> order;   // the shuffled order tiles are read in
+};
+
+static bool write_archive(bench_archive &archive)
+{
+    FILE *file = fopen(archivePath, "wb");
+    if (!file)
+        return false;
+    std::vector<Uint64> words(archive.tileBytes / sizeof(Uint64));
+    archive.sums.assign((size_t)archive.tileCount, 0);
+    bool ok = true;
+    for (int tile = 0; tile < archive.tileCount && ok; ++tile)
+    {
+        for (size_t w = 0; w < words.size(); ++w)
+        {
+            words[w] = payload_word((Uint64)tile, w);
+            archive.sums[(size_t)tile] += words[w];
+        }
+        ok = fwrite(words.data(), archive.tileBytes, 1, file) == 1;
+    }
+    ok = fclose(file) == 0 && ok;
+
+    Uint32 state = 12345;
+    archive.order.resize((size_t)archive.tileCount);
+    for (int i = 0; i < archive.tileCount; ++i)
+        archive.order[(size_t)i] = i;
+    for (int i = archive.tileCount - 1; i > 0; --i)
+    {
+        state = state * 1664525u + 1013904223u;
+        std::swap(archive.order[(size_t)i], archive.order[(size_t)(state >> 8) % (size_t)(i + 1)]);
+    }
+    return ok;
+}
+
+// true when the next run reads from the disk
+static bool evict_archive()
+{
+#if defined(__linux__)
+    int fd = ::open(archivePath, O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool evicted = fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    ::close(fd);
+    return evicted;
+#else
+    return false;
+#endif
+}
+
+// one tile's read, and the job that checks what arrived
+struct tile_read
+{
+    const bench_archive *archive;
+    int tile;
+    Uint8 *dst;
+    const Uint8 *mapped; // blocking path only
+    std::atomic<int> *remaining;
+    std::atomic<int> *mismatches;
+};
+
+static std::atomic<int> blockingDepth{0};
+static std::atomic<Uint64> blockingDepthSum{0};
+static std::atomic<int> blockingPeakDepth{0};
+
+static void check_tile(void *data)
+{
+    tile_read &read = *(tile_read *)data;
+    const Uint64 *words = (const Uint64 *)read.dst;
+    Uint64 sum = 0;
+    for (size_t w = 0; w < read.archive->tileBytes / sizeof(Uint64); ++w)
+        sum += words[w];
+    if (sum != read.archive->sums[(size_t)read.tile])
+        read.mismatches->fetch_add(1);
+    read.remaining->fetch_sub(1, std::memory_order_release);
+}
+
+static void blocking_read(void *data)
+{
+    tile_read &read = *(tile_read *)data;
+    int depth = blockingDepth.fetch_add(1) + 1;
+    blockingDepthSum.fetch_add((Uint64)depth);
+    int peak = blockingPeakDepth.load();
+    while (depth > peak && !blockingPeakDepth.compare_exchange_weak(peak, depth))
+        ;
+    SDL_memcpy(read.dst, read.mapped + (size_t)read.tile * read.archive->tileBytes, read.archive->tileBytes);
+    blockingDepth.fetch_sub(1);
+    check_tile(data);
+}
+
+static void report(const char *name, const bench_archive &archive, double ms, double depthAvg, int depthPeak, bool cold)
+{
+    double megabytes = (double)archive.tileBytes * (double)archive.tileCount / (1024.0 * 1024.0);
+    printf("%-24s %s %10.1f ms %8.0f MB/s   depth %5.1f avg %3d peak\n", name, cold ? "cold" : "warm", ms,
+           megabytes * 1000.0 / ms, depthAvg, depthPeak);
+}
+
+static double ms_since(Uint64 start)
+{
+    return (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static void run_blocking(job_system &jobs, const bench_archive &archive, Uint8 *buffer)
+{
+    bool cold = evict_archive();
+    mapped_file file;
+    CHECK(file.open(archivePathW));
+    if (!file.data)
+        return;
+    std::atomic<int> remaining{archive.tileCount};
+    std::atomic<int> mismatches{0};
+    std::vector<tile_read> reads((size_t)archive.tileCount);
+    blockingDepthSum = 0;
+    blockingPeakDepth = 0;
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < archive.tileCount; ++i)
+    {
+        int tile = archive.order[(size_t)i];
+        reads[(size_t)i] = {&archive, tile, buffer + (size_t)tile * archive.tileBytes, file.data, &remaining, &mismatches};
+        jobs.submit(blocking_read, &reads[(size_t)i]);
+    }
+    while (remaining.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+    double ms = ms_since(start);
+    file.close();
+
+    CHECK(mismatches.load() == 0);
+    report("blocking, mapped", archive, ms, (double)blockingDepthSum.load() / (double)archive.tileCount, blockingPeakDepth.load(), cold);
+}
+
+static void run_async(job_system &jobs, const bench_archive &archive, Uint8 *buffer, bool forceThreads)
+{
+    bool cold = evict_archive();
+    static async_file_reader reader;
+    CHECK(reader.open(archivePathW, forceThreads));
+    Uint64 readsBefore = reader.readsCompleted.load() + reader.readsFailed.load();
+    Uint64 depthBefore = reader.depthSum.load();
+    reader.peakDepth = 0;
+    std::atomic<int> remaining{archive.tileCount};
+    std::atomic<int> mismatches{0};
+    std::atomic<int> failed{0};
+    std::vector<tile_read> reads((size_t)archive.tileCount);
+
+    // completions hand off to a job and return, like main.cpp's loads
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < archive.tileCount; ++i)
+    {
+        int tile = archive.order[(size_t)i];
+        tile_read *read = &reads[(size_t)i];
+        *read = {&archive, tile, buffer + (size_t)tile * archive.tileBytes, nullptr, &remaining, &mismatches};
+        reader.read((Uint64)tile * archive.tileBytes, archive.tileBytes, read->dst, [read, &jobs, &failed](bool ok)
+                    {
+            if (ok)
+                jobs.submit(check_tile, read);
+            else
+            {
+                failed.fetch_add(1);
+                read->remaining->fetch_sub(1, std::memory_order_release);
+            } });
+    }
+    while (remaining.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+    double ms = ms_since(start);
+
+    CHECK(failed.load() == 0);
+    CHECK(mismatches.load() == 0);
+    Uint64 readCount = reader.readsCompleted.load() + reader.readsFailed.load() - readsBefore;
+    CHECK(readCount == (Uint64)archive.tileCount);
+    double depthAvg = readCount > 0 ? (double)(reader.depthSum.load() - depthBefore) / (double)readCount : 0.0;
+    char name[64];
+    snprintf(name, sizeof(name), "async_io, %s", async_io_backend_name(reader.backend));
+    report(name, archive, ms, depthAvg, (int)reader.peakDepth.load(), cold);
+    reader.close();
+}
+
+int main(int argc, char **argv)
+{
+    bench_archive archive = {};
+    archive.tileCount = SDL_max(argc > 1 ? atoi(argv[1]) : 64, 1);
+    archive.tileBytes = (size_t)SDL_max(argc > 2 ? atoi(argv[2]) : 2048, 4) * 1024;
+    if (!write_archive(archive))
+    {
+        fprintf(stderr, "failed to write %s\n", archivePath);
+        return 1;
+    }
+    unsigned int hwThreads = std::thread::hardware_concurrency();
+    int workerCount = SDL_clamp(hwThreads > 1 ? (int)hwThreads - 1 : 1, 1, job_system::maxThreads - 1);
+    printf("%d tiles of %zu KB, %d workers, up to %d async reads in flight\n", archive.tileCount, archive.tileBytes / 1024,
+           workerCount, AsyncIoConstants::maxInFlight);
+
+    static job_system jobs;
+    CHECK(jobs.init(workerCount));
+    std::vector<Uint8> buffer(archive.tileBytes * (size_t)archive.tileCount);
+    run_blocking(jobs, archive, buffer.data());
+    run_async(jobs, archive, buffer.data(), false);
+    run_async(jobs, archive, buffer.data(), true);
+    jobs.shutdown();
+
+    remove(archivePath);
+    return test_result("async_io_bench");
+}
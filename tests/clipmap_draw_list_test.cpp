@@ -0,0 +1,157 @@
+// clipmap_draw_list::build against the per-ring values the draw loop used before instancing: every ring i has
+// sample step 2^i and its origin snapped to twice that step, and with nothing culled the instances tile the
+// outermost ring's square exactly once, apart from the corner quad the two trim legs share.
+
+#include <SDL3/SDL.h>
+
+#include <vector>
+
+#include "src/clipmap.h"
+#include "tests/test.h"
+
+static frustum everything_visible()
+{
+    frustum f = {};
+    for (int i = 0; i < 5; ++i)
+        f.planes[i][3] = 1.0f;
+    return f;
+}
+
+static clipmap_cull_params flat_world(v3 cameraPos)
+{
+    clipmap_cull_params cull = {};
+    cull.cameraPos = cameraPos;
+    cull.minHeight = 0.0f;
+    cull.maxHeight = 150.0f;
+    cull.planetRadius = 1.0e12f; // no horizon in reach
+    return cull;
+}
+
+// the ring offset and step of the old one-draw-per-ring loop, with the block layout's snap to twice the step
+static void expected_ring(float centreX, float centreZ, int ring, float &originX, float &originZ, float &step)
+{
+    step = (float)(1 << ring);
+    originX = SDL_floorf(centreX / (2.0f * step)) * 2.0f * step - ClipmapConstants::fixupPos * step;
+    originZ = SDL_floorf(centreZ / (2.0f * step)) * 2.0f * step - ClipmapConstants::fixupPos * step;
+}
+
+static void check_rings(const clipmap_draw_list &list, v3 centre)
+{
+    for (int i = 0; i < list.ringCount; ++i)
+    {
+        float originX, originZ, step;
+        expected_ring(centre.x, centre.z, i, originX, originZ, step);
+        CHECK(list.rings[i].sampleStep == step);
+        CHECK(list.rings[i].originX == originX);
+        CHECK(list.rings[i].originZ == originZ);
+    }
+}
+
+// every finest-step cell of the outermost ring's square, counted per instance that covers it
+static void check_coverage(const clipmap_draw_list &list)
+{
+    const clipmap_ring &outer = list.rings[list.ringCount - 1];
+    int dim = ClipmapConstants::gridDimQuads << (list.ringCount - 1);
+    int finest = 1 << list.firstRing;
+    int cells = dim / finest;
+    std::vector<Uint8> covered((size_t)cells * cells, 0);
+
+    for (int p = 0; p < CLIPMAP_PIECE_COUNT; ++p)
+    {
+        for (Uint32 k = 0; k < list.pieceInstanceCount[p]; ++k)
+        {
+            const clipmap_instance &instance = list.instances[list.pieceFirstInstance[p] + k];
+            CHECK(instance.ring >= list.firstRing && instance.ring < list.ringCount);
+            const clipmap_ring &ring = list.rings[instance.ring];
+            int step = (int)ring.sampleStep;
+            int x0 = (int)(ring.originX - outer.originX) + instance.x * step;
+            int z0 = (int)(ring.originZ - outer.originZ) + instance.z * step;
+            for (int z = z0; z < z0 + clipmapPieceQuads[p][1] * step; z += finest)
+            {
+                for (int x = x0; x < x0 + clipmapPieceQuads[p][0] * step; x += finest)
+                {
+                    bool inside = x >= 0 && z >= 0 && x < dim && z < dim;
+                    CHECK(inside);
+                    if (inside)
+                        covered[(size_t)(x / finest) + (size_t)(z / finest) * cells]++;
+                }
+            }
+        }
+    }
+
+    int gaps = 0, twice = 0, more = 0;
+    for (Uint8 count : covered)
+    {
+        gaps += count == 0 ? 1 : 0;
+        twice += count == 2 ? 1 : 0;
+        more += count > 2 ? 1 : 0;
+    }
+    // one shared trim corner quad per ring outside the finest drawn one
+    int expectedTwice = 0;
+    for (int i = list.firstRing + 1; i < list.ringCount; ++i)
+        expectedTwice += (1 << (i - list.firstRing)) * (1 << (i - list.firstRing));
+    CHECK(gaps == 0);
+    CHECK(twice == expectedTwice);
+    CHECK(more == 0);
+}
+
+static void check_grouping(const clipmap_draw_list &list)
+{
+    Uint32 next = 0;
+    Uint32 triangles = 0;
+    for (int p = 0; p < CLIPMAP_PIECE_COUNT; ++p)
+    {
+        CHECK(list.pieceFirstInstance[p] == next);
+        next += list.pieceInstanceCount[p];
+        triangles += list.pieceInstanceCount[p] * (Uint32)(clipmapPieceQuads[p][0] * clipmapPieceQuads[p][1] * 2);
+    }
+    CHECK(next == list.instanceCount);
+    CHECK(triangles == list.trianglesSubmitted);
+}
+
+int main()
+{
+    static clipmap_draw_list list;
+    const frustum all = everything_visible();
+    const float centres[][2] = {{1000.3f, 703.1f}, {1001.7f, 1704.2f}, {1003.2f, -517.9f}, {-9999.5f, 4095.0f}, {0.0f, 0.0f}};
+
+    for (const float *centre : centres)
+    {
+        v3 c = {centre[0], 0.0f, centre[1]};
+        for (int rings = 1; rings <= 5; ++rings)
+        {
+            for (int skip = 0; skip < rings && skip < 3; ++skip)
+            {
+                list.build(c, skip, rings, all, flat_world({c.x, 100.0f, c.z}));
+                CHECK(list.ringCount == rings);
+                CHECK(list.firstRing == skip);
+                check_rings(list, c);
+                check_grouping(list);
+                check_coverage(list);
+                CHECK(list.trianglesSubmitted == list.trianglesTotal);
+            }
+        }
+    }
+
+    // a frustum looking along +x keeps only pieces in front of the camera, the rest of the layout is unchanged
+    v3 c = {1000.3f, 0.0f, 703.1f};
+    frustum ahead = everything_visible();
+    ahead.planes[4][0] = 1.0f;
+    ahead.planes[4][3] = -c.x; // x >= camera
+    list.build(c, 0, 5, ahead, flat_world({c.x, 100.0f, c.z}));
+    check_rings(list, c);
+    check_grouping(list);
+    CHECK(list.trianglesSubmitted < list.trianglesTotal);
+    for (Uint32 i = 0; i < list.instanceCount; ++i)
+    {
+        const clipmap_instance &instance = list.instances[i];
+        int p = 0;
+        while (p + 1 < CLIPMAP_PIECE_COUNT && i >= list.pieceFirstInstance[p + 1])
+            p++;
+        const clipmap_ring &ring = list.rings[instance.ring];
+        float maxX = ring.originX + (instance.x + clipmapPieceQuads[p][0]) * ring.sampleStep;
+        CHECK(maxX >= c.x);
+    }
+
+    return test_result("clipmap_draw_list_test");
+}
@@ -0,0 +1,150 @@
+// Per-frame cost of scrolling the clipmap height pyramid (clipmap_height_pyramid::update) at flight speeds up to
+// debugBoostSpeed's 5000 units/s, against refilling every level from scratch. The camera flies back and forth
+// over a 4 x 4 tile world on a fixed 60 Hz timestep, every level the auto LOD can pick is scrolled each frame,
+// and the levels are checked against the source heights at the end of each run.
+//   clipmap_heights_bench [seconds per speed]
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "src/clipmap_heights.h"
+#include "tests/test.h"
+
+static const int worldTiles = 4;
+static const float unitsPerTexel = 1.0f; // terrainTileInWorldUnits / tileDim in the engine
+
+// absolute level 0 texel, cheap to recompute for the check
+static Uint16 source_height(int x, int z) { return (Uint16)((x * 31 + z * 17) ^ (x >> 5) * 7); }
+
+static double ms_since(Uint64 start)
+{
+    return (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static void level_origin(float centre, int level, int &origin)
+{
+    float step = (float)(1 << level) * unitsPerTexel;
+    origin = (int)SDL_floorf(clipmap_draw_list::ring_origin(centre, step) / step + 0.5f);
+}
+
+static int check_levels(const clipmap_height_pyramid &pyramid)
+{
+    const int dim = HeightPyramidConstants::levelDim;
+    const int worldTexels = worldTiles * HeightPyramidConstants::tileDim;
+    int bad = 0;
+    for (int l = HeightPyramidConstants::firstLevel; l < HeightPyramidConstants::levelCount; ++l)
+    {
+        const clipmap_height_level &level = pyramid.levels[l];
+        for (int z = level.originZ; z < level.originZ + dim; ++z)
+        {
+            for (int x = level.originX; x < level.originX + dim; ++x)
+            {
+                int gx = x * (1 << l);
+                int gz = z * (1 << l);
+                Uint16 expected = (gx >= 0 && gz >= 0 && gx < worldTexels && gz < worldTexels) ? source_height(gx, gz) : 0;
+                bad += level.texels[(x & HeightPyramidConstants::levelMask) + (z & HeightPyramidConstants::levelMask) * dim] != expected ? 1 : 0;
+            }
+        }
+    }
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    float seconds = argc > 1 ? (float)atof(argv[1]) : 10.0f;
+    const int tileDim = HeightPyramidConstants::tileDim;
+
+    static height_tile_source source = {};
+    std::vector<Uint16> tile((size_t)tileDim * tileDim);
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int ty = 0; ty < worldTiles; ++ty)
+    {
+        for (int tx = 0; tx < worldTiles; ++tx)
+        {
+            for (int y = 0; y < tileDim; ++y)
+            {
+                for (int x = 0; x < tileDim; ++x)
+                    tile[(size_t)x + (size_t)y * tileDim] = source_height(tx * tileDim + x, ty * tileDim + y);
+            }
+            height_tile_mips mips = {};
+            mips.tileX = tx;
+            mips.tileY = ty;
+            CHECK(mips.build(tile.data(), (size_t)tileDim * sizeof(Uint16), false));
+            source.insert(mips, 0, 0, worldTiles);
+        }
+    }
+    printf("built %d tile mip chains in %.0f ms\n", worldTiles * worldTiles, ms_since(start));
+
+    const float speeds[] = {10.0f, 100.0f, 1000.0f, 2500.0f, 5000.0f};
+    const float worldSize = (float)(worldTiles * tileDim) * unitsPerTexel;
+    const float timestep = 1.0f / 60.0f;
+    printf("%10s %8s %10s %10s %10s %14s\n", "units/s", "frames", "avg ms", "p99 ms", "max ms", "texels/frame");
+    for (float speed : speeds)
+    {
+        static clipmap_height_pyramid pyramid = {};
+        for (clipmap_height_level &level : pyramid.levels)
+            level.valid = false;
+        // diagonal back and forth across the middle of the world, turning around short of the edges
+        float x = worldSize * 0.3f, z = worldSize * 0.4f;
+        float dirX = 0.8f, dirZ = 0.6f;
+        int frames = (int)(seconds / timestep);
+        std::vector<double> frameMs;
+        Uint64 texels = 0;
+        for (int frame = 0; frame <= frames; ++frame)
+        {
+            x += dirX * speed * timestep;
+            z += dirZ * speed * timestep;
+            if (x < worldSize * 0.1f || x > worldSize * 0.9f)
+                dirX = -dirX;
+            if (z < worldSize * 0.1f || z > worldSize * 0.9f)
+                dirZ = -dirZ;
+
+            pyramid.texelsUpdated = 0;
+            Uint64 frameStart = SDL_GetPerformanceCounter();
+            for (int l = HeightPyramidConstants::firstLevel; l < HeightPyramidConstants::levelCount; ++l)
+            {
+                int originX, originZ;
+                level_origin(x, l, originX);
+                level_origin(z, l, originZ);
+                pyramid.update(l, originX, originZ, source);
+            }
+            if (frame > 0) // the first frame fills every level
+            {
+                frameMs.push_back(ms_since(frameStart));
+                texels += pyramid.texelsUpdated;
+            }
+        }
+        std::sort(frameMs.begin(), frameMs.end());
+        double total = 0.0;
+        for (double ms : frameMs)
+            total += ms;
+        size_t count = frameMs.size();
+        printf("%10.0f %8zu %10.4f %10.4f %10.4f %14.0f\n", speed, count, total / (double)count, frameMs[count * 99 / 100],
+               frameMs.back(), (double)texels / (double)count);
+        CHECK(check_levels(pyramid) == 0);
+    }
+
+    // what every frame would cost without the toroidal scroll
+    static clipmap_height_pyramid full = {};
+    const int refills = 60;
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < refills; ++i)
+    {
+        for (int l = HeightPyramidConstants::firstLevel; l < HeightPyramidConstants::levelCount; ++l)
+        {
+            full.levels[l].valid = false;
+            int originX, originZ;
+            level_origin(worldSize * 0.5f + (float)i, l, originX);
+            level_origin(worldSize * 0.5f, l, originZ);
+            full.update(l, originX, originZ, source);
+        }
+    }
+    printf("full refill of every level: %.4f ms\n", ms_since(start) / refills);
+    CHECK(check_levels(full) == 0);
+
+    for (int i = 0; i < source.tileCount; ++i)
+        source.tiles[i].release();
+    return test_result("clipmap_heights_bench");
+}
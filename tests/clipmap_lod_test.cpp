@@ -0,0 +1,103 @@
+// Altitude sweep of clipmap_select_lod on the engine's 1:50 planet: at every height the outermost ring has to
+// reach the horizon and be the smallest one that does, the finest drawn ring has to be the coarsest whose
+// spacing stays under the target error below the camera, and both only move outwards as the camera climbs.
+// Prints the rings picked and the triangles the draw list submits against drawing every ring.
+
+#include <SDL3/SDL.h>
+
+#include "src/clipmap.h"
+#include "tests/test.h"
+
+static frustum everything_visible()
+{
+    frustum f = {};
+    for (int i = 0; i < 5; ++i)
+        f.planes[i][3] = 1.0f;
+    return f;
+}
+
+int main()
+{
+    const float altitudes[] = {2.0f, 20.0f, 100.0f, 200.0f, 500.0f, 1000.0f, 3000.0f, 10000.0f, 50000.0f};
+    const float fovY = 1.0471976f; // 60 degrees, as in main.cpp
+    const float screenHeight = 1080.0f;
+    const float targetErrorPixels = 2.0f;
+    const float maxTerrainHeight = 150.0f;
+    const float planetRadius = 600000.0f / 50.0f; // planetRadius in shaders.hlsl at the default planetScaleRatio
+    const float pixelsPerUnit = screenHeight / (2.0f * SDL_tanf(fovY * 0.5f));
+
+    static clipmap_draw_list list;
+    static clipmap_draw_list all;
+    const frustum visible = everything_visible();
+    int previousFirst = 0, previousCount = 0;
+    float previousHorizon = 0.0f;
+
+    printf("%10s %6s %6s %10s %10s %12s %12s\n", "altitude", "first", "rings", "horizon", "coverage", "triangles", "all rings");
+    for (float altitude : altitudes)
+    {
+        clipmap_lod_params params = {};
+        params.cameraHeight = altitude;
+        params.centreOffset = 0.0f;
+        params.fovY = fovY;
+        params.screenHeight = screenHeight;
+        params.targetErrorPixels = targetErrorPixels;
+        params.maxTerrainHeight = maxTerrainHeight;
+        params.planetRadius = planetRadius;
+        params.maxViewDistance = 1.0e9f;
+        clipmap_lod lod = clipmap_select_lod(params);
+
+        int lastRing = lod.ringCount - 1;
+        CHECK(lod.firstRing >= 0 && lod.firstRing <= lastRing && lod.ringCount <= ClipmapConstants::maxRings);
+        CHECK(lod.coverage == (float)ClipmapConstants::fixupPos * (float)(1 << lastRing));
+        // reaches the horizon unless out of rings, and one ring less wouldn't
+        CHECK(lod.coverage >= lod.horizonDistance || lod.ringCount == ClipmapConstants::maxRings);
+        CHECK(lastRing == lod.firstRing || lod.coverage * 0.5f < lod.horizonDistance);
+        // the finest drawn ring is under the error right below the camera, the next coarser one isn't
+        float nearest = SDL_max(altitude - maxTerrainHeight, 1.0f);
+        float spacing = (float)(1 << lod.firstRing) * pixelsPerUnit / nearest;
+        CHECK(lod.firstRing == 0 || spacing <= targetErrorPixels);
+        CHECK(lod.firstRing + 1 == ClipmapConstants::maxRings || spacing * 2.0f > targetErrorPixels);
+
+        CHECK(lod.firstRing >= previousFirst);
+        CHECK(lod.ringCount >= previousCount);
+        CHECK(lod.horizonDistance > previousHorizon);
+        previousFirst = lod.firstRing;
+        previousCount = lod.ringCount;
+        previousHorizon = lod.horizonDistance;
+
+        clipmap_cull_params cull = {};
+        cull.cameraPos = {0.0f, altitude, 0.0f};
+        cull.maxHeight = maxTerrainHeight;
+        cull.planetRadius = planetRadius;
+        list.build({0.0f, 0.0f, 0.0f}, lod.firstRing, lod.ringCount, visible, cull);
+        all.build({0.0f, 0.0f, 0.0f}, 0, ClipmapConstants::maxRings, visible, cull);
+        CHECK(list.trianglesSubmitted <= all.trianglesSubmitted);
+        printf("%10.0f %6d %6d %10.0f %10.0f %12u %12u\n", altitude, lod.firstRing, lod.ringCount, lod.horizonDistance,
+               lod.coverage, list.trianglesSubmitted, all.trianglesSubmitted);
+    }
+
+    // a centre pushed ahead of the camera needs the horizon from the camera, not from the centre
+    clipmap_lod_params params = {};
+    params.cameraHeight = 500.0f;
+    params.fovY = fovY;
+    params.screenHeight = screenHeight;
+    params.targetErrorPixels = targetErrorPixels;
+    params.maxTerrainHeight = maxTerrainHeight;
+    params.planetRadius = planetRadius;
+    params.maxViewDistance = 1.0e9f;
+    clipmap_lod centred = clipmap_select_lod(params);
+    params.centreOffset = centred.coverage;
+    clipmap_lod shifted = clipmap_select_lod(params);
+    CHECK(shifted.ringCount == centred.ringCount + 1 || shifted.ringCount == ClipmapConstants::maxRings);
+    CHECK(shifted.coverage >= SDL_sqrtf(shifted.horizonDistance * shifted.horizonDistance + params.centreOffset * params.centreOffset) ||
+          shifted.ringCount == ClipmapConstants::maxRings);
+
+    // a view distance short of the horizon caps the rings
+    params.centreOffset = 0.0f;
+    params.maxViewDistance = 300.0f;
+    clipmap_lod capped = clipmap_select_lod(params);
+    CHECK(capped.horizonDistance == 300.0f);
+    CHECK(capped.ringCount <= centred.ringCount);
+
+    return test_result("clipmap_lod_test");
+}
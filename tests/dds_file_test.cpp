@@ -0,0 +1,89 @@
+// dds_file over the textures make_tile_fixtures.py writes: for every format and header kind, the metadata, and
+// that each mip's pointer, pitch and bytes are the file's own, read through the mapping and parsed from memory.
+// Truncated copies, cube maps, bad magic and missing files have to be refused.
+
+#include <SDL3/SDL.h>
+
+#include <string>
+#include <vector>
+
+#include "src/dds_file.h"
+#include "tests/test.h"
+
+static std::wstring widen(const std::string &text) { return std::wstring(text.begin(), text.end()); }
+
+static bool read_file(const std::string &path, std::vector<Uint8> &bytes)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    bytes.resize((size_t)ftell(f));
+    fseek(f, 0, SEEK_SET);
+    bool ok = fread(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    fclose(f);
+    return ok;
+}
+
+int main()
+{
+    FILE *cases = fopen("dds/cases.txt", "r");
+    CHECK(cases != nullptr);
+    if (!cases)
+        return test_result("dds_file_test");
+
+    char name[64];
+    Uint32 width, height, mips, format;
+    size_t dataOffset;
+    int files = 0;
+    while (fscanf(cases, "%63s %u %u %u %u %zu", name, &width, &height, &mips, &format, &dataOffset) == 6)
+    {
+        std::vector<size_t> sizes(mips);
+        for (size_t &size : sizes)
+            CHECK(fscanf(cases, "%zu", &size) == 1);
+        std::string path = std::string("dds/") + name;
+        files++;
+
+        dds_file file;
+        bool opened = file.open(widen(path + ".dds").c_str());
+        CHECK(opened);
+        if (!opened)
+            continue;
+        CHECK(file.image.width == width && file.image.height == height);
+        CHECK(file.image.mipLevels == mips && file.image.format == format);
+
+        std::vector<Uint8> bytes;
+        CHECK(read_file(path + ".dds", bytes));
+        CHECK(bytes.size() == file.file.size);
+        size_t offset = dataOffset;
+        for (Uint32 mip = 0; mip < mips && mip < file.image.mipLevels; ++mip)
+        {
+            const dds_surface &surface = file.image.surfaces[mip];
+            CHECK(surface.width == SDL_max(width >> mip, 1u) && surface.height == SDL_max(height >> mip, 1u));
+            CHECK(surface.slicePitch == sizes[mip]);
+            CHECK(surface.pixels == file.file.data + offset);
+            CHECK(offset + sizes[mip] <= bytes.size() && memcmp(surface.pixels, bytes.data() + offset, sizes[mip]) == 0);
+            offset += sizes[mip];
+        }
+        CHECK(offset == bytes.size());
+
+        // parsed in place from memory the caller owns
+        dds_file parsed;
+        CHECK(parsed.parse(bytes.data(), bytes.size()));
+        CHECK(parsed.image.mipLevels == mips && parsed.image.surfaces[0].pixels == bytes.data() + dataOffset);
+        CHECK(!parsed.parse(bytes.data(), bytes.size() - 1));
+
+        dds_file truncated;
+        CHECK(!truncated.open(widen(path + "_truncated.dds").c_str()));
+    }
+    fclose(cases);
+    printf("%d textures checked\n", files);
+    CHECK(files == 11);
+
+    dds_file cube, junk, missing;
+    CHECK(!cube.open(L"dds/cube.dds"));
+    CHECK(!junk.open(L"dds/junk.dds"));
+    CHECK(!missing.open(L"dds/missing.dds"));
+
+    return test_result("dds_file_test");
+}
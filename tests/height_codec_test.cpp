@@ -0,0 +1,277 @@
+// height_codec.h against a scalar reference written from its format comment: bands encoded like pack_tiles.py's
+// encode_height_band decode back exactly (random, constant, full range and odd widths, partial tail blocks,
+// block bit widths 0 and 16), lossy bands stay within quantStep / 2, truncated bands are refused, and the
+// header's height_codec_unpack_block and height_codec_reconstruct_row match the reference on every width.
+// Then prints decode GB/s over terrain-like bands. CMake builds it twice, the second time with
+// HEIGHT_CODEC_NO_SSE2 so the header's scalar path is covered on x64 as well.
+//   height_codec_test [megabytes decoded for the timing, 256 by default]
+
+#include <SDL3/SDL.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "src/height_codec.h"
+#include "tests/test.h"
+
+static const int blockSamples = HeightCodecConstants::blockSamples;
+static const int lanes = HeightCodecConstants::lanes;
+
+static Uint32 rng = 1;
+static Uint32 next_random()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// pack_tiles.py's encode_height_band
+static std::vector<Uint8> encode_band(const Uint16 *heights, int width, int rows, Uint16 quantStep)
+{
+    size_t samples = (size_t)width * rows;
+    std::vector<Uint32> q(samples);
+    for (size_t i = 0; i < samples; ++i)
+        q[i] = quantStep > 1 ? ((Uint32)heights[i] + quantStep / 2) / quantStep : heights[i];
+
+    size_t blockCount = (samples + blockSamples - 1) / blockSamples;
+    std::vector<Uint16> zigzag(blockCount * blockSamples, 0);
+    for (int y = 0; y < rows; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            Uint32 a = x > 0 ? q[(size_t)y * width + x - 1] : 0;
+            Uint32 b = y > 0 ? q[(size_t)(y - 1) * width + x] : 0;
+            Uint32 c = x > 0 && y > 0 ? q[(size_t)(y - 1) * width + x - 1] : 0;
+            Sint16 residual = (Sint16)(Uint16)(q[(size_t)y * width + x] - (a + b - c));
+            zigzag[(size_t)y * width + x] = (Uint16)(residual < 0 ? -2 * residual - 1 : 2 * residual);
+        }
+    }
+
+    std::vector<Uint8> out;
+    out.push_back((Uint8)quantStep);
+    out.push_back((Uint8)(quantStep >> 8));
+    std::vector<int> widths(blockCount);
+    for (size_t block = 0; block < blockCount; ++block)
+    {
+        Uint32 largest = 0;
+        for (int i = 0; i < blockSamples; ++i)
+            largest = SDL_max(largest, (Uint32)zigzag[block * blockSamples + i]);
+        int bits = 0;
+        while (largest >> bits)
+            bits++;
+        widths[block] = bits;
+        out.push_back((Uint8)bits);
+    }
+    for (size_t block = 0; block < blockCount; ++block)
+    {
+        int bits = widths[block];
+        std::vector<Uint16> words((size_t)bits * lanes, 0);
+        for (int t = 0; t < blockSamples / lanes && bits > 0; ++t)
+        {
+            int bit = t * bits;
+            int k = bit >> 4;
+            int shift = bit & 15;
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                Uint32 value = zigzag[block * blockSamples + t * lanes + lane];
+                words[(size_t)k * lanes + lane] |= (Uint16)(value << shift);
+                if (shift + bits > 16)
+                    words[(size_t)(k + 1) * lanes + lane] |= (Uint16)(value >> (16 - shift));
+            }
+        }
+        for (Uint16 word : words)
+        {
+            out.push_back((Uint8)word);
+            out.push_back((Uint8)(word >> 8));
+        }
+    }
+    return out;
+}
+
+// the format comment, one sample at a time
+static void reference_unpack_block(const Uint8 *words, int width, Uint16 *out)
+{
+    for (int i = 0; i < blockSamples; ++i)
+    {
+        int t = i / lanes;
+        int lane = i % lanes;
+        Uint32 value = 0;
+        for (int b = 0; b < width; ++b)
+        {
+            int bit = t * width + b;
+            const Uint8 *word = words + ((bit >> 4) * lanes + lane) * 2;
+            value |= (Uint32)(((word[0] | (word[1] << 8)) >> (bit & 15)) & 1) << b;
+        }
+        out[i] = (Uint16)((value >> 1) ^ (0u - (value & 1u)));
+    }
+}
+
+static void reference_reconstruct_row(Uint16 *row, const Uint16 *above, int width)
+{
+    Uint16 left = 0, upperLeft = 0;
+    for (int x = 0; x < width; ++x)
+    {
+        Uint16 upper = above ? above[x] : 0;
+        row[x] = (Uint16)(row[x] + left + upper - upperLeft);
+        left = row[x];
+        upperLeft = upper;
+    }
+}
+
+static void check_round_trip(const char *name, const std::vector<Uint16> &heights, int width, int rows, Uint16 quantStep)
+{
+    std::vector<Uint8> band = encode_band(heights.data(), width, rows, quantStep);
+    std::vector<Uint16> decoded((size_t)width * rows + 1, 0xBEEF); // one past the end, must survive
+    CHECK(height_codec_decode_band(band.data(), band.size(), decoded.data(), width, rows));
+    int worst = 0;
+    for (size_t i = 0; i < heights.size(); ++i)
+        worst = SDL_max(worst, abs((int)decoded[i] - (int)heights[i]));
+    CHECK(worst <= quantStep / 2);
+    CHECK(decoded.back() == 0xBEEF);
+    if (worst > quantStep / 2)
+        fprintf(stderr, "%s: %dx%d quant %u, error %d\n", name, width, rows, quantStep, worst);
+
+    // every truncation is refused rather than read past
+    for (size_t size = 0; size < band.size(); size += SDL_max(band.size() / 7, (size_t)1))
+        CHECK(!height_codec_decode_band(band.data(), size, decoded.data(), width, rows) || size == band.size());
+}
+
+static std::vector<Uint16> make_band(int width, int rows, int kind)
+{
+    std::vector<Uint16> heights((size_t)width * rows);
+    Uint32 walk = 30000;
+    for (size_t i = 0; i < heights.size(); ++i)
+    {
+        switch (kind)
+        {
+        case 0: // random
+            heights[i] = (Uint16)next_random();
+            break;
+        case 1: // constant
+            heights[i] = 12345;
+            break;
+        case 2: // max range, steps of half the range so residuals need all 16 bits (0 to 65535 wraps to -1)
+        {
+            const Uint16 pattern[4] = {0, 32768, 65535, 32767};
+            heights[i] = pattern[(i + i / (size_t)SDL_max(width, 1)) % 4];
+            break;
+        }
+        default: // terrain-like, a small random walk
+            walk = (Uint32)SDL_clamp((int)walk + (int)(next_random() % 65) - 32, 0, 65535);
+            heights[i] = (Uint16)walk;
+            break;
+        }
+    }
+    return heights;
+}
+
+static void check_bands()
+{
+    const int widths[] = {1, 7, 8, 9, 16, 127, 128, 129, 257, 1000};
+    const int rowCounts[] = {1, 2, 3, 16};
+    const Uint16 quantSteps[] = {1, 3, 9, 1001};
+    const char *kinds[] = {"random", "constant", "max range", "terrain"};
+    for (int kind = 0; kind < 4; ++kind)
+        for (int width : widths)
+            for (int rows : rowCounts)
+                for (Uint16 quantStep : quantSteps)
+                    check_round_trip(kinds[kind], make_band(width, rows, kind), width, rows, quantStep);
+
+    // block bit widths at both ends: a constant band's second row predicts exactly, half range steps take 16
+    std::vector<Uint8> constant = encode_band(make_band(128, 2, 1).data(), 128, 2, 1);
+    CHECK(constant[2 + 1] == 0);
+    std::vector<Uint8> maxRange = encode_band(make_band(128, 1, 2).data(), 128, 1, 1);
+    CHECK(maxRange[2] == 16);
+
+    // an empty band decodes to nothing
+    Uint8 empty[2] = {1, 0};
+    Uint16 untouched = 7;
+    CHECK(height_codec_decode_band(empty, sizeof(empty), &untouched, 0, 4));
+    CHECK(untouched == 7);
+
+    // a block wider than 16 bits is corrupt
+    std::vector<Uint8> band = encode_band(make_band(128, 1, 0).data(), 128, 1, 1);
+    band[2] = 17;
+    band.resize(band.size() + 16, 0);
+    std::vector<Uint16> decoded(128);
+    CHECK(!height_codec_decode_band(band.data(), band.size(), decoded.data(), 128, 1));
+}
+
+// the header's block and row steps against the reference on every bit width, including 0 and 16
+static void check_against_reference()
+{
+    for (int width = 0; width <= 16; ++width)
+    {
+        for (int round = 0; round < 16; ++round)
+        {
+            Uint8 words[16 * lanes * 2 + 16];
+            for (Uint8 &byte : words)
+                byte = (Uint8)next_random();
+            Uint16 fast[blockSamples], reference[blockSamples];
+            height_codec_unpack_block(words, width, fast);
+            reference_unpack_block(words, width, reference);
+            CHECK(memcmp(fast, reference, sizeof(fast)) == 0);
+        }
+    }
+
+    for (int width = 0; width <= 40; ++width)
+    {
+        std::vector<Uint16> above((size_t)width), fast((size_t)width), reference((size_t)width);
+        for (int i = 0; i < width; ++i)
+        {
+            above[(size_t)i] = (Uint16)next_random();
+            fast[(size_t)i] = reference[(size_t)i] = (Uint16)next_random();
+        }
+        std::vector<Uint16> firstFast = fast, firstReference = reference;
+        height_codec_reconstruct_row(fast.data(), above.data(), width);
+        reference_reconstruct_row(reference.data(), above.data(), width);
+        CHECK(fast == reference);
+        height_codec_reconstruct_row(firstFast.data(), nullptr, width);
+        reference_reconstruct_row(firstReference.data(), nullptr, width);
+        CHECK(firstFast == firstReference);
+    }
+}
+
+// decodes terrain-like bands the size pack_tiles.py cuts from a 4096 wide mip (64 KB of heights each)
+static void report_decode_speed(int megabytes)
+{
+    const int width = 4096, rows = 8, bandCount = 64;
+    std::vector<std::vector<Uint8>> bands;
+    size_t packedBytes = 0;
+    for (int i = 0; i < bandCount; ++i)
+    {
+        bands.push_back(encode_band(make_band(width, rows, 3).data(), width, rows, 1));
+        packedBytes += bands.back().size();
+    }
+    std::vector<Uint16> decoded((size_t)width * rows);
+    size_t bandBytes = decoded.size() * sizeof(Uint16);
+    int decodes = SDL_max((int)((Uint64)megabytes * 1024 * 1024 / bandBytes), bandCount);
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    bool ok = true;
+    for (int i = 0; i < decodes; ++i)
+    {
+        const std::vector<Uint8> &band = bands[(size_t)(i % bandCount)];
+        ok = height_codec_decode_band(band.data(), band.size(), decoded.data(), width, rows) && ok;
+    }
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    CHECK(ok);
+    printf("decode (%s): %.2f GB/s of heights, %.2f:1 on terrain-like bands\n",
+#ifdef HEIGHT_CODEC_SSE2
+           "SSE2",
+#else
+           "scalar",
+#endif
+           (double)decodes * (double)bandBytes / seconds / 1.0e9, (double)(bandBytes * bandCount) / (double)packedBytes);
+}
+
+int main(int argc, char **argv)
+{
+    check_bands();
+    check_against_reference();
+    report_decode_speed(argc > 1 ? atoi(argv[1]) : 256);
+    return test_result("height_codec_test");
+}
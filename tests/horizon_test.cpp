@@ -0,0 +1,94 @@
+// below_horizon against a brute-force march: the straight line from the eye to a point, both bent down by
+// d^2 / (2 * planetRadius) like the terrain shader does, is stepped along and tested against the curved zero
+// height surface in between. Away from grazing the two have to agree on every case, and the region test the
+// clipmap culls with must never drop a region that has a visible point.
+
+#include <SDL3/SDL.h>
+
+#include "src/clipmap.h"
+#include "src/horizon.h"
+#include "tests/test.h"
+
+// whether a point of height pointHeight at distance d can be seen from eye height eyeHeight
+static bool visible_reference(double eyeHeight, double pointHeight, double d, double planetRadius)
+{
+    const int steps = 20000;
+    double endHeight = pointHeight - d * d / (2.0 * planetRadius);
+    for (int i = 1; i < steps; ++i)
+    {
+        double x = d * i / steps;
+        double y = eyeHeight + (endHeight - eyeHeight) * x / d;
+        if (y < -x * x / (2.0 * planetRadius) - 1e-9)
+            return false;
+    }
+    return true;
+}
+
+static Uint32 rng = 1;
+
+static Uint32 next_random()
+{
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+static float random_range(float lo, float hi) { return lo + (hi - lo) * (float)(next_random() & 0xffff) / 65535.0f; }
+
+int main()
+{
+    int cases = 0, visible = 0, mismatches = 0;
+    for (int i = 0; i < 20000; ++i)
+    {
+        float planetRadius = random_range(1000.0f, 1.0e6f);
+        float eyeHeight = random_range(0.0f, 10000.0f);
+        float pointHeight = random_range(0.0f, 300.0f);
+        float d = random_range(1.0f, 100000.0f);
+        float horizon = horizon_distance(eyeHeight, pointHeight, planetRadius);
+        if (SDL_fabsf(d - horizon) < horizon * 1e-3f)
+            continue; // grazing, float rounding decides either way
+        bool reference = visible_reference(eyeHeight, pointHeight, d, planetRadius);
+        bool culled = below_horizon(eyeHeight, pointHeight, d * d, planetRadius);
+        cases++;
+        visible += reference ? 1 : 0;
+        if (reference == culled)
+        {
+            if (mismatches++ < 5)
+                fprintf(stderr, "eye %f point %f d %f radius %f: reference %s, below_horizon %s\n", eyeHeight,
+                        pointHeight, d, planetRadius, reference ? "visible" : "hidden", culled ? "culled" : "kept");
+        }
+    }
+    printf("%d cases, %d visible, %d mismatches\n", cases, visible, mismatches);
+    CHECK(mismatches == 0);
+    CHECK(visible > cases / 10 && visible < cases - cases / 10); // both sides of the horizon are exercised
+
+    // regions: every sampled point of a culled region, at any height up to its max, has to be hidden
+    int regions = 0, culledRegions = 0, wronglyCulled = 0;
+    for (int i = 0; i < 2000; ++i)
+    {
+        clipmap_cull_params cull = {};
+        cull.planetRadius = random_range(5000.0f, 50000.0f);
+        cull.maxHeight = random_range(10.0f, 300.0f);
+        cull.cameraPos = {random_range(-1000.0f, 1000.0f), random_range(1.0f, 3000.0f), random_range(-1000.0f, 1000.0f)};
+        float horizon = horizon_distance(cull.cameraPos.y, cull.maxHeight, cull.planetRadius);
+        float size = random_range(10.0f, horizon);
+        float minX = cull.cameraPos.x + random_range(-2.0f, 2.0f) * horizon;
+        float minZ = cull.cameraPos.z + random_range(-2.0f, 2.0f) * horizon;
+        float maxX = minX + size, maxZ = minZ + size;
+        regions++;
+        if (!cull.below_horizon(minX, minZ, maxX, maxZ))
+            continue;
+        culledRegions++;
+        for (int s = 0; s < 16; ++s)
+        {
+            float x = random_range(minX, maxX) - cull.cameraPos.x;
+            float z = random_range(minZ, maxZ) - cull.cameraPos.z;
+            float d = SDL_sqrtf(x * x + z * z);
+            wronglyCulled += visible_reference(cull.cameraPos.y, cull.maxHeight, d, cull.planetRadius) ? 1 : 0;
+        }
+    }
+    printf("%d regions, %d culled, %d visible points in culled regions\n", regions, culledRegions, wronglyCulled);
+    CHECK(wronglyCulled == 0);
+    CHECK(culledRegions > 0);
+
+    return test_result("horizon_test");
+}
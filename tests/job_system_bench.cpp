@@ -0,0 +1,152 @@
+// Throughput of job_system against the pool it replaced: workers blocking on one mutex and condition variable
+// around a queue of std::function, woken with notify_all after every batch the main thread queued. Both run
+// the same tiny jobs on hardware threads - 1 workers, every job has to run exactly once.
+//   job_system_bench [job count, 4000000 by default] [worker count]
+
+#include <SDL3/SDL.h>
+
+#include <functional>
+#include <queue>
+
+#include "src/job_system.h"
+#include "tests/test.h"
+
+static const int batchSize = 1000; // jobs queued per notify in the old pool, a busy streaming frame's worth
+
+static std::atomic<Uint64> indexSum{0};
+static std::atomic<Uint64> workSum{0}; // keeps the busy work from being optimised out
+static std::atomic<int> jobsRun{0};
+
+static void tiny_job(void *data)
+{
+    Uint64 x = (Uint64)(size_t)data;
+    for (int i = 0; i < 20; ++i)
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+    workSum.fetch_add(x, std::memory_order_relaxed);
+    indexSum.fetch_add((Uint64)(size_t)data, std::memory_order_relaxed);
+    jobsRun.fetch_add(1, std::memory_order_relaxed);
+}
+
+static double ms_since(Uint64 start)
+{
+    return (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static void report(const char *name, int jobs, double ms)
+{
+    printf("%-32s %10.1f ms %10.2f Mjobs/s\n", name, ms, (double)jobs / ms / 1000.0);
+}
+
+static void check_run(int jobs)
+{
+    Uint64 expected = (Uint64)jobs * (Uint64)(jobs - 1) / 2;
+    CHECK(jobsRun.load() == jobs);
+    CHECK(indexSum.load() == expected);
+    jobsRun = 0;
+    indexSum = 0;
+}
+
+// the stream thread pool main.cpp had before the job system
+static double run_mutex_pool(int workerCount, int jobs)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::queue<std::function<void()>> queue;
+    bool stop = false;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back([&]()
+                             {
+            while (true)
+            {
+                std::function<void()> work;
+                {
+                    std::unique_lock<std::mutex> lk(mutex);
+                    cv.wait(lk, [&] { return stop || !queue.empty(); });
+                    if (queue.empty())
+                        return;
+                    work = std::move(queue.front());
+                    queue.pop();
+                }
+                work();
+            } });
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int first = 0; first < jobs; first += batchSize)
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            for (int i = first; i < SDL_min(first + batchSize, jobs); ++i)
+                queue.emplace([i]() { tiny_job((void *)(size_t)i); });
+        }
+        cv.notify_all();
+    }
+    while (jobsRun.load(std::memory_order_acquire) < jobs)
+        std::this_thread::yield();
+    double ms = ms_since(start);
+
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    for (auto &t : workers)
+        t.join();
+    return ms;
+}
+
+static job_system *benchJobs = nullptr;
+static job_group nestedGroup;
+
+// a job that queues a batch from a worker, onto that worker's own deque
+static void spawn_batch(void *data)
+{
+    int first = (int)(size_t)data;
+    for (int i = first; i < first + batchSize; ++i)
+        benchJobs->submit(tiny_job, (void *)(size_t)i, &nestedGroup);
+}
+
+int main(int argc, char **argv)
+{
+    int jobs = argc > 1 ? atoi(argv[1]) : 4000000;
+    jobs = SDL_max(jobs / batchSize, 1) * batchSize;
+    unsigned int hwThreads = std::thread::hardware_concurrency();
+    int workerCount = argc > 2 ? atoi(argv[2]) : (hwThreads > 1 ? (int)hwThreads - 1 : 1);
+    workerCount = SDL_clamp(workerCount, 1, job_system::maxThreads - 1);
+    printf("%d jobs, %d workers\n", jobs, workerCount);
+
+    report("mutex + condition variable pool", jobs, run_mutex_pool(workerCount, jobs));
+    check_run(jobs);
+
+    static job_system system;
+    CHECK(system.init(workerCount));
+    benchJobs = &system;
+
+    job_group group;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < jobs; ++i)
+        system.submit(tiny_job, (void *)(size_t)i, &group);
+    system.wait(group);
+    report("job system, main thread submits", jobs, ms_since(start));
+    check_run(jobs);
+
+    start = SDL_GetPerformanceCounter();
+    for (int first = 0; first < jobs; first += batchSize)
+        system.submit(spawn_batch, (void *)(size_t)first, &nestedGroup);
+    system.wait(nestedGroup);
+    report("job system, workers submit", jobs, ms_since(start));
+    check_run(jobs);
+
+    start = SDL_GetPerformanceCounter();
+    system.parallel_for(jobs, 64, [](int begin, int end)
+                        {
+        for (int i = begin; i < end; ++i)
+            tiny_job((void *)(size_t)i); });
+    report("job system, parallel_for grain 64", jobs, ms_since(start));
+    check_run(jobs);
+
+    system.shutdown();
+    return test_result("job_system_bench");
+}
@@ -0,0 +1,158 @@
+import os
+import random
+import struct
+import subprocess
+import sys
+
+# Writes the files dds_file_test and tile_archive_test read, into the current directory (ctest runs it in the
+# build directory before them):
+#   dds/<case>.dds, dds/<case>_truncated.dds   one texture per format and header kind the reader handles, and a
+#                                              copy one byte short, listed in dds/cases.txt
+#   dds/cube.dds, dds/junk.dds                 files the reader has to refuse
+#   world/data/{height,albedo}/chunk_*.dds     a small world with a hole, negative coordinates, a tile without
+#                                              albedo and a duplicate, packed by pack_tiles.py into
+#                                              world/data/tiles.pak, and tiles_truncated.pak cut short of its payloads
+#   world_compressed/data/tiles.pak            the same world packed with --compress --height-codec, when lz4
+#                                              and numpy are installed
+#   python make_tile_fixtures.py
+
+PACK_TILES = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "pack_tiles.py")
+
+DDSD_MIPMAPCOUNT = 0x20000
+DDPF_FOURCC = 0x4
+DDPF_ALPHAPIXELS = 0x1
+DDPF_RGB = 0x40
+DDPF_LUMINANCE = 0x20000
+DDSCAPS2_CUBEMAP_ALL = 0xFE00
+
+FORMAT_R16_UNORM = 56
+
+
+def fourcc(text):
+    return struct.unpack("<I", text.encode())[0]
+
+
+def pixel_format(flags, code=0, bits=0, r=0, g=0, b=0, a=0):
+    return struct.pack("<8I", 32, flags, code, bits, r, g, b, a)
+
+
+def header(width, height, mips, pf, dx10_format=None, caps2=0):
+    flags = 0x1 | 0x2 | 0x4 | 0x1000 | (DDSD_MIPMAPCOUNT if mips > 1 else 0)
+    data = struct.pack("<7I", 124, flags, height, width, 0, 0, mips) + b"\0" * 44 + pf
+    data += struct.pack("<5I", 0x1000, caps2, 0, 0, 0)
+    if dx10_format is not None:
+        data += struct.pack("<5I", dx10_format, 3, 0, 1, 0)
+    return b"DDS " + data
+
+
+def mip_sizes(width, height, mips, bits=0, block=0):
+    sizes = []
+    for _ in range(mips):
+        if block:
+            sizes.append(max((width + 3) // 4, 1) * block * max((height + 3) // 4, 1))
+        else:
+            sizes.append(width * bits // 8 * height)
+        width = max(width // 2, 1)
+        height = max(height // 2, 1)
+    return sizes
+
+
+# name: width, height, mips, DXGI_FORMAT, pixel format, DX10 format or None, bits per pixel, bytes per block
+DDS_CASES = [
+    ("r16_legacy", 64, 32, 7, 56, pixel_format(DDPF_LUMINANCE, bits=16, r=0xFFFF), None, 16, 0),
+    ("r32f_legacy", 64, 64, 1, 41, pixel_format(DDPF_FOURCC, 114), None, 32, 0),
+    ("rgba8_legacy", 30, 17, 5, 28,
+     pixel_format(DDPF_RGB | DDPF_ALPHAPIXELS, bits=32, r=0xFF, g=0xFF00, b=0xFF0000, a=0xFF000000), None, 32, 0),
+    ("bc1_legacy", 37, 21, 6, 71, pixel_format(DDPF_FOURCC, fourcc("DXT1")), None, 0, 8),
+    ("bc3_legacy", 64, 64, 7, 77, pixel_format(DDPF_FOURCC, fourcc("DXT5")), None, 0, 16),
+    ("bc5_legacy", 4, 4, 3, 83, pixel_format(DDPF_FOURCC, fourcc("ATI2")), None, 0, 16),
+    ("r16_dx10", 128, 128, 8, 56, pixel_format(DDPF_FOURCC, fourcc("DX10")), 56, 16, 0),
+    ("r32f_dx10", 16, 16, 5, 41, pixel_format(DDPF_FOURCC, fourcc("DX10")), 41, 32, 0),
+    ("rgba8srgb_dx10", 256, 64, 9, 29, pixel_format(DDPF_FOURCC, fourcc("DX10")), 29, 32, 0),
+    ("bc4_dx10", 8, 8, 4, 80, pixel_format(DDPF_FOURCC, fourcc("DX10")), 80, 0, 8),
+    ("bc7_dx10", 100, 50, 7, 98, pixel_format(DDPF_FOURCC, fourcc("DX10")), 98, 0, 16),
+]
+
+
+def random_bytes(count):
+    return bytes(random.getrandbits(8) for _ in range(count))
+
+
+def write(path, data):
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def write_dds_cases():
+    os.makedirs("dds", exist_ok=True)
+    with open(os.path.join("dds", "cases.txt"), "w") as cases:
+        for name, width, height, mips, fmt, pf, dx10_format, bits, block in DDS_CASES:
+            head = header(width, height, mips, pf, dx10_format)
+            sizes = mip_sizes(width, height, mips, bits, block)
+            body = random_bytes(sum(sizes))
+            write(os.path.join("dds", name + ".dds"), head + body)
+            write(os.path.join("dds", name + "_truncated.dds"), head + body[:-1])
+            cases.write("%s %d %d %d %d %d %s\n" % (name, width, height, mips, fmt, len(head), " ".join(map(str, sizes))))
+    cube = header(4, 4, 1, pixel_format(DDPF_FOURCC, fourcc("DXT1")), caps2=DDSCAPS2_CUBEMAP_ALL)
+    write(os.path.join("dds", "cube.dds"), cube + b"\0" * 48)
+    write(os.path.join("dds", "junk.dds"), b"XXXX" + b"\0" * 200)
+
+
+def height_tile(x, y, dim, mips):
+    """Smooth R16 hills with a full mip chain, so the height codec has something to predict."""
+    chain = b""
+    for mip in range(mips):
+        size = max(dim >> mip, 1)
+        step = dim // size
+        samples = []
+        for row in range(size):
+            for col in range(size):
+                wx = x * dim + col * step
+                wy = y * dim + row * step
+                samples.append((wx * 97 + wy * 61 + (wx * wy) // 7 + random.getrandbits(3)) & 0xFFFF)
+        chain += struct.pack("<%dH" % len(samples), *samples)
+    return header(dim, dim, mips, pixel_format(DDPF_FOURCC, fourcc("DX10")), FORMAT_R16_UNORM) + chain
+
+
+def albedo_tile(dim, mips):
+    sizes = mip_sizes(dim, dim, mips, block=8)
+    return header(dim, dim, mips, pixel_format(DDPF_FOURCC, fourcc("DXT1"))) + random_bytes(sum(sizes))
+
+
+def write_world(root):
+    dim = 64
+    mips = 7
+    height_dir = os.path.join(root, "data", "height")
+    albedo_dir = os.path.join(root, "data", "albedo")
+    random.seed(2)
+    for y in range(2):
+        for x in range(-1, 2):
+            if (x, y) == (1, 1):
+                continue  # hole in the coverage
+            write(os.path.join(height_dir, "chunk_height_%d_%d.dds" % (x, y)), height_tile(x, y, dim, mips))
+            if (x, y) != (-1, 1):  # height only
+                write(os.path.join(albedo_dir, "chunk_albedo_%d_%d.dds" % (x, y)), albedo_tile(dim, mips))
+    # byte identical to (0, 0), stored once
+    with open(os.path.join(albedo_dir, "chunk_albedo_0_0.dds"), "rb") as f:
+        write(os.path.join(albedo_dir, "chunk_albedo_1_0.dds"), f.read())
+
+
+def pack(root, options):
+    subprocess.check_call([sys.executable, PACK_TILES] + options, cwd=root, stdout=subprocess.DEVNULL)
+
+
+if __name__ == "__main__":
+    random.seed(1)
+    write_dds_cases()
+    write_world("world")
+    pack("world", [])
+    with open(os.path.join("world", "data", "tiles.pak"), "rb") as f:
+        write(os.path.join("world", "data", "tiles_truncated.pak"), f.read(4096))
+    try:
+        import lz4.block  # noqa: F401
+        import numpy  # noqa: F401
+        write_world("world_compressed")
+        pack("world_compressed", ["--compress", "--height-codec"])
+    except ImportError:
+        print("lz4 or numpy missing, skipping the compressed archive")
@@ -0,0 +1,80 @@
+#pragma once
+
+// The slice of SDL3 the portable headers in src/ use, on top of the C library, so the tests build on
+// machines without SDL. Only what src/ actually calls is here.
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+
+typedef uint8_t Uint8;
+typedef int8_t Sint8;
+typedef uint16_t Uint16;
+typedef int16_t Sint16;
+typedef uint32_t Uint32;
+typedef int32_t Sint32;
+typedef uint64_t Uint64;
+typedef int64_t Sint64;
+
+#define SDL_max(a, b) (((a) > (b)) ? (a) : (b))
+#define SDL_min(a, b) (((a) < (b)) ? (a) : (b))
+#define SDL_clamp(x, a, b) (((x) < (a)) ? (a) : (((x) > (b)) ? (b) : (x)))
+#define SDL_arraysize(a) (sizeof(a) / sizeof((a)[0]))
+
+#define SDL_malloc malloc
+#define SDL_free free
+#define SDL_memcpy memcpy
+#define SDL_memset memset
+#define SDL_qsort qsort
+#define SDL_abs abs
+#define SDL_fabsf fabsf
+#define SDL_sqrtf sqrtf
+#define SDL_floorf floorf
+#define SDL_ceilf ceilf
+#define SDL_tanf tanf
+
+static inline void SDL_Log(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+static inline Uint64 SDL_GetPerformanceCounter()
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (Uint64)t.tv_sec * 1000000000ull + (Uint64)t.tv_nsec;
+}
+
+static inline Uint64 SDL_GetPerformanceFrequency() { return 1000000000ull; }
+
+typedef FILE SDL_IOStream;
+
+static inline SDL_IOStream *SDL_IOFromFile(const char *file, const char *mode) { return fopen(file, mode); }
+static inline bool SDL_CloseIO(SDL_IOStream *stream) { return fclose(stream) == 0; }
+
+static inline size_t SDL_IOprintf(SDL_IOStream *stream, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int written = vfprintf(stream, fmt, ap);
+    va_end(ap);
+    return written > 0 ? (size_t)written : 0;
+}
+
+static inline char *SDL_iconv_wchar_utf8(const wchar_t *text)
+{
+    size_t length = wcslen(text) * 4 + 1;
+    char *utf8 = (char *)malloc(length);
+    if (utf8)
+        wcstombs(utf8, text, length);
+    return utf8;
+}
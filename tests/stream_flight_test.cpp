@@ -0,0 +1,404 @@
+// The test flight's streaming, headless: tile_streamer, the per-frame step main.cpp runs, flown along the
+// app's route across a 40 x 8 tile world, with main.cpp's deterministic I/O around it. Loads go through a
+// stream_request_queue with a token per slot, stage their mips through an upload_ring_allocator sized like the
+// stream uploader's, and land through stream_flight_io. Checks that a flight replays the same tiles in the same
+// order, that the wait for the frame's loads never hangs on a full ring, and that the speed policy stalls
+// less, printing the frames the wanted window had tiles missing.
+//   stream_flight_test [megabytes per frame]
+
+#include <SDL3/SDL.h>
+
+#include <vector>
+
+#include "src/stream_queue.h"
+#include "src/tile_streaming.h"
+#include "src/upload_ring.h"
+#include "tests/test.h"
+
+static const int worldTilesX = 40;
+static const int worldTilesY = 8;
+static const int holeX = 17, holeY = 4; // a tile the world doesn't have
+static const int visibleTileWidth = 4;
+static const int slotCount = visibleTileWidth * visibleTileWidth + 8;
+static const float tileWorldSize = 4096.0f;
+static const Uint32 tileDim = 4096;
+static const Uint64 megabyte = 1024 * 1024;
+static const Uint64 placementAlignment = 512; // D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+
+static Uint32 world_tile_loads(void *, int x, int y)
+{
+    bool inWorld = x >= 0 && x < worldTilesX && y >= 0 && y < worldTilesY && !(x == holeX && y == holeY);
+    return inWorld ? 3u : 0u; // height and albedo
+}
+
+static Uint64 world_content_key(void *, int x, int y) { return ((Uint64)(Uint32)y << 32) | (Uint32)x; }
+
+// the stream uploader without a GPU: batches complete when someone waits on them
+struct sim_uploader
+{
+    upload_ring_allocator ring;
+    Uint64 submitted; // last batch handed to the copy queue
+    Uint64 completed;
+    Uint64 openFence; // of the batch copies are recorded into
+    int openCopies;
+    int submitWaiters; // loads out of ring space until the open batch goes out
+
+    static Uint64 fence_completed(void *context) { return ((sim_uploader *)context)->completed; }
+    static void fence_wait(void *context, Uint64 value)
+    {
+        sim_uploader *uploader = (sim_uploader *)context;
+        CHECK(value <= uploader->submitted); // a batch nobody submitted never completes
+        uploader->completed = SDL_max(uploader->completed, SDL_min(value, uploader->submitted));
+    }
+
+    void create(Uint64 largestMipBytes)
+    {
+        Uint64 bytes = SDL_max(64 * megabyte, 2 * largestMipBytes); // StreamUploadConstants::ringBytes
+        ring.init(bytes, {fence_completed, fence_wait, this});
+        submitted = completed = 0;
+        openFence = 1;
+        openCopies = 0;
+        submitWaiters = 0;
+    }
+
+    void flush()
+    {
+        if (openCopies == 0)
+            return;
+        ring.close(openFence);
+        ring.retire();
+        submitted = openFence++;
+        openCopies = 0;
+    }
+
+    void wait(Uint64 fenceValue) { completed = SDL_max(completed, SDL_min(fenceValue, submitted)); }
+};
+
+struct sim_load
+{
+    int slot;
+    int x;
+    int y;
+    bool albedo;
+    bool refine;
+    Uint32 firstMip;
+    float priority;
+    Uint32 sequence;
+    Uint32 generation; // of the slot's token when requested
+    Uint32 mipsStaged;
+    bool reported;
+    bool cancelled;
+    bool ok;
+    Uint64 uploadFence;
+    struct
+    {
+        Uint64 bytes;
+    } timing;
+};
+
+struct flight_result
+{
+    Uint32 frames;
+    Uint32 stallFrames;
+    Uint32 longestStall;
+    Uint32 missingTiles; // window tiles not resident, summed over frames
+    Uint32 ringHangs;    // frames whose wait for their loads made no progress without a flush
+    Uint32 batches;
+    stream_test_flight::counters delta;
+    std::vector<Uint32> trace; // every request and landing, in order
+};
+
+// R16 heights, BC1 albedo
+static Uint64 mip_bytes(bool albedo, Uint32 mip)
+{
+    Uint64 dim = tileDim >> mip;
+    return albedo ? SDL_max(dim / 4, (Uint64)1) * SDL_max(dim / 4, (Uint64)1) * 8 : dim * dim * 2;
+}
+
+static Uint32 mip_count()
+{
+    Uint32 count = 0;
+    while ((tileDim >> count) > 0)
+        count++;
+    return count;
+}
+
+static Uint64 chain_bytes(bool albedo, Uint32 firstMip)
+{
+    Uint64 bytes = 0;
+    for (Uint32 mip = firstMip; mip < mip_count(); ++mip)
+        bytes += mip_bytes(albedo, mip);
+    return bytes;
+}
+
+struct flight_sim
+{
+    sim_uploader uploader;
+    stream_request_queue queue;
+    stream_token tokens[slotCount];
+    std::vector<sim_load> loads;    // every load issued, by index
+    std::vector<int> staging;       // started, staging their mips
+    std::vector<sim_load> landing;  // reported, waiting to land, main.cpp's tileLoadsLanding
+    Uint32 inFlight;
+    Uint32 sequence;
+
+    void reset()
+    {
+        uploader.create(mip_bytes(false, 0));
+        for (stream_token &token : tokens)
+            token.generation = 0;
+        loads.clear();
+        staging.clear();
+        landing.clear();
+        inFlight = 0;
+        sequence = 0;
+    }
+
+    void report(sim_load &load, bool ok)
+    {
+        load.reported = true;
+        load.ok = ok;
+        landing.push_back(load);
+        inFlight--;
+    }
+
+    void push(const sim_load &load)
+    {
+        int index = (int)loads.size();
+        loads.push_back(load);
+        loads.back().sequence = sequence++;
+        loads.back().generation = tokens[load.slot].current();
+        inFlight++;
+        std::lock_guard<std::mutex> lk(queue.mutex);
+        queue.push_locked(load.priority, &tokens[load.slot], [this, index](bool cancelled)
+                          {
+            sim_load &l = loads[index];
+            l.cancelled = cancelled;
+            if (cancelled)
+                report(l, false);
+            else
+                staging.push_back(index); });
+    }
+
+    // the loads a tile_stream_request asks for, like main.cpp's request_tile_load and request_tile_refine
+    void issue(const tile_streamer &streamer, const tile_stream_request &request, v3 pos, std::vector<Uint32> &trace, Uint32 frame)
+    {
+        trace.insert(trace.end(), {frame, (Uint32)request.slot, (Uint32)request.x, (Uint32)request.y, request.layers, request.speculative ? 1u : 0u});
+        sim_load load = {};
+        load.slot = request.slot;
+        load.x = request.x;
+        load.y = request.y;
+        load.priority = streamer.priority(request, pos);
+        Uint32 tailMip = tile_mip_tail_first(tileDim, tileDim, mip_count()); // progressive tiles
+        if (request.layers == 0)
+        {
+            load.albedo = load.refine = true;
+            load.timing.bytes = chain_bytes(true, 0);
+            push(load);
+            return;
+        }
+        load.timing.bytes = chain_bytes(false, 0);
+        push(load);
+        load.albedo = true;
+        load.firstMip = tailMip;
+        load.timing.bytes = chain_bytes(true, tailMip);
+        push(load);
+    }
+
+    // stages what it can of a started load's mips, mip by mip like d3d12_stream_uploader::upload. Returns
+    // false when it is waiting on the open batch.
+    bool stage(sim_load &load, bool &progress)
+    {
+        while (load.firstMip + load.mipsStaged < mip_count())
+        {
+            Uint64 offset = 0, waitValue = 0;
+            upload_ring_status status = uploader.ring.try_allocate(mip_bytes(load.albedo, load.firstMip + load.mipsStaged), placementAlignment,
+                                                                   offset, waitValue);
+            if (status == UPLOAD_RING_WAIT)
+            {
+                sim_uploader::fence_wait(&uploader, waitValue);
+                continue;
+            }
+            if (status == UPLOAD_RING_SUBMIT)
+                return false;
+            if (status == UPLOAD_RING_TOO_BIG)
+            {
+                report(load, false);
+                return true;
+            }
+            load.mipsStaged++;
+            uploader.openCopies++;
+            load.uploadFence = uploader.openFence;
+            progress = true;
+        }
+        report(load, true);
+        progress = true;
+        return true;
+    }
+
+    // main.cpp's deterministic wait: every load issued so far runs and stages its copies. With
+    // flushWhileWaiting the wait submits the open batch whenever a load is out of ring space, like main does,
+    // without it a stuck frame counts as a hang and is flushed to carry on.
+    bool wait_for_loads(bool flushWhileWaiting)
+    {
+        bool hung = false;
+        while (inFlight > 0)
+        {
+            if (flushWhileWaiting && uploader.submitWaiters > 0)
+                uploader.flush();
+            while (queue.depth.load() > 0)
+                stream_request_queue::run_next(&queue);
+            bool progress = false;
+            uploader.submitWaiters = 0;
+            size_t kept = 0;
+            for (int index : staging)
+            {
+                if (!stage(loads[(size_t)index], progress))
+                {
+                    uploader.submitWaiters++;
+                    staging[kept++] = index;
+                }
+            }
+            staging.resize(kept);
+            if (!progress && inFlight > 0 && !flushWhileWaiting)
+            {
+                hung = true;
+                uploader.flush();
+            }
+        }
+        return hung;
+    }
+};
+
+static flight_result fly(float speed, bool policyOn, float megabytesPerFrame, bool flushWhileWaiting = true)
+{
+    static tile_residency_cache cache;
+    cache.init(slotCount);
+    static flight_sim sim;
+    sim.reset();
+    stream_flight_io io;
+    io.bytesPerFrame = (Uint64)(megabytesPerFrame * (float)megabyte);
+
+    float midZ = (float)worldTilesY * 0.5f * tileWorldSize;
+    stream_test_flight flight;
+    flight.begin({0.0f, 0.0f, midZ}, {(float)worldTilesX * tileWorldSize, 0.0f, midZ}, speed, {0, 0, 0, 0});
+
+    static tile_streamer streamer;
+    streamer.init(&cache, {world_tile_loads, world_content_key, nullptr}, {0, 0, worldTilesX, worldTilesY}, visibleTileWidth,
+                  tileWorldSize, flight.start);
+    streamer.policy.enabled = policyOn;
+
+    // the app starts with the window around the camera resident
+    tile_window initial = streamer.window;
+    for (int y = initial.y; y < initial.y + initial.h; ++y)
+    {
+        for (int x = initial.x; x < initial.x + initial.w; ++x)
+        {
+            int slot = world_tile_loads(nullptr, x, y) ? cache.assign(x, y, world_content_key(nullptr, x, y), initial, 2) : -1;
+            if (slot >= 0)
+            {
+                cache.load_finished(slot);
+                cache.load_finished(slot);
+            }
+        }
+    }
+
+    flight_result result = {};
+    v3 pos;
+    float deltaTime;
+    Uint32 frame = 1;
+    while (flight.advance(pos, deltaTime))
+    {
+        frame++;
+        // deterministic I/O waits for the previous frame, everything before this one has retired
+        streamer.begin_frame(pos, deltaTime, frame - 1, frame);
+
+        result.ringHangs += sim.wait_for_loads(flushWhileWaiting) ? 1 : 0;
+        sim.uploader.flush();
+        Uint64 uploadFence = 0;
+        for (sim_load &load : sim.landing)
+        {
+            uploadFence = SDL_max(uploadFence, load.uploadFence);
+            if (sim.tokens[load.slot].current() != load.generation)
+            {
+                load.cancelled = true;
+                load.timing.bytes = 0;
+            }
+        }
+        sim.uploader.wait(uploadFence);
+        size_t landed = io.landing(sim.landing.data(), sim.landing.size());
+        for (size_t i = 0; i < landed; ++i)
+        {
+            const sim_load &load = sim.landing[i];
+            bool dropped = load.cancelled || !load.ok;
+            streamer.landed(load.slot, load.refine, dropped, load.albedo ? load.firstMip : 0);
+            result.trace.insert(result.trace.end(), {frame, 0xFFFFFFFFu, (Uint32)load.slot, load.sequence, dropped ? 1u : 0u});
+        }
+        sim.landing.erase(sim.landing.begin(), sim.landing.begin() + (long)landed);
+
+        int issued = 0;
+        auto issue = [&]()
+        {
+            for (; issued < streamer.requestCount; ++issued)
+                sim.issue(streamer, streamer.requests[issued], pos, result.trace, frame);
+        };
+        streamer.stream_window(frame);
+        issue();
+        result.missingTiles += (Uint32)streamer.notResident;
+        flight.frame_finished(streamer.notResident, {streamer.tablesForced, streamer.tablesDeferred, cache.loadsIssued, cache.refinesIssued});
+
+        streamer.stream_prediction(pos, deltaTime, frame);
+        issue();
+        streamer.drop_unwanted(frame);
+        for (int i = 0; i < streamer.supersededCount; ++i)
+            sim.tokens[streamer.superseded[i]].supersede();
+        streamer.publish(frame);
+    }
+    result.frames = flight.frames;
+    result.stallFrames = flight.stallFrames;
+    result.longestStall = flight.longestStall;
+    result.delta = flight.delta;
+    result.batches = (Uint32)sim.uploader.submitted;
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    const float budgets[] = {4.0f, StreamFlightConstants::ioMegabytesPerFrame, 16.0f, 32.0f};
+    const float speeds[] = {1000.0f, 2500.0f, 5000.0f};
+    float onlyBudget = argc > 1 ? (float)atof(argv[1]) : 0.0f;
+
+    printf("%8s %8s %7s %7s %8s %9s %8s %8s %7s %8s %8s\n", "MB/frame", "units/s", "policy", "frames", "stalls", "longest",
+           "missing", "forced", "loads", "refines", "batches");
+    Uint32 stallsOn = 0, stallsOff = 0;
+    for (float budget : budgets)
+    {
+        if (onlyBudget > 0.0f && budget != onlyBudget)
+            continue;
+        for (float speed : speeds)
+        {
+            for (int on = 1; on >= 0; --on)
+            {
+                flight_result r = fly(speed, on != 0, budget);
+                printf("%8.0f %8.0f %7s %7u %8u %9u %8u %8u %7u %8u %8u\n", budget, speed, on ? "on" : "off", r.frames,
+                       r.stallFrames, r.longestStall, r.missingTiles, r.delta.forcedPublishes, r.delta.loadsIssued,
+                       r.delta.refinesIssued, r.batches);
+                (on ? stallsOn : stallsOff) += r.stallFrames;
+                CHECK(r.ringHangs == 0);
+
+                // the same flight asks for the same tiles and lands them on the same frames
+                flight_result again = fly(speed, on != 0, budget);
+                CHECK(again.trace == r.trace);
+                CHECK(again.stallFrames == r.stallFrames && again.missingTiles == r.missingTiles);
+            }
+        }
+    }
+    printf("stall frames over every run: %u with the policy, %u without\n", stallsOn, stallsOff);
+    CHECK(stallsOn < stallsOff);
+
+    // waiting on the loads without submitting the open batch hangs once a window shift fills the ring
+    flight_result stuck = fly(5000.0f, true, StreamFlightConstants::ioMegabytesPerFrame, false);
+    printf("without flushing while waiting: %u frames hung on the ring\n", stuck.ringHangs);
+    CHECK(stuck.ringHangs > 0);
+    return test_result("stream_flight_test");
+}
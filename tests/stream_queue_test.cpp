@@ -0,0 +1,137 @@
+// stream_request_queue: requests run in priority order, superseded ones report back as cancelled, and one that
+// throws still reports back exactly once (as cancelled) so whoever counts its loads in flight isn't left
+// waiting. Then the same on the job system, draining completions like main.cpp's tileLoadsCompleted.
+
+#include <SDL3/SDL.h>
+
+#include <stdexcept>
+
+#include "src/job_system.h"
+#include "src/stream_queue.h"
+#include "tests/test.h"
+
+struct report
+{
+    int request;
+    bool cancelled;
+};
+
+static const int requestCount = 64;
+static std::atomic<int> reports[requestCount];
+static std::atomic<int> reportsCancelled[requestCount];
+
+// every third request throws before it reports back, like a load whose read or upload throws
+static void push_request(stream_request_queue &queue, int i, float priority, const stream_token *token,
+                         stream_completion_queue<report, 256> *completions)
+{
+    queue.push_locked(priority, token, [i, completions](bool cancelled)
+                      {
+        if (!cancelled && i % 3 == 0)
+            throw std::runtime_error("load failed");
+        reports[i].fetch_add(1);
+        reportsCancelled[i].fetch_add(cancelled ? 1 : 0);
+        if (completions)
+            completions->push({i, cancelled}); });
+}
+
+static void reset_reports()
+{
+    for (int i = 0; i < requestCount; ++i)
+    {
+        reports[i] = 0;
+        reportsCancelled[i] = 0;
+    }
+}
+
+static void run_inline()
+{
+    reset_reports();
+    stream_request_queue queue;
+    stream_token token;
+    token.generation = 0;
+    {
+        std::lock_guard<std::mutex> lk(queue.mutex);
+        for (int i = 0; i < requestCount; ++i)
+            push_request(queue, i, (float)(requestCount - i), i % 4 == 1 ? &token : nullptr, nullptr);
+        // one that throws even when it is only asked to report back
+        queue.push_locked(1000.0f, nullptr, [](bool) { throw std::runtime_error("report failed"); });
+    }
+    token.supersede();
+
+    // most urgent first, lower priority values run first
+    stream_request request;
+    {
+        std::lock_guard<std::mutex> lk(queue.mutex);
+        CHECK(queue.pop_locked(request) && request.priority == 1.0f);
+    }
+    queue.execute(request);
+    for (int i = 0; i < requestCount; ++i)
+        stream_request_queue::run_next(&queue);
+    CHECK(queue.depth.load() == 0);
+    stream_request_queue::run_next(&queue); // empty, returns without running anything
+
+    Uint32 superseded = 0, thrown = 0;
+    for (int i = 0; i < requestCount; ++i)
+    {
+        bool isSuperseded = i % 4 == 1;
+        bool throws = !isSuperseded && i % 3 == 0;
+        CHECK(reports[i] == 1);
+        CHECK(reportsCancelled[i] == (isSuperseded || throws ? 1 : 0));
+        superseded += isSuperseded ? 1 : 0;
+        thrown += throws ? 1 : 0;
+    }
+    CHECK(queue.issued.load() == requestCount + 1);
+    CHECK(queue.cancelled.load() == superseded);
+    CHECK(queue.failed.load() == thrown + 1);
+    CHECK(queue.completed.load() == requestCount - superseded - thrown);
+    printf("inline: %u completed, %u cancelled, %u failed\n", queue.completed.load(), queue.cancelled.load(), queue.failed.load());
+}
+
+static void run_on_jobs()
+{
+    reset_reports();
+    static job_system jobs;
+    CHECK(jobs.init(3));
+    static stream_request_queue queue;
+    static stream_completion_queue<report, 256> completions;
+    completions.init();
+
+    Uint32 inFlight = 0;
+    for (int round = 0; round < 100; ++round)
+    {
+        {
+            std::lock_guard<std::mutex> lk(queue.mutex);
+            for (int i = 0; i < requestCount; ++i)
+                push_request(queue, i, (float)((i * 7 + round) % requestCount), nullptr, &completions);
+        }
+        inFlight += requestCount;
+        for (int i = 0; i < requestCount; ++i)
+            jobs.submit(&stream_request_queue::run_next, &queue);
+
+        // the main thread's wait for every load in flight, it would spin forever on a swallowed request
+        Uint64 start = SDL_GetPerformanceCounter();
+        while (inFlight > 0 && SDL_GetPerformanceCounter() - start < SDL_GetPerformanceFrequency() * 10)
+        {
+            report r;
+            while (completions.pop(r))
+            {
+                CHECK(r.cancelled == (r.request % 3 == 0));
+                inFlight--;
+            }
+            std::this_thread::yield();
+        }
+        CHECK(inFlight == 0);
+    }
+    jobs.shutdown();
+
+    for (int i = 0; i < requestCount; ++i)
+        CHECK(reports[i] == 100);
+    printf("jobs: %u completed, %u failed\n", queue.completed.load(), queue.failed.load());
+}
+
+int main()
+{
+    run_inline();
+    run_on_jobs();
+    return test_result("stream_queue_test");
+}
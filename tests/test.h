@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdio.h>
+
+// Headless checks for the portable headers. A failed CHECK prints where and carries on, so one run lists
+// every mismatch, main returns test_result.
+static int testFailures = 0;
+
+#define CHECK(condition)                                                                  \
+    do                                                                                    \
+    {                                                                                     \
+        if (!(condition))                                                                 \
+        {                                                                                 \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            testFailures++;                                                               \
+        }                                                                                 \
+    } while (0)
+
+static int test_result(const char *name)
+{
+    printf("%s: %s (%d failed checks)\n", name, testFailures ? "FAILED" : "ok", testFailures);
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,194 @@
+// tile_archive over the worlds make_tile_fixtures.py packed with pack_tiles.py: every tile layer has to come
+// back byte for byte equal to the loose DDS it was packed from, whole and as a mip tail, stored plainly and
+// (when the fixtures had lz4 and numpy) LZ4 and delta compressed. Holes and missing layers aren't found,
+// duplicates share one payload, and a truncated archive is refused. Then prints the compressed world's ratio
+// and decode MB/s per layer, or those of any archive given, like the real one in data/tiles.pak.
+//   tile_archive_test [archive to report on]
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "src/tile_archive.h"
+#include "tests/test.h"
+
+static std::wstring widen(const std::string &text) { return std::wstring(text.begin(), text.end()); }
+
+static const int worldMinX = -1, worldMaxX = 1, worldMaxY = 1;
+
+static bool in_world(tile_archive_layer layer, int x, int y)
+{
+    if (x == 1 && y == 1)
+        return false; // the hole
+    return layer == TILE_LAYER_HEIGHT || !(x == -1 && y == 1); // height only tile
+}
+
+static void check_same_mips(const dds_image &packed, const dds_image &loose, Uint32 firstMip)
+{
+    CHECK(packed.format == loose.format);
+    CHECK(packed.mipLevels == loose.mipLevels - firstMip);
+    CHECK(packed.width == loose.surfaces[firstMip].width && packed.height == loose.surfaces[firstMip].height);
+    for (Uint32 mip = 0; mip < packed.mipLevels && firstMip + mip < loose.mipLevels; ++mip)
+    {
+        const dds_surface &a = packed.surfaces[mip];
+        const dds_surface &b = loose.surfaces[firstMip + mip];
+        CHECK(a.slicePitch == b.slicePitch && a.rowPitch == b.rowPitch);
+        CHECK(a.slicePitch == b.slicePitch && memcmp(a.pixels, b.pixels, a.slicePitch) == 0);
+    }
+}
+
+static int check_world(const char *root, bool compressed)
+{
+    tile_archive archive;
+    bool opened = archive.open(widen(std::string(root) + "/data/tiles.pak").c_str());
+    CHECK(opened);
+    if (!opened)
+        return 0;
+    CHECK(archive.manifest.tileCount == 5);
+    CHECK(archive.manifest.minTileX == worldMinX && archive.manifest.maxTileX == worldMaxX && archive.manifest.maxTileY == worldMaxY);
+
+    tile_decode_buffer scratch;
+    int checked = 0;
+    for (int layer = 0; layer < TILE_LAYER_COUNT; ++layer)
+    {
+        const char *layerName = layer == TILE_LAYER_HEIGHT ? "height" : "albedo";
+        for (int y = -1; y <= worldMaxY + 1; ++y)
+        {
+            for (int x = worldMinX - 1; x <= worldMaxX + 1; ++x)
+            {
+                dds_image packed;
+                bool found = archive.tile((tile_archive_layer)layer, x, y, packed, &scratch);
+                bool expected = x >= worldMinX && x <= worldMaxX && y >= 0 && y <= worldMaxY && in_world((tile_archive_layer)layer, x, y);
+                CHECK(found == expected);
+                if (!found || !expected)
+                    continue;
+
+                char path[256];
+                snprintf(path, sizeof(path), "%s/data/%s/chunk_%s_%d_%d.dds", root, layerName, layerName, x, y);
+                dds_file loose;
+                CHECK(loose.open(widen(path).c_str()));
+                check_same_mips(packed, loose.image, 0);
+                if (!compressed)
+                {
+                    // stored tiles point into the mapping, payloads on the alignment boundary
+                    CHECK(packed.surfaces[0].pixels >= archive.file.data && packed.surfaces[0].pixels < archive.file.data + archive.file.size);
+                    CHECK((size_t)(packed.surfaces[0].pixels - archive.file.data) % archive.header->alignment == 0);
+                }
+                dds_image tail;
+                CHECK(archive.tile((tile_archive_layer)layer, x, y, tail, &scratch, 3));
+                check_same_mips(tail, loose.image, 3);
+                CHECK(!archive.tile((tile_archive_layer)layer, x, y, tail, &scratch, loose.image.mipLevels));
+                checked++;
+            }
+        }
+    }
+
+    // albedo (1, 0) is a byte copy of (0, 0)
+    const tile_archive_entry *a = archive.entry(TILE_LAYER_ALBEDO, 0, 0);
+    const tile_archive_entry *b = archive.entry(TILE_LAYER_ALBEDO, 1, 0);
+    CHECK(a && b && a->offset == b->offset);
+    CHECK(archive.dedup[TILE_LAYER_ALBEDO].entries == 4);
+    if (compressed)
+        CHECK(archive.entry(TILE_LAYER_HEIGHT, 0, 0) && archive.entry(TILE_LAYER_HEIGHT, 0, 0)->compression != TILE_COMPRESSION_NONE);
+
+    dds_image image;
+    CHECK(!archive.tile(TILE_LAYER_COUNT, 0, 0, image, &scratch));
+    archive.close();
+    return checked;
+}
+
+// compression ratio over the unique payloads of each layer, and decode throughput over a few passes of every
+// compressed tile, from the archive's own decode stats (the stats panel's numbers) and by the wall clock
+static void report_compression(const wchar_t *filename, const char *name, int passes)
+{
+    tile_archive archive;
+    CHECK(archive.open(filename));
+    if (!archive.header)
+        return;
+    tile_decode_buffer scratch;
+    for (int layer = 0; layer < TILE_LAYER_COUNT; ++layer)
+    {
+        Uint64 size = 0, stored = 0;
+        Uint32 compressedTiles = 0;
+        std::vector<const tile_archive_entry *> sorted, unique;
+        for (Uint32 tile = 0; tile < archive.header->tileCount; ++tile)
+        {
+            const tile_archive_entry &e = archive.entries[(size_t)tile * archive.header->layerCount + (size_t)layer];
+            if (e.offset != 0 && e.compression != TILE_COMPRESSION_CONSTANT)
+                sorted.push_back(&e);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const tile_archive_entry *a, const tile_archive_entry *b) { return a->offset < b->offset; });
+        for (const tile_archive_entry *e : sorted)
+        {
+            if (!unique.empty() && unique.back()->offset == e->offset)
+                continue; // a duplicate's payload is counted once
+            unique.push_back(e);
+            size += e->size;
+            stored += e->storedSize;
+            compressedTiles += e->compression != TILE_COMPRESSION_NONE ? 1 : 0;
+        }
+
+        Uint64 decodedBefore = archive.decodedBytes.load(), ticksBefore = archive.decodeTicks.load();
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int pass = 0; pass < passes && compressedTiles > 0; ++pass)
+        {
+            for (const tile_archive_entry *e : unique)
+            {
+                tile_archive_span span;
+                dds_image image;
+                if (e->compression == TILE_COMPRESSION_NONE)
+                    continue;
+                CHECK(archive.mip_span(*e, 0, span) && archive.tile(*e, span, archive.file.data + e->offset, image, &scratch));
+            }
+        }
+        double wallSeconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+        double decodedMB = (double)(archive.decodedBytes.load() - decodedBefore) / (1024.0 * 1024.0);
+        double decodeSeconds = (double)(archive.decodeTicks.load() - ticksBefore) / (double)SDL_GetPerformanceFrequency();
+        printf("%s %s: %.2f MB in %.2f MB, %.2f:1, %u of %zu payloads compressed", name, layer == TILE_LAYER_HEIGHT ? "height" : "albedo",
+               (double)size / (1024.0 * 1024.0), (double)stored / (1024.0 * 1024.0), stored > 0 ? (double)size / (double)stored : 0.0,
+               compressedTiles, unique.size());
+        if (decodedMB > 0.0)
+            printf(", decode %.0f MB/s (%.0f MB/s wall)", decodedMB / decodeSeconds, decodedMB / wallSeconds);
+        printf("\n");
+    }
+    archive.close();
+}
+
+int main(int argc, char **argv)
+{
+    jobSystem.init(3);
+    if (argc > 1)
+    {
+        report_compression(widen(argv[1]).c_str(), argv[1], 3);
+        jobSystem.shutdown();
+        return test_result("tile_archive_test");
+    }
+
+    int checked = check_world("world", false);
+    printf("world: %d tile layers matched\n", checked);
+    CHECK(checked == 9);
+
+    FILE *compressed = fopen("world_compressed/data/tiles.pak", "rb");
+    if (compressed)
+    {
+        fclose(compressed);
+        checked = check_world("world_compressed", true);
+        printf("world_compressed: %d tile layers matched\n", checked);
+        CHECK(checked == 9);
+        report_compression(L"world_compressed/data/tiles.pak", "world_compressed", 200);
+    }
+    else
+    {
+        printf("world_compressed: not packed, lz4 or numpy missing\n");
+    }
+
+    tile_archive truncated;
+    CHECK(!truncated.open(L"world/data/tiles_truncated.pak"));
+    tile_archive missing;
+    CHECK(!missing.open(L"world/data/missing.pak"));
+
+    jobSystem.shutdown();
+    return test_result("tile_archive_test");
+}
@@ -0,0 +1,140 @@
+// upload_ring_allocator against a mock fence: random allocations and batch closes, checks alignment, that
+// nothing straddles the end of the ring and that no allocation overlaps memory whose batch hasn't retired.
+
+#include <SDL3/SDL.h>
+
+#include <vector>
+
+#include "src/upload_ring.h"
+#include "tests/test.h"
+
+// a counter standing in for the copy queue, it completes batches when the test says so
+struct mock_fence
+{
+    Uint64 submitted;
+    Uint64 completed;
+    int waits;
+};
+
+static Uint64 mock_completed(void *context) { return ((mock_fence *)context)->completed; }
+
+static void mock_wait(void *context, Uint64 value)
+{
+    mock_fence *fence = (mock_fence *)context;
+    CHECK(value <= fence->submitted); // waiting on a batch nobody submitted never returns on a GPU
+    fence->waits++;
+    fence->completed = SDL_max(fence->completed, value);
+}
+
+struct live_region
+{
+    Uint64 begin;
+    Uint64 end;
+    Uint64 fenceValue; // 0 while its batch is open
+};
+
+static Uint32 rng = 1;
+
+static Uint32 next_random()
+{
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+int main()
+{
+    const Uint64 capacity = 64ull << 20;
+    const Uint64 alignment = 512;
+    mock_fence fence = {};
+    upload_ring_allocator ring = {};
+    ring.init(capacity, {mock_completed, mock_wait, &fence});
+
+    std::vector<live_region> regions;
+    Uint64 nextFence = 1;
+    Uint32 allocations = 0, closes = 0, waits = 0, submits = 0;
+
+    auto close_batch = [&]()
+    {
+        ring.close(nextFence);
+        fence.submitted = nextFence;
+        for (live_region &region : regions)
+            region.fenceValue = region.fenceValue ? region.fenceValue : nextFence;
+        nextFence++;
+        closes++;
+    };
+
+    for (int i = 0; i < 200000; ++i)
+    {
+        if (next_random() % 7 == 0 && fence.completed < fence.submitted)
+            fence.completed++; // the GPU makes progress on its own
+        Uint64 size = 1 + next_random() % (3u << 20);
+        if (i % 1000 == 0)
+            size = capacity / 2 + next_random() % (capacity / 2); // now and then one as big as the largest mips
+
+        Uint64 offset = 0;
+        Uint64 waitValue = 0;
+        upload_ring_status status;
+        while ((status = ring.try_allocate(size, alignment, offset, waitValue)) != UPLOAD_RING_OK)
+        {
+            CHECK(status != UPLOAD_RING_TOO_BIG);
+            if (status == UPLOAD_RING_WAIT)
+            {
+                // the value handed out has to be submitted, and reaching it has to make room
+                CHECK(waitValue <= fence.submitted && waitValue > fence.completed);
+                fence.completed = waitValue;
+                waits++;
+            }
+            else if (status == UPLOAD_RING_SUBMIT)
+            {
+                close_batch();
+                submits++;
+            }
+            else
+            {
+                break;
+            }
+        }
+        if (status != UPLOAD_RING_OK)
+            break;
+
+        CHECK(offset % alignment == 0);
+        CHECK(offset + size <= capacity);
+        for (const live_region &region : regions)
+        {
+            bool retired = region.fenceValue != 0 && region.fenceValue <= fence.completed;
+            CHECK(retired || offset >= region.end || region.begin >= offset + size);
+        }
+        regions.push_back({offset, offset + size, 0});
+        allocations++;
+
+        if (next_random() % 4 == 0)
+            close_batch();
+
+        size_t kept = 0;
+        for (size_t r = 0; r < regions.size(); ++r)
+        {
+            if (!(regions[r].fenceValue != 0 && regions[r].fenceValue <= fence.completed))
+                regions[kept++] = regions[r];
+        }
+        regions.resize(kept);
+    }
+
+    // bigger than the ring is refused outright, a full ring with nothing closed asks for a submit
+    Uint64 offset = 0;
+    Uint64 waitValue = 0;
+    CHECK(ring.try_allocate(capacity + 1, alignment, offset, waitValue) == UPLOAD_RING_TOO_BIG);
+    upload_ring_allocator fresh = {};
+    mock_fence idle = {};
+    fresh.init(capacity, {mock_completed, mock_wait, &idle});
+    CHECK(fresh.try_allocate(capacity, alignment, offset, waitValue) == UPLOAD_RING_OK && offset == 0);
+    CHECK(fresh.try_allocate(alignment, alignment, offset, waitValue) == UPLOAD_RING_SUBMIT);
+    fresh.close(1);
+    idle.submitted = 1;
+    CHECK(fresh.try_allocate(alignment, alignment, offset, waitValue) == UPLOAD_RING_WAIT && waitValue == 1);
+    idle.completed = 1;
+    CHECK(fresh.try_allocate(capacity, alignment, offset, waitValue) == UPLOAD_RING_OK && offset == 0);
+
+    printf("%u allocations, %u batches closed, %u fence waits, %u early submits\n", allocations, closes, waits, submits);
+    CHECK(allocations == 200000);
+    return test_result("upload_ring_test");
+}